@@ -39,6 +39,7 @@
 #include "../src/foundation/mume-plugin.h"
 #include "../src/foundation/mume-property.h"
 #include "../src/foundation/mume-refobj.h"
+#include "../src/foundation/mume-ringq.h"
 #include "../src/foundation/mume-serialize.h"
 #include "../src/foundation/mume-stream.h"
 #include "../src/foundation/mume-string.h"
@@ -49,6 +50,7 @@
 #include "../src/foundation/mume-variant.h"
 #include "../src/foundation/mume-vector.h"
 #include "../src/foundation/mume-virtfs.h"
+#include "../src/foundation/mume-virtfs-zip.h"
 
 #include MUME_ASSERT_H
 #include MUME_LOCALE_H
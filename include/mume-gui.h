@@ -26,6 +26,7 @@
 #include "../src/foundation/mume-datasrc.h"
 #include "../src/foundation/mume-drawing.h"
 #include "../src/foundation/mume-events.h"
+#include "../src/foundation/mume-filemon.h"
 #include "../src/foundation/mume-frontend.h"
 #include "../src/foundation/mume-gstate.h"
 #include "../src/foundation/mume-label.h"
@@ -24,12 +24,16 @@
 #include "../src/reader/mume-docdoc.h"
 #include "../src/reader/mume-docmgr.h"
 #include "../src/reader/mume-docview.h"
+#include "../src/reader/mume-glyphidx.h"
 #include "../src/reader/mume-gstate.h"
 #include "../src/reader/mume-home-view.h"
 #include "../src/reader/mume-index-view.h"
 #include "../src/reader/mume-mainform.h"
+#include "../src/reader/mume-pagecache.h"
 #include "../src/reader/mume-profile.h"
 #include "../src/reader/mume-read-view.h"
+#include "../src/reader/mume-renderq.h"
+#include "../src/reader/mume-tilecache.h"
 #include "../src/reader/pdf/mume-pdf-doc.h"
 #include "../src/reader/txt/mume-txt-doc.h"
 
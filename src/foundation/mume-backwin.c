@@ -44,6 +44,8 @@ struct _backwin_class {
     void (*end_paint)(void *self, cairo_t *cr);
     void (*grab_pointer)(void *self);
     void (*ungrab_pointer)(void *self);
+    int (*scroll_area)(void *self, int x, int y,
+                       int w, int h, int dx, int dy);
 };
 
 MUME_STATIC_ASSERT(sizeof(struct _backwin) == MUME_SIZEOF_BACKWIN);
@@ -131,6 +133,12 @@ static void _backwin_ungrab_pointer(void *self)
 {
 }
 
+static int _backwin_scroll_area(
+    void *self, int x, int y, int w, int h, int dx, int dy)
+{
+    return 0;
+}
+
 static void* _backwin_class_ctor(
     struct _backwin_class *self, int mode, va_list *app)
 {
@@ -172,6 +180,8 @@ static void* _backwin_class_ctor(
             *(voidf**)&self->grab_pointer = method;
         else if (selector == (voidf*)_mume_backwin_ungrab_pointer)
             *(voidf**)&self->ungrab_pointer = method;
+        else if (selector == (voidf*)_mume_backwin_scroll_area)
+            *(voidf**)&self->scroll_area = method;
     }
 
     return self;
@@ -218,6 +228,8 @@ const void* mume_backwin_class(void)
         _backwin_grab_pointer,
         _mume_backwin_ungrab_pointer,
         _backwin_ungrab_pointer,
+        _mume_backwin_scroll_area,
+        _backwin_scroll_area,
         MUME_FUNC_END);
 }
 
@@ -357,3 +369,13 @@ void _mume_backwin_ungrab_pointer(const void *_clazz, void *_self)
         mume_backwin_meta_class(), mume_backwin_class(),
         struct _backwin_class, ungrab_pointer, (_self));
 }
+
+int _mume_backwin_scroll_area(
+    const void *_clazz, void *_self,
+    int x, int y, int w, int h, int dx, int dy)
+{
+    MUME_SELECTOR_RETURN(
+        mume_backwin_meta_class(), mume_backwin_class(),
+        struct _backwin_class, scroll_area,
+        (_self, x, y, w, h, dx, dy));
+}
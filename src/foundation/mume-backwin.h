@@ -26,7 +26,7 @@ MUME_BEGIN_DECLS
                              sizeof(void*))
 
 #define MUME_SIZEOF_BACKWIN_CLASS (MUME_SIZEOF_REFOBJ_CLASS + \
-                                   sizeof(voidf*) * 14)
+                                   sizeof(voidf*) * 15)
 
 mume_public const void* mume_backwin_class(void);
 
@@ -123,6 +123,15 @@ mume_public void _mume_backwin_ungrab_pointer(
 #define mume_backwin_ungrab_pointer(_self) \
     _mume_backwin_ungrab_pointer(NULL, _self)
 
+/* Selector for move the pixels of the specified area by (dx, dy).
+ * Return zero if not supported, the caller should repaint then. */
+mume_public int _mume_backwin_scroll_area(
+    const void *clazz, void *self,
+    int x, int y, int w, int h, int dx, int dy);
+
+#define mume_backwin_scroll_area(_self, _x, _y, _w, _h, _dx, _dy) \
+    _mume_backwin_scroll_area(NULL, _self, _x, _y, _w, _h, _dx, _dy)
+
 MUME_END_DECLS
 
 #endif /* MUME_FOUNDATION_BACKWIN_H */
@@ -69,11 +69,13 @@ MUME_BEGIN_DECLS
 #define mume_remove_flag(_val, _flag) ((_val) &= ~(1 << (_flag)))
 
 typedef struct mume_list_s mume_list_t;
+typedef struct mume_ringq_s mume_ringq_t;
 typedef struct mume_vector_s mume_vector_t;
 typedef struct mume_oset_s mume_oset_t;
 typedef struct mume_logger_s mume_logger_t;
 typedef struct mume_stream_s mume_stream_t;
 typedef struct mume_virtfs_s mume_virtfs_t;
+typedef struct mume_zipfs_s mume_zipfs_t;
 typedef struct mume_timeval_s mume_timeval_t;
 typedef struct mume_type_s mume_type_t;
 typedef struct mume_prop_s mume_prop_t;
@@ -87,6 +89,7 @@ typedef void mume_destroy_func_t(void *p);
 typedef void mume_mutex_t;
 typedef void mume_sem_t;
 typedef void mume_thread_t;
+typedef void mume_thread_id_t;
 
 typedef void mume_confcn_t(void *obj, void *p);
 typedef void mume_desfcn_t(void *obj, void *p);
@@ -102,6 +105,7 @@ typedef int mume_evtproc_t(mume_event_t *evt);
 typedef struct mume_resmgr_s mume_resmgr_t;
 typedef struct mume_timer_s mume_timer_t;
 typedef struct mume_timerq_s mume_timerq_t;
+typedef struct mume_filemon_s mume_filemon_t;
 typedef struct mume_resobj_image_s mume_resobj_image_t;
 typedef struct mume_resobj_brush_s mume_resobj_brush_t;
 typedef struct mume_resobj_fontface_s mume_resobj_fontface_t;
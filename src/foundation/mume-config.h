@@ -156,6 +156,14 @@
 # endif
 #endif
 
+#ifndef MUME_ZLIB_H
+# if HAVE_ZLIB_H
+#  define MUME_ZLIB_H <zlib.h>
+# else
+#  define MUME_ZLIB_H "mume-config.h"
+# endif
+#endif
+
 #ifndef MUME_PHYSFS_H
 # if HAVE_PHYSFS_H
 #  define MUME_PHYSFS_H <physfs.h>
@@ -277,6 +277,23 @@ void mume_charfmt_draw_text(
     }
 }
 
+void mume_charfmt_draw_glyphs(
+    cairo_t *cr, mume_resobj_charfmt_t *cf,
+    const cairo_glyph_t *glyphs, int count, int x, int y)
+{
+    if (mume_resobj_charfmt_is_valid(cf) && count > 0) {
+        cairo_save(cr);
+        cairo_set_source_rgb(
+            cr, mume_color_rval(&cf->color),
+            mume_color_gval(&cf->color),
+            mume_color_bval(&cf->color));
+        cairo_translate(cr, x, y);
+        mume_text_layout_show_glyphs(
+            cr, cf->p->p, cf->size, glyphs, count);
+        cairo_restore(cr);
+    }
+}
+
 void mume_cairo_region_to_path(cairo_t *cr, const cairo_region_t *rgn)
 {
     mume_rect_t r;
@@ -54,6 +54,10 @@ mume_public void mume_charfmt_draw_text(
     cairo_t *cr, mume_resobj_charfmt_t *cf, unsigned int fmt,
     const char *text, int length, mume_rect_t *rect);
 
+mume_public void mume_charfmt_draw_glyphs(
+    cairo_t *cr, mume_resobj_charfmt_t *cf,
+    const cairo_glyph_t *glyphs, int count, int x, int y);
+
 mume_public void mume_cairo_region_to_path(
     cairo_t *cr, const cairo_region_t *rgn);
 
@@ -17,6 +17,7 @@
  */
 #include "mume-encoding.h"
 #include "mume-memory.h"
+#include MUME_STRING_H
 
 #define F 0   /* character never appears in text */
 #define T 1   /* character appears in plain ASCII text */
@@ -102,6 +103,49 @@ static int looks_extended(const unsigned char *buf, size_t nbytes,
     return 1;
 }
 
+/*
+ * Legacy CJK encodings such as GBK pass the tests above, for their
+ * characters are pairs of high bytes. Western text seldom has two
+ * high bytes in a row, so it isn't taken for 8-bit text when most
+ * of its high bytes are.
+ */
+static int looks_single_byte(const unsigned char *buf, size_t nbytes)
+{
+    size_t i, high = 0, paired = 0;
+
+    for (i = 0; i < nbytes; i++) {
+        if (buf[i] < 0x80)
+            continue;
+
+        high++;
+        if ((i > 0 && buf[i - 1] >= 0x80) ||
+            (i + 1 < nbytes && buf[i + 1] >= 0x80))
+        {
+            paired++;
+        }
+    }
+
+    return paired * 2 <= high;
+}
+
+/*
+ * Extended ASCII is decoded as Windows-1252, which leaves 0x81,
+ * 0x8d, 0x8f, 0x90 and 0x9d undefined.
+ */
+static int looks_cp1252(const unsigned char *buf, size_t nbytes)
+{
+    size_t i;
+
+    for (i = 0; i < nbytes; i++) {
+        switch (buf[i]) {
+        case 0x81: case 0x8d: case 0x8f: case 0x90: case 0x9d:
+            return 0;
+        }
+    }
+
+    return looks_single_byte(buf, nbytes);
+}
+
 /*
  * Decide whether some text looks like UTF-8. Returns:
  *
@@ -353,10 +397,13 @@ int mume_encoding_check(const unsigned char *buf, size_t nbytes,
         }
     }
     else if (looks_latin1(buf, nbytes, ubuf, &ulen)) {
+        /* Pairs of high bytes are likely CJK, leave it unknown. */
+        if (looks_single_byte(buf, nbytes))
             encoding = MUME_ENCODING_ISO_8859;
     }
     else if (looks_extended(buf, nbytes, ubuf, &ulen)) {
-        encoding = MUME_ENCODING_EXTENDED_ASCII;
+        if (looks_cp1252(buf, nbytes))
+            encoding = MUME_ENCODING_EXTENDED_ASCII;
     }
     else {
         unsigned char *nbuf = NULL;
@@ -385,3 +432,148 @@ int mume_encoding_check(const unsigned char *buf, size_t nbytes,
 
     return encoding;
 }
+
+/*
+ * Characters 0x80 - 0x9f of Windows-1252, which is the most common
+ * of the extended ASCII encodings. The others are Latin-1.
+ */
+static unsigned short cp1252_to_ucs[] = {
+0x20ac,0x0081,0x201a,0x0192,0x201e,0x2026,0x2020,0x2021,
+0x02c6,0x2030,0x0160,0x2039,0x0152,0x008d,0x017d,0x008f,
+0x0090,0x2018,0x2019,0x201c,0x201d,0x2022,0x2013,0x2014,
+0x02dc,0x2122,0x0161,0x203a,0x0153,0x009d,0x017e,0x0178
+};
+
+static char* put_utf8(char *out, unsigned int c)
+{
+    if (c < 0x80) {
+        *out++ = c;
+    }
+    else if (c < 0x800) {
+        *out++ = 0xc0 | (c >> 6);
+        *out++ = 0x80 | (c & 0x3f);
+    }
+    else if (c < 0x10000) {
+        *out++ = 0xe0 | (c >> 12);
+        *out++ = 0x80 | ((c >> 6) & 0x3f);
+        *out++ = 0x80 | (c & 0x3f);
+    }
+    else {
+        *out++ = 0xf0 | (c >> 18);
+        *out++ = 0x80 | ((c >> 12) & 0x3f);
+        *out++ = 0x80 | ((c >> 6) & 0x3f);
+        *out++ = 0x80 | (c & 0x3f);
+    }
+
+    return out;
+}
+
+static size_t decode_ucs16(
+    const unsigned char *buf, size_t nbytes,
+    size_t *used, char *out, int bigend)
+{
+    char *begin = out;
+    unsigned int c, d;
+    size_t i;
+
+#define UNIT(_i) (bigend ? buf[_i] * 256 + buf[(_i) + 1] : \
+                  buf[_i] + 256 * buf[(_i) + 1])
+
+    for (i = 0; i + 1 < nbytes; i += 2) {
+        c = UNIT(i);
+
+        if (c >= 0xd800 && c < 0xdc00) {
+            /* Surrogate pair, four bytes make up six at most. */
+            if (i + 3 >= nbytes)
+                break;
+
+            d = UNIT(i + 2);
+            if (d >= 0xdc00 && d < 0xe000) {
+                c = 0x10000 + ((c - 0xd800) << 10) + (d - 0xdc00);
+                i += 2;
+            }
+            else {
+                c = 0xfffd;
+            }
+        }
+        else if (c >= 0xdc00 && c < 0xe000) {
+            c = 0xfffd;
+        }
+
+        out = put_utf8(out, c);
+    }
+
+#undef UNIT
+
+    *used = i;
+    return out - begin;
+}
+
+size_t mume_encoding_bom_size(
+    int encoding, const unsigned char *buf, size_t nbytes)
+{
+    switch (encoding) {
+    case MUME_ENCODING_UTF8_BOM:
+        if (nbytes >= 3 && buf[0] == 0xef &&
+            buf[1] == 0xbb && buf[2] == 0xbf)
+        {
+            return 3;
+        }
+        break;
+
+    case MUME_ENCODING_UTF16_LE:
+        if (nbytes >= 2 && buf[0] == 0xff && buf[1] == 0xfe)
+            return 2;
+        break;
+
+    case MUME_ENCODING_UTF16_BE:
+        if (nbytes >= 2 && buf[0] == 0xfe && buf[1] == 0xff)
+            return 2;
+        break;
+    }
+
+    return 0;
+}
+
+size_t mume_encoding_decode(
+    int encoding, const unsigned char *buf, size_t nbytes,
+    size_t *used, char *out)
+{
+    char *begin = out;
+    unsigned int c;
+    size_t i;
+
+    switch (encoding) {
+    case MUME_ENCODING_UTF16_LE:
+        return decode_ucs16(buf, nbytes, used, out, 0);
+
+    case MUME_ENCODING_UTF16_BE:
+        return decode_ucs16(buf, nbytes, used, out, 1);
+
+    case MUME_ENCODING_ISO_8859:
+    case MUME_ENCODING_EXTENDED_ASCII:
+    case MUME_ENCODING_EBCDIC:
+    case MUME_ENCODING_INTERNATIONAL_EBCDIC:
+        for (i = 0; i < nbytes; ++i) {
+            c = buf[i];
+            if (encoding >= MUME_ENCODING_EBCDIC) {
+                c = ebcdic_to_ascii[c];
+            }
+            else if (encoding == MUME_ENCODING_EXTENDED_ASCII &&
+                     c >= 0x80 && c < 0xa0)
+            {
+                c = cp1252_to_ucs[c - 0x80];
+            }
+
+            out = put_utf8(out, c);
+        }
+
+        *used = nbytes;
+        return out - begin;
+    }
+
+    /* ASCII and UTF-8 are copied. */
+    memcpy(out, buf, nbytes);
+    *used = nbytes;
+    return nbytes;
+}
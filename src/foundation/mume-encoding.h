@@ -41,6 +41,25 @@ mume_public int mume_encoding_check(
     const unsigned char *buf, size_t nbytes,
     unsigned int **ubuf, size_t *ulen);
 
+/* Size of the byte order mark <buf> starts with for <encoding>. */
+mume_public size_t mume_encoding_bom_size(
+    int encoding, const unsigned char *buf, size_t nbytes);
+
+/* Nonzero if the text of <encoding> needs decoding to UTF-8. */
+#define mume_encoding_need_decode(_encoding) \
+    ((_encoding) > MUME_ENCODING_UTF8)
+
+/* Decode the text of <encoding> in <buf> to UTF-8 in <out>, which
+ * must hold MUME_ENCODING_UTF8_SIZE(nbytes) bytes. An incomplete
+ * character at the end is left, <*used> is set to the bytes
+ * decoded so it can be continued with the following text. Return
+ * the bytes written to <out>. */
+mume_public size_t mume_encoding_decode(
+    int encoding, const unsigned char *buf, size_t nbytes,
+    size_t *used, char *out);
+
+#define MUME_ENCODING_UTF8_SIZE(_nbytes) ((_nbytes) * 3)
+
 MUME_END_DECLS
 
 #endif /* MUME_FOUNDATION_ENCODING_H */
@@ -0,0 +1,258 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-filemon.h"
+#include "mume-config.h"
+#include "mume-debug.h"
+#include "mume-events.h"
+#include "mume-gstate.h"
+#include "mume-memory.h"
+#include "mume-thread.h"
+#include "mume-timer.h"
+#include MUME_ERRNO_H
+#include MUME_STRING_H
+#include <sys/stat.h>
+
+#if HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+/* Milliseconds between two checks, or two notifications. */
+#define _FILEMON_INTERVAL 500
+
+/* The file is written, its attributes changed such as by touch, or
+ * it's moved or deleted, such as replaced by an editor saving it
+ * with a rename. */
+#define _FILEMON_EVENTS \
+    (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+
+struct mume_filemon_s {
+    void *window;
+    int code;
+    char *path;
+    struct stat stat;           /* Last checked status. */
+    mume_timer_t *timer;        /* Check the status if not NULL. */
+#if HAVE_SYS_INOTIFY_H
+    int fd;                     /* Inotify instance. */
+    int wd;                     /* Watch of the path, -1 if none. */
+    dev_t dev;                  /* File watched. */
+    ino_t ino;
+    int quit[2];                /* Pipe to stop the thread. */
+    mume_thread_t *thread;
+#endif
+};
+
+static void _filemon_notify(mume_filemon_t *self)
+{
+    mume_post_event(mume_make_notify_event(
+        self->window, self->window, self->code, NULL));
+}
+
+static int _filemon_check(mume_timer_t *tmr)
+{
+    mume_filemon_t *self = mume_timer_data(tmr);
+    struct stat st;
+
+    if (0 == stat(self->path, &st) &&
+        (st.st_size != self->stat.st_size ||
+         st.st_mtime != self->stat.st_mtime ||
+         st.st_ino != self->stat.st_ino))
+    {
+        self->stat = st;
+        _filemon_notify(self);
+    }
+
+    return _FILEMON_INTERVAL;
+}
+
+#if HAVE_SYS_INOTIFY_H
+
+static int _filemon_drain(mume_filemon_t *self)
+{
+    /* Drain the events, return nonzero if any is of the file
+     * watched, the ones of the watches removed are ignored. */
+    union {
+        struct inotify_event event;
+        char buf[1024];
+    } u;
+    struct inotify_event *event;
+    ssize_t i, n;
+    int changed = 0;
+
+    while ((n = read(self->fd, u.buf, sizeof(u.buf))) > 0) {
+        for (i = 0; i < n; i += sizeof(*event) + event->len) {
+            event = (struct inotify_event*)(u.buf + i);
+            if (event->wd == self->wd)
+                changed = 1;
+        }
+    }
+
+    return changed;
+}
+
+static int _filemon_rewatch(mume_filemon_t *self)
+{
+    /* The file watched is moved, or deleted, the one at the path
+     * now is watched instead, such as one moved there by an editor
+     * saving with a rename. Return nonzero if it's a new file. */
+    struct stat st;
+
+    if (stat(self->path, &st)) {
+        if (self->wd >= 0)
+            inotify_rm_watch(self->fd, self->wd);
+
+        self->wd = -1;
+        return 0;
+    }
+
+    if (self->wd >= 0 && st.st_dev == self->dev && st.st_ino == self->ino)
+        return 0;
+
+    if (self->wd >= 0)
+        inotify_rm_watch(self->fd, self->wd);
+
+    self->wd = inotify_add_watch(self->fd, self->path, _FILEMON_EVENTS);
+    self->dev = st.st_dev;
+    self->ino = st.st_ino;
+    return self->wd >= 0;
+}
+
+static void _filemon_proc(void *p)
+{
+    mume_filemon_t *self = p;
+    struct pollfd fds[2];
+    int changed;
+
+    fds[0].fd = self->quit[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = self->fd;
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        /* The path is checked every interval while it's gone. */
+        if (poll(fds, 2, self->wd < 0 ? _FILEMON_INTERVAL : -1) < 0) {
+            if (EINTR == errno)
+                continue;
+
+            mume_error(("poll: %s\n", strerror(errno)));
+            break;
+        }
+
+        if (fds[0].revents)
+            break;
+
+        /* The events coming in the next interval are merged with
+         * the ones drained. */
+        changed = _filemon_drain(self);
+        if (_filemon_rewatch(self))
+            changed = 1;
+
+        if (!changed)
+            continue;
+
+        _filemon_notify(self);
+
+        if (poll(fds, 1, _FILEMON_INTERVAL) > 0)
+            break;
+    }
+}
+
+static int _filemon_watch(mume_filemon_t *self)
+{
+    self->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (self->fd < 0)
+        return 0;
+
+    self->wd = inotify_add_watch(self->fd, self->path, _FILEMON_EVENTS);
+    self->dev = self->stat.st_dev;
+    self->ino = self->stat.st_ino;
+    if (self->wd < 0 || pipe(self->quit))
+    {
+        close(self->fd);
+        return 0;
+    }
+
+    self->thread = mume_thread_new(_filemon_proc, self);
+    if (NULL == self->thread) {
+        close(self->quit[0]);
+        close(self->quit[1]);
+        close(self->fd);
+        return 0;
+    }
+
+    return 1;
+}
+
+static void _filemon_unwatch(mume_filemon_t *self)
+{
+    if (write(self->quit[1], "q", 1) < 0)
+        mume_error(("write: %s\n", strerror(errno)));
+
+    mume_thread_join(self->thread);
+    mume_thread_delete(self->thread);
+    close(self->quit[0]);
+    close(self->quit[1]);
+    close(self->fd);
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
+
+mume_filemon_t* mume_filemon_new(
+    const char *path, void *window, int code)
+{
+    mume_filemon_t *self;
+    struct stat st;
+
+    if (stat(path, &st)) {
+        mume_warning(("Monitor file error: \"%s\"\n", path));
+        return NULL;
+    }
+
+    self = malloc_struct(mume_filemon_t);
+    self->window = window;
+    self->code = code;
+    self->path = strdup_abort(path);
+    self->stat = st;
+    self->timer = NULL;
+
+#if HAVE_SYS_INOTIFY_H
+    if (_filemon_watch(self))
+        return self;
+#endif
+
+    self->timer = mume_timer_new(_filemon_check, self);
+    mume_schedule_timer(self->timer, _FILEMON_INTERVAL);
+    return self;
+}
+
+void mume_filemon_delete(mume_filemon_t *self)
+{
+    if (self->timer) {
+        mume_cancel_timer(self->timer);
+        mume_timer_delete(self->timer);
+    }
+#if HAVE_SYS_INOTIFY_H
+    else {
+        _filemon_unwatch(self);
+    }
+#endif
+
+    free(self->path);
+    free(self);
+}
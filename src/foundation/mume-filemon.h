@@ -0,0 +1,42 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_FOUNDATION_FILEMON_H
+#define MUME_FOUNDATION_FILEMON_H
+
+/* The file monitor tells a window when a local file is modified,
+ * by posting a MUME_EVENT_NOTIFY of <code> with the window as both
+ * the target and the source. The file is watched with inotify where
+ * it's available, otherwise its size, modification time and inode
+ * are checked by a timer of the GUI thread. The notifications of a
+ * burst of writes are merged into one. A file moved or deleted is
+ * followed by the one at the path later, such as one replaced by an
+ * editor saving with a rename. */
+
+#include "mume-common.h"
+
+MUME_BEGIN_DECLS
+
+/* Return NULL if <path> doesn't exist. */
+mume_public mume_filemon_t* mume_filemon_new(
+    const char *path, void *window, int code);
+
+mume_public void mume_filemon_delete(mume_filemon_t *self);
+
+MUME_END_DECLS
+
+#endif /* MUME_FOUNDATION_FILEMON_H */
@@ -27,10 +27,10 @@
 #include "mume-debug.h"
 #include "mume-events.h"
 #include "mume-frontend.h"
-#include "mume-list.h"
 #include "mume-memory.h"
 #include "mume-oset.h"
 #include "mume-resmgr.h"
+#include "mume-ringq.h"
 #include "mume-text-layout.h"
 #include "mume-thread.h"
 #include "mume-timer.h"
@@ -44,6 +44,24 @@ struct _datafmt_info {
     void *object;
 };
 
+struct _invocation {
+    void (*proc)(void *arg);
+    void *arg;
+};
+
+struct _send_request {
+    mume_event_t *event;
+    mume_sem_t *done;
+    int result;
+};
+
+/* Events sent from other threads share the queue with the posted
+ * ones, so they are dispatched in order. */
+struct _queued_event {
+    mume_event_t event;
+    struct _send_request *send;
+};
+
 struct _gstate {
     void *frontend;
     void *backend;
@@ -53,11 +71,13 @@ struct _gstate {
     void *text_layout;
     mume_oset_t *datafmts;
     mume_resmgr_t *resmgr;
-    mume_list_t *event_list;
-    mume_mutex_t *event_mutex;
+    mume_ringq_t *events;
+    char coalesce[MUME_NUM_EVENTS];
+    unsigned int folded[MUME_NUM_EVENTS];
+    mume_ringq_t *invocations;
+    mume_thread_id_t *thread;
     mume_timerq_t *timer_queue;
     void *root_window;
-    int blocking;
 };
 
 const char *_mume_argv0;
@@ -69,10 +89,16 @@ static void _datafmt_info_destruct(void *obj, void *p)
     mume_delete(((struct _datafmt_info*)obj)->object);
 }
 
+/* Preallocated slots of the event queue, bursts beyond it spill
+ * into an overflow list rather than being dropped. */
+#define _EVENT_QUEUE_SIZE 1024
+#define _INVOCATION_QUEUE_SIZE 256
+
 static int _extract_dirty_event(void)
 {
     int i, n;
-    mume_event_t event;
+    struct _queued_event queued;
+    mume_expose_event_t *event = &queued.event.expose;
     mume_rect_t rect;
     const cairo_region_t *rgn;
     if (!mume_urgnmgr_pop_urgn(_mume_gstate->urgnmgr))
@@ -80,20 +106,170 @@ static int _extract_dirty_event(void)
 
     rgn = mume_urgnmgr_last_rgn(_mume_gstate->urgnmgr);
     n = cairo_region_num_rectangles(rgn);
-    event.expose.type = MUME_EVENT_EXPOSE;
-    event.expose.window = (void*)mume_urgnmgr_last_win(
+    event->type = MUME_EVENT_EXPOSE;
+    event->window = (void*)mume_urgnmgr_last_win(
         _mume_gstate->urgnmgr);
+    queued.send = NULL;
 
     for (i = 0; i < n; ++i) {
         cairo_region_get_rectangle(rgn, i, &rect);
-        event.expose.x = rect.x;
-        event.expose.y = rect.y;
-        event.expose.width = rect.width;
-        event.expose.height = rect.height;
-        event.expose.count = n - i - 1;
-        memcpy(mume_list_data(mume_list_push_back(
-            _mume_gstate->event_list, sizeof(mume_event_t))),
-               &event, sizeof(mume_event_t));
+        event->x = rect.x;
+        event->y = rect.y;
+        event->width = rect.width;
+        event->height = rect.height;
+        event->count = n - i - 1;
+        mume_ringq_push(_mume_gstate->events, &queued);
+    }
+
+    return 1;
+}
+
+/* Fold <queued> into <event> if they are both parts of one change. */
+static int _coalesce_event(
+    mume_event_t *event, const struct _queued_event *queued)
+{
+    const mume_event_t *next = &queued->event;
+
+    if (queued->send || next->type != event->type ||
+        !_mume_gstate->coalesce[event->type])
+    {
+        return 0;
+    }
+
+    switch (event->type) {
+    case MUME_EVENT_MOUSEMOTION:
+        if (next->motion.window != event->motion.window ||
+            next->motion.state != event->motion.state)
+        {
+            return 0;
+        }
+
+        event->motion.x = next->motion.x;
+        event->motion.y = next->motion.y;
+        break;
+
+    case MUME_EVENT_RESIZE:
+        if (next->resize.event != event->resize.event ||
+            next->resize.window != event->resize.window)
+        {
+            return 0;
+        }
+
+        /* Keep the old size of the first one. */
+        event->resize.width = next->resize.width;
+        event->resize.height = next->resize.height;
+        break;
+
+    case MUME_EVENT_SCROLL:
+        if (next->scroll.event != event->scroll.event ||
+            next->scroll.window != event->scroll.window ||
+            next->scroll.hitcode != event->scroll.hitcode)
+        {
+            return 0;
+        }
+
+        event->scroll.position = next->scroll.position;
+        break;
+
+    default:
+        return 0;
+    }
+
+    ++_mume_gstate->folded[event->type];
+    return 1;
+}
+
+/* Dispatch the sent events at the front of the queue, they are
+ * never returned to the caller. Return the front posted event. */
+static struct _queued_event* _front_event(void)
+{
+    struct _queued_event *front;
+    struct _send_request *send;
+    while ((front = mume_ringq_front(_mume_gstate->events)) &&
+           front->send)
+    {
+        /* The handler may run a nested event loop. */
+        send = front->send;
+        mume_ringq_pop_front(_mume_gstate->events);
+        mume_disp_event(send->event);
+        send->result = 1;
+        mume_sem_post(send->done);
+    }
+
+    return front;
+}
+
+/* Retrieve the front event, folding the following ones. */
+static void _pop_event(mume_event_t *event)
+{
+    struct _queued_event *front = mume_ringq_front(
+        _mume_gstate->events);
+
+    assert(front && NULL == front->send);
+
+    if (NULL == event) {
+        mume_ringq_pop_front(_mume_gstate->events);
+        return;
+    }
+
+    memcpy(event, &front->event, sizeof(mume_event_t));
+    mume_ringq_pop_front(_mume_gstate->events);
+    while ((front = mume_ringq_front(_mume_gstate->events)) &&
+           _coalesce_event(event, front))
+    {
+        mume_ringq_pop_front(_mume_gstate->events);
+    }
+}
+
+/* Run the functions queued by mume_invoke_async. */
+static int _process_invocations(void)
+{
+    int count = 0;
+    struct _invocation *front, invocation;
+    while ((front = mume_ringq_front(_mume_gstate->invocations))) {
+        /* The function may run a nested event loop. */
+        invocation = *front;
+        mume_ringq_pop_front(_mume_gstate->invocations);
+        invocation.proc(invocation.arg);
+        ++count;
+    }
+
+    return count;
+}
+
+/* Both queues must be empty before the GUI thread blocks, the
+ * posters wake it up after this. */
+static int _prepare_wait(void)
+{
+    if (!mume_ringq_prepare_wait(_mume_gstate->events))
+        return 0;
+
+    if (!mume_ringq_prepare_wait(_mume_gstate->invocations)) {
+        mume_ringq_finish_wait(_mume_gstate->events);
+        return 0;
+    }
+
+    return 1;
+}
+
+static void _finish_wait(void)
+{
+    mume_ringq_finish_wait(_mume_gstate->invocations);
+    mume_ringq_finish_wait(_mume_gstate->events);
+}
+
+/* Remove the events of window <p>, or all the events if <p> is
+ * NULL. The senders are released with failure. */
+static int _event_of_window(const void *elt, void *p)
+{
+    const struct _queued_event *queued = elt;
+
+    if (p && queued->event.any.window != p)
+        return 0;
+
+    if (queued->send) {
+        queued->send->result = 0;
+        mume_sem_post(queued->send->done);
     }
 
     return 1;
@@ -127,11 +303,18 @@ int mume_gui_initialize(void *frontend, void *backend)
     _mume_gstate->datafmts = mume_oset_new(
         _mume_type_string_compare, _datafmt_info_destruct, NULL);
     _mume_gstate->resmgr = mume_resmgr_new();
-    _mume_gstate->event_list = mume_list_new(NULL, NULL);
-    _mume_gstate->event_mutex = mume_mutex_new();
+    _mume_gstate->events = mume_ringq_new(
+        sizeof(struct _queued_event), _EVENT_QUEUE_SIZE);
+    memset(_mume_gstate->coalesce, 0, sizeof(_mume_gstate->coalesce));
+    memset(_mume_gstate->folded, 0, sizeof(_mume_gstate->folded));
+    _mume_gstate->coalesce[MUME_EVENT_MOUSEMOTION] = 1;
+    _mume_gstate->coalesce[MUME_EVENT_RESIZE] = 1;
+    _mume_gstate->coalesce[MUME_EVENT_SCROLL] = 1;
+    _mume_gstate->invocations = mume_ringq_new(
+        sizeof(struct _invocation), _INVOCATION_QUEUE_SIZE);
+    _mume_gstate->thread = mume_thread_id_new();
     _mume_gstate->timer_queue = mume_timerq_new();
     _mume_gstate->root_window = mume_window_new(NULL, 0, 0, 0, 0);
-    _mume_gstate->blocking = 0;
 
     bwin = mume_backend_root_backwin(backend);
     mume_window_set_backwin(_mume_gstate->root_window, bwin);
@@ -144,12 +327,17 @@ void mume_gui_uninitialize(void)
 {
     if (_mume_gstate) {
         int i;
+        _process_invocations();
         mume_delete(_mume_gstate->root_window);
+        /* Release the threads still waiting in mume_send_event. */
+        mume_ringq_remove_if(
+            _mume_gstate->events, _event_of_window, NULL);
+        mume_thread_id_delete(_mume_gstate->thread);
         mume_delete(_mume_gstate->text_layout);
         mume_resmgr_delete(_mume_gstate->resmgr);
         mume_timerq_delete(_mume_gstate->timer_queue);
-        mume_mutex_delete(_mume_gstate->event_mutex);
-        mume_list_delete(_mume_gstate->event_list);
+        mume_ringq_delete(_mume_gstate->invocations);
+        mume_ringq_delete(_mume_gstate->events);
 
         if (_mume_gstate->clipboard)
             mume_refobj_release(_mume_gstate->clipboard);
@@ -359,68 +547,68 @@ void mume_cancel_timer(mume_timer_t *timer)
 
 int mume_wait_event(mume_event_t *event)
 {
-    mume_mutex_lock(_mume_gstate->event_mutex);
-    while (mume_list_empty(_mume_gstate->event_list)) {
+    _process_invocations();
+    while (!_front_event()) {
         mume_timeval_t tv;
         int wait = MUME_WAIT_INFINITE;
-        mume_mutex_unlock(_mume_gstate->event_mutex);
         mume_backend_handle_event(_mume_gstate->backend, 0);
-        mume_mutex_lock(_mume_gstate->event_mutex);
-        if (!mume_list_empty(_mume_gstate->event_list) ||
-            _extract_dirty_event())
+        if (_process_invocations() ||
+            !mume_ringq_empty(_mume_gstate->events) ||
+            _extract_dirty_event() || !_prepare_wait())
         {
-            break;
+            continue;
         }
 
-        _mume_gstate->blocking = 1;
-        mume_mutex_unlock(_mume_gstate->event_mutex);
         if (mume_timerq_check(_mume_gstate->timer_queue, &tv)) {
             wait = tv.tv_sec * MUME_MSECS_PER_SEC +
                    tv.tv_usec / MUME_USECS_PER_MSEC;
         }
 
         mume_backend_handle_event(_mume_gstate->backend, wait);
-        mume_mutex_lock(_mume_gstate->event_mutex);
-        _mume_gstate->blocking = 0;
+        _finish_wait();
     }
 
-    if (event) {
-        memcpy(event, mume_list_data(mume_list_front(
-            _mume_gstate->event_list)), sizeof(mume_event_t));
-    }
-
-    mume_list_pop_front(_mume_gstate->event_list);
-    mume_mutex_unlock(_mume_gstate->event_mutex);
+    _pop_event(event);
     return 1;
 }
 
 int mume_peek_event(mume_event_t *event, int remove)
 {
-    int result = 1;
+    struct _queued_event *front;
     mume_timerq_check(_mume_gstate->timer_queue, NULL);
-    mume_mutex_lock(_mume_gstate->event_mutex);
-    if (mume_list_empty(_mume_gstate->event_list)) {
-        mume_mutex_unlock(_mume_gstate->event_mutex);
+    _process_invocations();
+    front = _front_event();
+    if (NULL == front) {
         mume_backend_handle_event(_mume_gstate->backend, 0);
-        mume_mutex_lock(_mume_gstate->event_mutex);
+        _process_invocations();
+        front = _front_event();
+        if (NULL == front && _extract_dirty_event())
+            front = _front_event();
 
-        if (mume_list_empty(_mume_gstate->event_list) &&
-            !_extract_dirty_event())
-        {
-            result = 0;
-        }
+        if (NULL == front)
+            return 0;
     }
 
-    if (result && event) {
-        memcpy(event, mume_list_data(mume_list_front(
-            _mume_gstate->event_list)), sizeof(mume_event_t));
-
+    if (event) {
         if (remove)
-            mume_list_pop_front(_mume_gstate->event_list);
+            _pop_event(event);
+        else
+            memcpy(event, &front->event, sizeof(mume_event_t));
     }
 
-    mume_mutex_unlock(_mume_gstate->event_mutex);
-    return result;
+    return 1;
+}
+
+void mume_coalesce_events(int type, int enable)
+{
+    assert(type >= 0 && type < MUME_NUM_EVENTS);
+    _mume_gstate->coalesce[type] = (enable != 0);
+}
+
+unsigned int mume_folded_events(int type)
+{
+    assert(type >= 0 && type < MUME_NUM_EVENTS);
+    return _mume_gstate->folded[type];
 }
 
 void mume_disp_event(mume_event_t *event)
@@ -436,8 +624,46 @@ void mume_disp_event(mume_event_t *event)
 
 int mume_send_event(mume_event_t *event)
 {
-    /* TODO: implement multi thread send */
-    mume_disp_event(event);
+    struct _send_request req;
+    struct _queued_event queued;
+
+    assert(_mume_gstate);
+
+    if (NULL == _mume_gstate)
+        return 0;
+
+    if (mume_thread_is_self(_mume_gstate->thread)) {
+        mume_disp_event(event);
+        return 1;
+    }
+
+    req.event = event;
+    req.done = mume_sem_new();
+    req.result = 0;
+    queued.event = *event;
+    queued.send = &req;
+    if (mume_ringq_push(_mume_gstate->events, &queued))
+        mume_backend_wakeup_event(_mume_gstate->backend);
+
+    mume_sem_wait(req.done);
+    mume_sem_delete(req.done);
+    return req.result;
+}
+
+int mume_invoke_async(void (*proc)(void *arg), void *arg)
+{
+    struct _invocation invocation;
+
+    assert(_mume_gstate);
+
+    if (NULL == _mume_gstate)
+        return 0;
+
+    invocation.proc = proc;
+    invocation.arg = arg;
+    if (mume_ringq_push(_mume_gstate->invocations, &invocation))
+        mume_backend_wakeup_event(_mume_gstate->backend);
+
     return 1;
 }
 
@@ -448,48 +674,21 @@ int mume_send_message(mume_object_t *obj, mume_message_t *msg)
 
 int _mume_post_event(mume_event_t event, int wakeup)
 {
-    int result = 0;
-
-    mume_mutex_lock(_mume_gstate->event_mutex);
-
-    if (mume_list_size(_mume_gstate->event_list) < 256) {
-        memcpy(mume_list_data(mume_list_push_back(
-            _mume_gstate->event_list, sizeof(mume_event_t))),
-               &event, sizeof(mume_event_t));
-
-        result = 1;
-    }
-    else {
-        mume_warning(("event queue is full\n"));
-    }
-
-    if (wakeup && _mume_gstate->blocking)
+    struct _queued_event queued;
+    /* Lock free unless the queue overflows, so worker threads
+     * can post without contending with the GUI thread. */
+    queued.event = event;
+    queued.send = NULL;
+    if (mume_ringq_push(_mume_gstate->events, &queued) && wakeup)
         mume_backend_wakeup_event(_mume_gstate->backend);
 
-    mume_mutex_unlock(_mume_gstate->event_mutex);
-    return result;
+    return 1;
 }
 
 void _mume_window_clear_res(void *self)
 {
-    mume_event_t *event;
-    mume_list_node_t *node;
-    mume_list_node_t *next;
-
     /* Remove all events. */
-    mume_mutex_lock(_mume_gstate->event_mutex);
-    node = mume_list_front(_mume_gstate->event_list);
-    while (node) {
-        next = mume_list_next(node);
-        event = (mume_event_t*)mume_list_data(node);
-
-        if (event->any.window == self)
-            mume_list_erase(_mume_gstate->event_list, node);
-
-        node = next;
-    }
-
-    mume_mutex_unlock(_mume_gstate->event_mutex);
+    mume_ringq_remove_if(_mume_gstate->events, _event_of_window, self);
 
     assert(NULL == mume_window_get_urgn(self));
 
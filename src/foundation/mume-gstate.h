@@ -166,12 +166,36 @@ mume_public int mume_wait_event(mume_event_t *event);
  */
 mume_public int mume_peek_event(mume_event_t *event, int remove);
 
+/* Enable or disable folding consecutive events of <type> when
+ * they are retrieved, the last one is delivered in their place.
+ * Mouse motion (same window and state), resize (same receiver
+ * and window) and scroll (same receiver, window and hitcode)
+ * events are folded by default, other types are never folded.
+ */
+mume_public void mume_coalesce_events(int type, int enable);
+
+/* Number of <type> events folded away since GUI initialized. */
+mume_public unsigned int mume_folded_events(int type);
+
 /* Dispatch a event to the destination window. */
 mume_public void mume_disp_event(mume_event_t *event);
 
-/* Send a event to a window, wait until the event been processed. */
+/* Send a event to a window, wait until the event been processed.
+ *
+ * Called from another thread, the event is queued after the posted
+ * ones and dispatched on the GUI thread in order, the caller blocks
+ * until then. Return 0 if the window is destroyed before, or the
+ * GUI is uninitialized.
+ */
 mume_public int mume_send_event(mume_event_t *event);
 
+/* Call <proc> with <arg> on the GUI thread the next time it
+ * processes events, return immediately. May be called from
+ * any thread, but not after mume_gui_uninitialize, which is
+ * rejected with 0.
+ */
+mume_public int mume_invoke_async(void (*proc)(void *arg), void *arg);
+
 /* Send a message to the object, wait until the message
  * has been processed. */
 mume_public int mume_send_message(
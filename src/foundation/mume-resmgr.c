@@ -238,12 +238,13 @@ static FT_Face _resmgr_load_ft_face(mume_resmgr_t *mgr, const char *file)
     strm = malloc_abort(sizeof(*strm));
     strm->descriptor.pointer = stm;
     strm->pathname.pointer = NULL;
-    strm->base = NULL;
     strm->size = (unsigned long)mume_stream_length(stm);
     strm->pos = 0;
     strm->cursor = 0;
-    strm->read = _read_font_stream;
     strm->close = _close_font_stream;
+    /* Let FreeType access the font in place if it's mapped. */
+    strm->base = (unsigned char*)mume_stream_peek(stm, 0, strm->size);
+    strm->read = strm->base ? NULL : _read_font_stream;
     args.flags = FT_OPEN_STREAM;
     args.stream = strm;
     err = FT_Open_Face(mgr->ft_lib, &args, 0, &face);
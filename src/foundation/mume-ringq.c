@@ -0,0 +1,295 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-ringq.h"
+#include "mume-config.h"
+#include "mume-debug.h"
+#include "mume-list.h"
+#include "mume-memory.h"
+#include "mume-thread.h"
+#include MUME_ASSERT_H
+#include MUME_STDDEF_H
+#include MUME_STRING_H
+
+#ifdef HAVE_WINDOWS_H
+# include MUME_WINDOWS_H
+# define _ringq_pause() SwitchToThread()
+# define _ringq_barrier() MemoryBarrier()
+# define _ringq_cas(_ptr, _old, _new) \
+    ((size_t)InterlockedCompareExchangePointer( \
+        (PVOID volatile*)(_ptr), (PVOID)(_new), (PVOID)(_old)))
+#else
+# include <sched.h>
+# define _ringq_pause() sched_yield()
+# define _ringq_barrier() __sync_synchronize()
+# define _ringq_cas(_ptr, _old, _new) \
+    __sync_val_compare_and_swap(_ptr, _old, _new)
+#endif
+
+#define _RINGQ_CACHE_LINE 64
+
+/* Each slot carries a sequence number: <pos> when the slot is free
+ * for the producer of position <pos>, <pos> + 1 when it holds the
+ * element of <pos>, the consumer then frees it for <pos> + size. */
+struct _ringq_slot {
+    volatile size_t seq;
+    size_t reserved;
+};
+
+struct mume_ringq_s {
+    /* Producers only contend on tail, keep it off the
+     * cache line the consumer writes. */
+    volatile size_t tail;
+    char pad[_RINGQ_CACHE_LINE - sizeof(size_t)];
+    size_t head;
+    size_t mask;
+    size_t eltsize;
+    size_t slotsize;
+    char *slots;
+    /* Set while the overflow list isn't empty, producers must
+     * append to the list then to keep their order. */
+    volatile int overflowed;
+    volatile int waiting;
+    mume_mutex_t *mutex;
+    mume_list_t *overflow;
+};
+
+#define _slot_at(_q, _pos) ((struct _ringq_slot*)( \
+    (_q)->slots + ((_pos) & (_q)->mask) * (_q)->slotsize))
+
+#define _slot_data(_slot) ((char*)(_slot) + sizeof(struct _ringq_slot))
+
+static int _ringq_try_push(mume_ringq_t *q, const void *elt)
+{
+    struct _ringq_slot *slot;
+    size_t pos = q->tail;
+    size_t old;
+
+    for (;;) {
+        slot = _slot_at(q, pos);
+        if (slot->seq == pos) {
+            old = _ringq_cas(&q->tail, pos, pos + 1);
+            if (old == pos)
+                break;
+
+            pos = old;
+        }
+        else if ((ptrdiff_t)(slot->seq - pos) < 0) {
+            /* The consumer hasn't freed the slot yet. */
+            return 0;
+        }
+        else {
+            pos = q->tail;
+        }
+    }
+
+    memcpy(_slot_data(slot), elt, q->eltsize);
+    _ringq_barrier();
+    slot->seq = pos + 1;
+    return 1;
+}
+
+static struct _ringq_slot* _ringq_ready(mume_ringq_t *q, size_t pos)
+{
+    struct _ringq_slot *slot = _slot_at(q, pos);
+    if (slot->seq != pos + 1)
+        return NULL;
+
+    _ringq_barrier();
+    return slot;
+}
+
+static void _ringq_free_front(mume_ringq_t *q)
+{
+    struct _ringq_slot *slot = _slot_at(q, q->head);
+    assert(slot->seq == q->head + 1);
+    _ringq_barrier();
+    slot->seq = q->head + q->mask + 1;
+    ++q->head;
+}
+
+/* Move the spilled elements back to the ring. They are all newer
+ * than the elements in the ring, since producers append to the
+ * list as long as it isn't empty. */
+static void _ringq_refill(mume_ringq_t *q)
+{
+    mume_list_node_t *node;
+
+    mume_mutex_lock(q->mutex);
+    while ((node = mume_list_front(q->overflow))) {
+        if (!_ringq_try_push(q, mume_list_data(node)))
+            break;
+
+        mume_list_pop_front(q->overflow);
+    }
+
+    if (mume_list_empty(q->overflow))
+        q->overflowed = 0;
+
+    mume_mutex_unlock(q->mutex);
+}
+
+mume_ringq_t* mume_ringq_new(size_t eltsize, size_t capacity)
+{
+    size_t i, size = 2;
+    mume_ringq_t *q = malloc_struct(mume_ringq_t);
+
+    while (size < capacity)
+        size <<= 1;
+
+    q->tail = 0;
+    q->head = 0;
+    q->mask = size - 1;
+    q->eltsize = eltsize;
+    q->slotsize = sizeof(struct _ringq_slot) +
+                  (eltsize + sizeof(struct _ringq_slot) - 1) /
+                  sizeof(struct _ringq_slot) *
+                  sizeof(struct _ringq_slot);
+    q->slots = malloc_abort(size * q->slotsize);
+    for (i = 0; i < size; ++i)
+        _slot_at(q, i)->seq = i;
+
+    q->overflowed = 0;
+    q->waiting = 0;
+    q->mutex = mume_mutex_new();
+    q->overflow = mume_list_new(NULL, NULL);
+    return q;
+}
+
+void mume_ringq_delete(mume_ringq_t *q)
+{
+    mume_list_delete(q->overflow);
+    mume_mutex_delete(q->mutex);
+    free(q->slots);
+    free(q);
+}
+
+size_t mume_ringq_capacity(const mume_ringq_t *q)
+{
+    return q->mask + 1;
+}
+
+int mume_ringq_push(mume_ringq_t *q, const void *elt)
+{
+    if (q->overflowed || !_ringq_try_push(q, elt)) {
+        mume_mutex_lock(q->mutex);
+        if (q->overflowed || !_ringq_try_push(q, elt)) {
+            memcpy(mume_list_data(mume_list_push_back(
+                q->overflow, q->eltsize)), elt, q->eltsize);
+
+            q->overflowed = 1;
+        }
+
+        mume_mutex_unlock(q->mutex);
+    }
+
+    /* Publish the element before checking the consumer, pairs
+     * with the barrier in mume_ringq_prepare_wait. */
+    _ringq_barrier();
+    return q->waiting;
+}
+
+void* mume_ringq_front(mume_ringq_t *q)
+{
+    struct _ringq_slot *slot = _ringq_ready(q, q->head);
+    if (NULL == slot && q->overflowed) {
+        _ringq_refill(q);
+        slot = _ringq_ready(q, q->head);
+    }
+
+    return slot ? _slot_data(slot) : NULL;
+}
+
+void mume_ringq_pop_front(mume_ringq_t *q)
+{
+    _ringq_free_front(q);
+}
+
+size_t mume_ringq_remove_if(
+    mume_ringq_t *q, int (*pred)(const void *elt, void *p), void *p)
+{
+    size_t i, n, w;
+    struct _ringq_slot *slot;
+    mume_list_node_t *node;
+    mume_list_node_t *next;
+    size_t result;
+
+    /* Wait for the elements being copied into the slots taken
+     * before, so none of the elements pushed before is left. A
+     * producer fills its slot right after taking it. */
+    n = q->tail - q->head;
+    for (i = 0; i < n; ++i) {
+        while (NULL == _ringq_ready(q, q->head + i))
+            _ringq_pause();
+    }
+
+    /* Compact the elements toward the newest one, the producers
+     * never touch them, then free the front slots. */
+    w = n;
+    for (i = n; i-- > 0;) {
+        slot = _slot_at(q, q->head + i);
+        if (pred(_slot_data(slot), p))
+            continue;
+
+        --w;
+        if (w != i) {
+            memcpy(_slot_data(_slot_at(q, q->head + w)),
+                   _slot_data(slot), q->eltsize);
+        }
+    }
+
+    result = w;
+    while (w-- > 0)
+        _ringq_free_front(q);
+
+    if (q->overflowed) {
+        mume_mutex_lock(q->mutex);
+        node = mume_list_front(q->overflow);
+        while (node) {
+            next = mume_list_next(node);
+            if (pred(mume_list_data(node), p)) {
+                mume_list_erase(q->overflow, node);
+                ++result;
+            }
+
+            node = next;
+        }
+
+        if (mume_list_empty(q->overflow))
+            q->overflowed = 0;
+
+        mume_mutex_unlock(q->mutex);
+    }
+
+    return result;
+}
+
+int mume_ringq_prepare_wait(mume_ringq_t *q)
+{
+    q->waiting = 1;
+    _ringq_barrier();
+    if (mume_ringq_empty(q))
+        return 1;
+
+    q->waiting = 0;
+    return 0;
+}
+
+void mume_ringq_finish_wait(mume_ringq_t *q)
+{
+    q->waiting = 0;
+}
@@ -0,0 +1,68 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_FOUNDATION_RINGQ_H
+#define MUME_FOUNDATION_RINGQ_H
+
+#include "mume-common.h"
+
+MUME_BEGIN_DECLS
+
+/* A FIFO queue of fixed size elements with any number of producers
+ * and a single consumer. Elements are copied into a preallocated
+ * ring without locking, when the ring is full they spill into a
+ * mutex guarded list, so push never blocks and never drops. */
+mume_public mume_ringq_t* mume_ringq_new(size_t eltsize, size_t capacity);
+
+mume_public void mume_ringq_delete(mume_ringq_t *q);
+
+/* Capacity of the ring, <capacity> rounded up to a power of 2. */
+mume_public size_t mume_ringq_capacity(const mume_ringq_t *q);
+
+/* Append a copy of <elt>, may be called from any thread. Return
+ * nonzero if the consumer is waiting (see mume_ringq_prepare_wait)
+ * and should be woken up. */
+mume_public int mume_ringq_push(mume_ringq_t *q, const void *elt);
+
+/* The functions below are for the consumer thread only. */
+
+/* Return the oldest element or NULL if the queue is empty. */
+mume_public void* mume_ringq_front(mume_ringq_t *q);
+
+/* Remove the element returned by mume_ringq_front. */
+mume_public void mume_ringq_pop_front(mume_ringq_t *q);
+
+/* Remove the elements <pred> returns nonzero for, including the
+ * ones still being copied by the pushes started before, which are
+ * waited for. Elements pushed after may be left. Return the number
+ * of removed elements. */
+mume_public size_t mume_ringq_remove_if(
+    mume_ringq_t *q, int (*pred)(const void *elt, void *p), void *p);
+
+/* Announce the consumer is going to wait for new elements. Return
+ * zero if the queue isn't empty anymore, the consumer shouldn't
+ * wait then. Otherwise every later push returns nonzero until
+ * mume_ringq_finish_wait is called. */
+mume_public int mume_ringq_prepare_wait(mume_ringq_t *q);
+
+mume_public void mume_ringq_finish_wait(mume_ringq_t *q);
+
+#define mume_ringq_empty(_q) (NULL == mume_ringq_front(_q))
+
+MUME_END_DECLS
+
+#endif /* MUME_FOUNDATION_RINGQ_H */
@@ -33,6 +33,7 @@ struct _scrollview {
     int page_cy;
     int line_cx;
     int line_cy;
+    int blit;
 };
 
 MUME_STATIC_ASSERT(sizeof(struct _scrollview) ==
@@ -159,6 +160,7 @@ static void* _scrollview_ctor(
     self->page_cy = -1;
     self->line_cx = -1;
     self->line_cy = -1;
+    self->blit = 0;
 
     mume_scrollview_get_client(
         self, NULL, NULL, &width, &height);
@@ -403,7 +405,20 @@ void mume_scrollview_set_scroll(void *_self, int x, int y)
 
         mume_send_event(&event);
 
-        mume_invalidate_region(self, NULL);
+        if (self->blit) {
+            mume_rect_t rect;
+
+            mume_scrollview_get_client(
+                self, &rect.x, &rect.y, &rect.width, &rect.height);
+
+            mume_scroll_rect(
+                self, &rect,
+                pt.x - mume_scrollbar_get_pos(self->horz_bar),
+                pt.y - mume_scrollbar_get_pos(self->vert_bar));
+        }
+        else {
+            mume_invalidate_region(self, NULL);
+        }
     }
 }
 
@@ -420,6 +435,20 @@ void mume_scrollview_get_scroll(const void *_self, int *x, int *y)
         *y = mume_scrollbar_get_pos(self->vert_bar);
 }
 
+void mume_scrollview_set_blit(void *_self, int blit)
+{
+    struct _scrollview *self = _self;
+    assert(mume_is_of(_self, mume_scrollview_class()));
+    self->blit = blit;
+}
+
+int mume_scrollview_get_blit(const void *_self)
+{
+    const struct _scrollview *self = _self;
+    assert(mume_is_of(_self, mume_scrollview_class()));
+    return self->blit;
+}
+
 void mume_scrollview_get_client(
     const void *_self, int *x, int *y, int *w, int *h)
 {
@@ -24,7 +24,7 @@ MUME_BEGIN_DECLS
 
 #define MUME_SIZEOF_SCROLLVIEW (MUME_SIZEOF_WINDOW + \
                                 sizeof(void*) * 2 +  \
-                                sizeof(int) * 4)
+                                sizeof(int) * 5)
 
 #define MUME_SIZEOF_SCROLLVIEW_CLASS (MUME_SIZEOF_WINDOW_CLASS)
 
@@ -64,6 +64,14 @@ mume_public void mume_scrollview_set_scroll(
 mume_public void mume_scrollview_get_scroll(
     const void *self, int *x, int *y);
 
+/* Set/Get whether to move the existing pixels of the client
+ * area when scrolling, so only the newly exposed parts need to
+ * be repainted. It should only be enabled when the content is
+ * drawn entirely relative to the scroll position. */
+mume_public void mume_scrollview_set_blit(void *self, int blit);
+
+mume_public int mume_scrollview_get_blit(const void *self);
+
 mume_public void mume_scrollview_get_client(
     const void *self, int *x, int *y, int *w, int *h);
 
@@ -24,6 +24,13 @@
 #include MUME_STDLIB_H
 #include MUME_STRING_H
 
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 typedef struct _memory_stream_s {
     mume_stream_t base;
     char *buf;
@@ -35,8 +42,24 @@ typedef struct _memory_stream_s {
 typedef struct _file_stream_s {
     mume_stream_t base;
     FILE *fp;
+    char *path;
 } _file_stream_t;
 
+typedef struct _progress_stream_s {
+    mume_stream_t base;
+    mume_stream_t *stm;
+    int (*proc)(void*, size_t, size_t);
+    void *data;
+    int failed;
+} _progress_stream_t;
+
+/* A memory stream of the file mapped. */
+typedef struct _mmap_stream_s {
+    _memory_stream_t mem;
+    char *path;
+    int fd;                     /* Checks the size of the file. */
+} _mmap_stream_t;
+
 static char* _stream_printf(
     char *buf, int *len, const char *fmt, va_list ap)
 {
@@ -121,6 +144,15 @@ static void _memory_stream_close(void *self)
     free(stm);
 }
 
+static const void* _memory_stream_peek(
+    void *self, size_t pos, size_t len)
+{
+    _memory_stream_t *stm = self;
+    if (pos > stm->len || stm->len - pos < len)
+        return NULL;
+    return stm->buf + pos;
+}
+
 static size_t _file_stream_length(void *self)
 {
     FILE *fp = ((_file_stream_t*)self)->fp;
@@ -161,9 +193,190 @@ static size_t _file_stream_write(
 static void _file_stream_close(void *self)
 {
     fclose(((_file_stream_t*)self)->fp);
+    free(((_file_stream_t*)self)->path);
     free(self);
 }
 
+static struct mume_stream_i _file_stream_impl = {
+    _file_stream_length,
+    _file_stream_eof,
+    _file_stream_tell,
+    _file_stream_seek,
+    _file_stream_read,
+    _file_stream_write,
+    _file_stream_close,
+};
+
+static void _progress_stream_report(
+    _progress_stream_t *stm, size_t pos)
+{
+    if (stm->proc && !stm->failed &&
+        !stm->proc(stm->data, pos, mume_stream_length(stm->stm)))
+    {
+        stm->failed = 1;
+    }
+}
+
+static size_t _progress_stream_length(void *self)
+{
+    return mume_stream_length(((_progress_stream_t*)self)->stm);
+}
+
+static int _progress_stream_eof(void *self)
+{
+    return mume_stream_eof(((_progress_stream_t*)self)->stm);
+}
+
+static size_t _progress_stream_tell(void *self)
+{
+    return mume_stream_tell(((_progress_stream_t*)self)->stm);
+}
+
+static int _progress_stream_seek(void *self, size_t pos)
+{
+    return mume_stream_seek(((_progress_stream_t*)self)->stm, pos);
+}
+
+static size_t _progress_stream_read(
+    void *self, void *data, size_t len)
+{
+    _progress_stream_t *stm = self;
+
+    if (stm->failed)
+        return 0;
+
+    len = mume_stream_read(stm->stm, data, len);
+    _progress_stream_report(stm, mume_stream_tell(stm->stm));
+    return stm->failed ? 0 : len;
+}
+
+static size_t _progress_stream_write(
+    void *self, const void *data, size_t len)
+{
+    return mume_stream_write(((_progress_stream_t*)self)->stm, data, len);
+}
+
+static void _progress_stream_close(void *self)
+{
+    _progress_stream_t *stm = self;
+    mume_stream_close(stm->stm);
+    free(stm);
+}
+
+static const void* _progress_stream_peek(
+    void *self, size_t pos, size_t len)
+{
+    _progress_stream_t *stm = self;
+    const void *result;
+
+    if (stm->failed)
+        return NULL;
+
+    result = mume_stream_peek(stm->stm, pos, len);
+    if (result)
+        _progress_stream_report(stm, pos + len);
+
+    return stm->failed ? NULL : result;
+}
+
+static struct mume_stream_i _progress_stream_impl = {
+    _progress_stream_length,
+    _progress_stream_eof,
+    _progress_stream_tell,
+    _progress_stream_seek,
+    _progress_stream_read,
+    _progress_stream_write,
+    _progress_stream_close,
+    _progress_stream_peek,
+};
+
+#if HAVE_SYS_MMAN_H
+
+static size_t _mmap_stream_size(_mmap_stream_t *stm)
+{
+    /* Pages of the mapping past the end of a file truncated fault
+     * when accessed, only the data still in the file is used. */
+    struct stat st;
+
+    if (fstat(stm->fd, &st) || (off_t)stm->mem.len <= st.st_size)
+        return stm->mem.len;
+
+    return st.st_size;
+}
+
+static size_t _mmap_stream_length(void *self)
+{
+    return _mmap_stream_size(self);
+}
+
+static int _mmap_stream_eof(void *self)
+{
+    _mmap_stream_t *stm = self;
+    return stm->mem.cur >= _mmap_stream_size(stm);
+}
+
+static size_t _mmap_stream_read(
+    void *self, void *data, size_t len)
+{
+    _mmap_stream_t *stm = self;
+    size_t size = _mmap_stream_size(stm);
+    ssize_t result;
+
+    if (stm->mem.len - stm->mem.cur < len)
+        len = stm->mem.len - stm->mem.cur;
+
+    if (stm->mem.cur <= size && size - stm->mem.cur >= len)
+        return _memory_stream_read(self, data, len);
+
+    /* Read the file truncated instead, which doesn't fault. */
+    result = pread(stm->fd, data, len, stm->mem.cur);
+    if (result <= 0)
+        return 0;
+
+    stm->mem.cur += result;
+    return result;
+}
+
+static size_t _mmap_stream_write(
+    void *self, const void *data, size_t len)
+{
+    return 0;
+}
+
+static void _mmap_stream_close(void *self)
+{
+    _mmap_stream_t *stm = self;
+    munmap(stm->mem.buf, stm->mem.len);
+    close(stm->fd);
+    free(stm->path);
+    free(stm);
+}
+
+static const void* _mmap_stream_peek(
+    void *self, size_t pos, size_t len)
+{
+    _mmap_stream_t *stm = self;
+    size_t size = _mmap_stream_size(stm);
+
+    if (pos > size || size - pos < len)
+        return NULL;
+
+    return stm->mem.buf + pos;
+}
+
+static struct mume_stream_i _mmap_stream_impl = {
+    _mmap_stream_length,
+    _mmap_stream_eof,
+    _memory_stream_tell,
+    _memory_stream_seek,
+    _mmap_stream_read,
+    _mmap_stream_write,
+    _mmap_stream_close,
+    _mmap_stream_peek,
+};
+
+#endif /* HAVE_SYS_MMAN_H */
+
 /* This byteorder stuff was lifted from SDL. */
 #define MUME_LITTLE_ENDIAN  1234
 #define MUME_BIG_ENDIAN  4321
@@ -253,6 +466,7 @@ mume_stream_t* mume_memory_stream_open(
         _memory_stream_read,
         _memory_stream_write,
         _memory_stream_close,
+        _memory_stream_peek,
     };
     _memory_stream_t *stm = malloc_struct(_memory_stream_t);
     stm->buf = buf;
@@ -266,15 +480,6 @@ mume_stream_t* mume_memory_stream_open(
 
 mume_stream_t* mume_file_stream_open(const char *text, int mode)
 {
-    static struct mume_stream_i _impl = {
-        _file_stream_length,
-        _file_stream_eof,
-        _file_stream_tell,
-        _file_stream_seek,
-        _file_stream_read,
-        _file_stream_write,
-        _file_stream_close,
-    };
     const char *fm = "";
     FILE *fp;
     _file_stream_t *stm;
@@ -298,12 +503,93 @@ mume_stream_t* mume_file_stream_open(const char *text, int mode)
 
     stm = malloc_struct(_file_stream_t);
     stm->fp = fp;
-    stm->base.impl = &_impl;
+    stm->path = strdup_abort(text);
+    stm->base.impl = &_file_stream_impl;
     stm->base.refcount = 0;
 
     return (mume_stream_t*)stm;
 }
 
+mume_stream_t* mume_mmap_stream_open(const char *text)
+{
+#if HAVE_SYS_MMAN_H
+    _mmap_stream_t *stm;
+    struct stat st;
+    void *buf;
+    int fd;
+
+    fd = open(text, O_RDONLY);
+    if (fd < 0) {
+        mume_warning(("Open file error: \"%s\"\n", text));
+        return NULL;
+    }
+
+    /* Pipes, devices and empty files can't be mapped. */
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || 0 == st.st_size ||
+        (off_t)(size_t)st.st_size != st.st_size)
+    {
+        close(fd);
+        return mume_file_stream_open(text, MUME_OM_READ);
+    }
+
+    buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == buf) {
+        close(fd);
+        return mume_file_stream_open(text, MUME_OM_READ);
+    }
+
+    stm = malloc_struct(_mmap_stream_t);
+    stm->mem.buf = buf;
+    stm->mem.len = st.st_size;
+    stm->mem.cur = 0;
+    stm->mem.des = NULL;
+    stm->mem.base.impl = &_mmap_stream_impl;
+    stm->mem.base.refcount = 0;
+    stm->path = strdup_abort(text);
+    stm->fd = fd;
+    return (mume_stream_t*)stm;
+#else
+    return mume_file_stream_open(text, MUME_OM_READ);
+#endif
+}
+
+mume_stream_t* mume_progress_stream_open(
+    mume_stream_t *stm, int (*proc)(void*, size_t, size_t), void *data)
+{
+    _progress_stream_t *result = malloc_struct(_progress_stream_t);
+
+    mume_stream_reference(stm);
+    result->stm = stm;
+    result->proc = proc;
+    result->data = data;
+    result->failed = 0;
+    result->base.impl = &_progress_stream_impl;
+    result->base.refcount = 0;
+    return (mume_stream_t*)result;
+}
+
+void mume_progress_stream_detach(mume_stream_t *stm)
+{
+    assert(stm->impl == &_progress_stream_impl);
+    ((_progress_stream_t*)stm)->proc = NULL;
+}
+
+const char* mume_file_stream_path(mume_stream_t *stm)
+{
+    while (stm->impl == &_progress_stream_impl)
+        stm = ((_progress_stream_t*)stm)->stm;
+
+    if (stm->impl == &_file_stream_impl)
+        return ((_file_stream_t*)stm)->path;
+
+#if HAVE_SYS_MMAN_H
+    if (stm->impl == &_mmap_stream_impl)
+        return ((_mmap_stream_t*)stm)->path;
+#endif
+
+    return NULL;
+}
+
 int mume_process_file_stream(
     int (*proc)(void*, mume_stream_t*), void *closure,
     const char *file, int mode)
@@ -37,6 +37,8 @@ struct mume_stream_i {
     size_t (*read)(void *self, void *data, size_t len);
     size_t (*write)(void *self, const void *data, size_t len);
     void (*close)(void *self);
+    /* Optional, NULL if the data isn't in memory. */
+    const void* (*peek)(void *self, size_t pos, size_t len);
 };
 
 struct mume_stream_s {
@@ -52,6 +54,33 @@ mume_public mume_stream_t* mume_memory_stream_open(
 mume_public mume_stream_t* mume_file_stream_open(
     const char *text, int mode);
 
+/* Open a local file for reading by mapping it into memory, its
+ * data can be peeked without copying. The stream is not a snapshot:
+ * it keeps the length when opened, but the pages not read yet show
+ * the file written later. If the file is truncated, the data cut
+ * off can't be peeked and reads of it return the file's data or
+ * nothing, since the pages mapped past the end of the file raise
+ * SIGBUS. A pointer peeked before the truncation still faults, so
+ * read a file that may be truncated with a file stream. Files that
+ * can't be mapped (pipes, devices, empty files, or systems without
+ * mmap) are opened as file streams. */
+mume_public mume_stream_t* mume_mmap_stream_open(const char *text);
+
+/* Open a stream reading <stm>, which reports how far it's read by
+ * calling <proc> with the end of the data read or peeked last and
+ * the length of the stream. Reading fails once <proc> returns 0.
+ * The new stream takes a reference of <stm>. */
+mume_public mume_stream_t* mume_progress_stream_open(
+    mume_stream_t *stm, int (*proc)(void*, size_t, size_t), void *data);
+
+/* Stop reporting the progress, <stm> reads as its source then. */
+mume_public void mume_progress_stream_detach(mume_stream_t *stm);
+
+/* Path of a local file stream or mapped file stream, or of the
+ * source of a progress stream, or NULL if <stm> is another kind
+ * of stream. */
+mume_public const char* mume_file_stream_path(mume_stream_t *stm);
+
 /* Open the file, and pass the stream to the specified proc. */
 mume_public int mume_process_file_stream(
     int (*proc)(void*, mume_stream_t*), void *closure,
@@ -89,6 +118,18 @@ static inline size_t mume_stream_write(
     return stm->impl->write(stm, data, len);
 }
 
+/* Get the pointer to <len> bytes at <pos> of the stream without
+ * copying, it's valid until the stream is closed. Return NULL if
+ * the range is out of the stream or the stream can't peek. */
+static inline const void* mume_stream_peek(
+    mume_stream_t *stm, size_t pos, size_t len)
+{
+    if (stm->impl->peek)
+        return stm->impl->peek(stm, pos, len);
+
+    return NULL;
+}
+
 static inline void mume_stream_close(mume_stream_t *stm)
 {
     if (stm) {
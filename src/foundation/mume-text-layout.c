@@ -874,3 +874,57 @@ int mume_text_layout_get_length(const void *_self)
     const struct _text_layout *self = _self;
     return mume_vector_size(self->texts);
 }
+
+int mume_text_layout_get_glyphs(
+    const void *_self, cairo_glyph_t *glyphs, int *clusters)
+{
+    const struct _text_layout *self = _self;
+    const struct _text_line *line;
+    const struct _text_run *run;
+    const struct _text_glyph *glyph;
+    cairo_font_extents_t font_extents;
+    double x, y, dy;
+    int i, count = 0;
+
+    font_extents = _text_blocks_max_font_extents(
+        self->blocks, self->font_size);
+
+    /* Glyphs are drawn on the "base line". */
+    dy = font_extents.height - font_extents.descent;
+    for (line = self->lines; line; line = line->next) {
+        x = y = 0;
+        for (run = line->begin; run != line->end; run = run->next) {
+            glyph = _text_run_get_glyph(run);
+            for (i = 0; i < run->num_glyphs; ++i, ++count) {
+                if (glyphs) {
+                    glyphs[count].index = glyph[i].codepoint;
+                    glyphs[count].x = x + glyph[i].x_offset;
+                    glyphs[count].y = y - glyph[i].y_offset + dy;
+                }
+
+                if (clusters) {
+                    clusters[count] = run->block->text +
+                                      run->text + glyph[i].cluster;
+                }
+
+                x += glyph[i].x_advance;
+                y -= glyph[i].y_advance;
+            }
+        }
+
+        dy += font_extents.height;
+    }
+
+    return count;
+}
+
+void mume_text_layout_show_glyphs(
+    cairo_t *cr, cairo_font_face_t *face, int font_size,
+    const cairo_glyph_t *glyphs, int count)
+{
+    cairo_scaled_font_t *scaled_font;
+    scaled_font = _create_cairo_scaled_font(face, font_size);
+    cairo_set_scaled_font(cr, scaled_font);
+    cairo_scaled_font_destroy(scaled_font);
+    cairo_show_glyphs(cr, glyphs, count);
+}
@@ -58,6 +58,17 @@ mume_public const mume_rect_t* mume_text_layout_get_rects(const void *self);
 
 mume_public int mume_text_layout_get_length(const void *self);
 
+/* Get the glyphs of the last performed layout, positioned relative
+ * to the top left of the text, and the text index of each glyph in
+ * <clusters>. Both can be NULL, return the number of glyphs. */
+mume_public int mume_text_layout_get_glyphs(
+    const void *self, cairo_glyph_t *glyphs, int *clusters);
+
+/* Draw the glyphs got from a layout of <face> at <font_size>. */
+mume_public void mume_text_layout_show_glyphs(
+    cairo_t *cr, cairo_font_face_t *face, int font_size,
+    const cairo_glyph_t *glyphs, int count);
+
 MUME_END_DECLS
 
 #endif /* MUME_FOUNDATION_TEXT_LAYOUT_H */
@@ -62,6 +62,23 @@ void mume_thread_delete(mume_thread_t *t)
     }
 }
 
+mume_thread_id_t* mume_thread_id_new(void)
+{
+    DWORD *id = malloc_struct(DWORD);
+    *id = GetCurrentThreadId();
+    return id;
+}
+
+void mume_thread_id_delete(mume_thread_id_t *id)
+{
+    free(id);
+}
+
+int mume_thread_is_self(const mume_thread_id_t *id)
+{
+    return *(const DWORD*)id == GetCurrentThreadId();
+}
+
 mume_mutex_t* mume_mutex_new(void)
 {
     CRITICAL_SECTION *cs = malloc_struct(CRITICAL_SECTION);
@@ -161,6 +178,23 @@ void mume_thread_join(mume_thread_t *t)
     pthread_join(*(pthread_t*)t, NULL);
 }
 
+mume_thread_id_t* mume_thread_id_new(void)
+{
+    pthread_t *id = malloc_struct(pthread_t);
+    *id = pthread_self();
+    return id;
+}
+
+void mume_thread_id_delete(mume_thread_id_t *id)
+{
+    free(id);
+}
+
+int mume_thread_is_self(const mume_thread_id_t *id)
+{
+    return pthread_equal(*(const pthread_t*)id, pthread_self());
+}
+
 mume_mutex_t* mume_mutex_new(void)
 {
     int err;
@@ -29,6 +29,15 @@ mume_public void mume_thread_delete(mume_thread_t *t);
 
 mume_public void mume_thread_join(mume_thread_t *t);
 
+/* Take the identity of the calling thread, it may be compared
+ * with mume_thread_is_self from any thread. */
+mume_public mume_thread_id_t* mume_thread_id_new(void);
+
+mume_public void mume_thread_id_delete(mume_thread_id_t *id);
+
+/* Return nonzero if <id> was taken on the calling thread. */
+mume_public int mume_thread_is_self(const mume_thread_id_t *id);
+
 mume_public mume_mutex_t* mume_mutex_new(void);
 
 mume_public void mume_mutex_delete(mume_mutex_t *mtx);
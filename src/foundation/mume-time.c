@@ -32,6 +32,19 @@ void mume_gettimeofday(mume_timeval_t *tv)
     tv->tv_usec = tmp.tv_usec;
 }
 
+void mume_monotonic_time(mume_timeval_t *tv)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
+    struct timespec tmp;
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &tmp)) {
+        tv->tv_sec = tmp.tv_sec;
+        tv->tv_usec = tmp.tv_nsec / 1000;
+        return;
+    }
+#endif
+    mume_gettimeofday(tv);
+}
+
 void mume_sleep(const mume_timeval_t *tv)
 {
     struct timespec req;
@@ -65,6 +78,21 @@ void mume_gettimeofday(mume_timeval_t *tv)
     mume_tv_normalize(tv);
 }
 
+void mume_monotonic_time(mume_timeval_t *tv)
+{
+    LARGE_INTEGER count, freq;
+    if (QueryPerformanceFrequency(&freq) &&
+        QueryPerformanceCounter(&count))
+    {
+        tv->tv_sec = (int)(count.QuadPart / freq.QuadPart);
+        tv->tv_usec = (int)((count.QuadPart % freq.QuadPart) *
+                            MUME_USECS_PER_SEC / freq.QuadPart);
+        return;
+    }
+
+    mume_gettimeofday(tv);
+}
+
 void mume_sleep(const mume_timeval_t *tv)
 {
     Sleep(tv->tv_sec * MUME_MSECS_PER_SEC +
@@ -33,6 +33,10 @@ struct mume_timeval_s {
 
 mume_public void mume_gettimeofday(mume_timeval_t *tv);
 
+/* Time elapsed since an unspecified start point, it isn't
+ * affected by changes of the system time. */
+mume_public void mume_monotonic_time(mume_timeval_t *tv);
+
 mume_public void mume_sleep(const mume_timeval_t *tv);
 
 mume_public void mume_sleep_msec(int msec);
@@ -17,17 +17,74 @@
  */
 #include "mume-timer.h"
 #include "mume-debug.h"
-#include "mume-heap.h"
 #include "mume-memory.h"
 #include "mume-vector.h"
 #include MUME_ASSERT_H
 
-static int _mume_timer_comp(const void *v1, const void *v2)
+#define _timer_at(_tms, _i) (((mume_timer_t**)(_tms))[_i])
+
+static void _timer_set(mume_timer_t **tms, int i, mume_timer_t *tmr)
+{
+    tms[i] = tmr;
+    tmr->index = i;
+}
+
+/* The heap keeps each timer's index up to date, so a timer can
+ * be found without scanning the queue. */
+static void _timer_sift_up(mume_timer_t **tms, int i)
+{
+    mume_timer_t *tmr = tms[i];
+    int parent;
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (mume_timeval_cmp(&tms[parent]->expire, &tmr->expire) <= 0)
+            break;
+
+        _timer_set(tms, i, tms[parent]);
+        i = parent;
+    }
+
+    _timer_set(tms, i, tmr);
+}
+
+static void _timer_sift_down(mume_timer_t **tms, int count, int i)
+{
+    mume_timer_t *tmr = tms[i];
+    int child;
+    while ((child = i + i + 1) < count) {
+        if (child + 1 < count &&
+            mume_timeval_cmp(&tms[child + 1]->expire,
+                             &tms[child]->expire) < 0)
+        {
+            ++child;
+        }
+
+        if (mume_timeval_cmp(&tmr->expire, &tms[child]->expire) <= 0)
+            break;
+
+        _timer_set(tms, i, tms[child]);
+        i = child;
+    }
+
+    _timer_set(tms, i, tmr);
+}
+
+static void _timer_update(mume_timerq_t *tmrq, mume_timer_t *tmr)
+{
+    mume_timer_t **tms = mume_vector_front(tmrq->timers);
+    int i = tmr->index;
+    _timer_sift_up(tms, i);
+    if (tmr->index == i) {
+        _timer_sift_down(
+            tms, (int)mume_vector_size(tmrq->timers), i);
+    }
+}
+
+static void _timer_expire_at(
+    mume_timer_t *tmr, const mume_timeval_t *now, int interval)
 {
-    /* make the timer heap a min heap based on delay */
-    return mume_timeval_cmp(
-        &((*(const mume_timer_t**)v2)->expire),
-        &((*(const mume_timer_t**)v1)->expire));
+    mume_timeval_t ti = mume_timeval_make(0, interval, 0);
+    tmr->expire = mume_timeval_add(now, &ti);
 }
 
 mume_timerq_t* mume_timerq_ctor(mume_timerq_t *tmrq)
@@ -40,6 +97,10 @@ mume_timerq_t* mume_timerq_ctor(mume_timerq_t *tmrq)
 
 mume_timerq_t* mume_timerq_dtor(mume_timerq_t *tmrq)
 {
+    size_t i;
+    for (i = 0; i < mume_vector_size(tmrq->timers); ++i)
+        _timer_at(mume_vector_front(tmrq->timers), i)->index = -1;
+
     mume_vector_delete(tmrq->timers);
     return tmrq;
 }
@@ -49,34 +110,36 @@ void mume_timerq_schedule(
 {
     mume_timeval_t now;
     assert(interval > 0);
-    *(mume_timer_t**)mume_vector_push_back(tmrq->timers) = tmr;
-    mume_gettimeofday(&now);
-    tmr->expire = mume_timeval_make(0, interval, 0);
-    tmr->expire = mume_timeval_add(&tmr->expire, &now);
-    mume_push_heap(mume_vector_front(tmrq->timers),
-                    mume_vector_size(tmrq->timers),
-                    sizeof(mume_timer_t*), _mume_timer_comp);
+    mume_monotonic_time(&now);
+    _timer_expire_at(tmr, &now, interval);
+    if (tmr->index < 0) {
+        *(mume_timer_t**)mume_vector_push_back(tmrq->timers) = tmr;
+        tmr->index = (int)mume_vector_size(tmrq->timers) - 1;
+    }
+
+    assert(_timer_at(mume_vector_front(tmrq->timers), tmr->index) == tmr);
+    _timer_update(tmrq, tmr);
 }
 
 void mume_timerq_cancel(
     mume_timerq_t *tmrq, mume_timer_t *tmr)
 {
-    size_t i, count;
     mume_timer_t **tms;
-    tms = (mume_timer_t**)mume_vector_front(tmrq->timers);
-    count = mume_vector_size(tmrq->timers);
-    for (i = 0; i < count; ++i) {
-        if (tms[i] != tmr)
-            continue;
-        if (i != count - 1) {
-            /* adjest heap */
-            tms[i] = tms[count - 1];
-            mume_reheap_down(
-                tms, count - 1, sizeof(mume_timer_t*),
-                _mume_timer_comp, i);
-        }
-        mume_vector_pop_back(tmrq->timers);
-        break;
+    mume_timer_t *last;
+    int i = tmr->index;
+
+    if (i < 0)
+        return;
+
+    tms = mume_vector_front(tmrq->timers);
+    assert(tms[i] == tmr);
+    last = tms[mume_vector_size(tmrq->timers) - 1];
+    mume_vector_pop_back(tmrq->timers);
+    tmr->index = -1;
+    if (last != tmr) {
+        /* Fill the hole with the last one. */
+        _timer_set(tms, i, last);
+        _timer_update(tmrq, last);
     }
 }
 
@@ -84,9 +147,10 @@ int mume_timerq_check(mume_timerq_t *tmrq, mume_timeval_t *wait)
 {
     mume_timeval_t tv;
     mume_timeval_t ti;
+    mume_timeval_t expire;
     mume_timer_t *tmr;
     int interval;
-    mume_gettimeofday(&tv);
+    mume_monotonic_time(&tv);
     while (mume_vector_size(tmrq->timers) > 0) {
         tmr = *(mume_timer_t**)mume_vector_front(tmrq->timers);
         ti = mume_timeval_sub(&tmr->expire, &tv);
@@ -99,26 +163,18 @@ int mume_timerq_check(mume_timerq_t *tmrq, mume_timeval_t *wait)
             break;
         }
 
+        expire = tmr->expire;
         interval = tmr->tmrproc(tmr);
-        /* timer may be canceled in tmrproc */
-        if (0 == mume_vector_size(tmrq->timers) ||
-            tmr != *(mume_timer_t**)(
-                mume_vector_front(tmrq->timers)))
+        /* timer may be canceled or rescheduled in tmrproc */
+        if (tmr->index < 0 ||
+            mume_timeval_cmp(&tmr->expire, &expire) != 0)
         {
             continue;
         }
 
         if (interval > 0) {
-            ti = mume_timeval_make(0, interval, 0);
-            tmr->expire = mume_timeval_add(&tv, &ti);
-            mume_pop_heap(
-                mume_vector_front(tmrq->timers),
-                mume_vector_size(tmrq->timers),
-                sizeof(mume_timer_t*), _mume_timer_comp);
-            mume_push_heap(
-                mume_vector_front(tmrq->timers),
-                mume_vector_size(tmrq->timers),
-                sizeof(mume_timer_t*), _mume_timer_comp);
+            _timer_expire_at(tmr, &tv, interval);
+            _timer_update(tmrq, tmr);
         }
         else {
             mume_timerq_cancel(tmrq, tmr);
@@ -27,6 +27,8 @@ struct mume_timer_s {
     mume_timeval_t expire;
     int (*tmrproc)(mume_timer_t *tmr);
     void *data;
+    /* Position in the queue's heap, -1 if not scheduled. */
+    int index;
 };
 
 struct mume_timerq_s {
@@ -38,6 +40,7 @@ static inline mume_timer_t* mume_timer_ctor(
 {
     tmr->tmrproc = tmrproc;
     tmr->data = data;
+    tmr->index = -1;
     return tmr;
 }
 
@@ -57,10 +60,14 @@ static inline mume_timer_t* mume_timer_dtor(
 
 #define mume_timer_data(_tmr) ((void*)(_tmr)->data)
 
+#define mume_timer_scheduled(_tmr) ((_tmr)->index >= 0)
+
 mume_public mume_timerq_t* mume_timerq_ctor(
     mume_timerq_t *tmrq);
 mume_public mume_timerq_t* mume_timerq_dtor(
     mume_timerq_t *tmrq);
+/* Schedule <tmr> to expire after <interval> milliseconds on the
+   monotonic clock, a scheduled timer is rescheduled. */
 mume_public void mume_timerq_schedule(
     mume_timerq_t *tmrq, mume_timer_t *tmr, int interval);
 mume_public void mume_timerq_cancel(
@@ -16,6 +16,716 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mume-virtfs-zip.h"
+#include "mume-config.h"
+#include "mume-debug.h"
+#include "mume-memory.h"
+#include "mume-stream.h"
+#include "mume-thread.h"
+#include MUME_ASSERT_H
+#include MUME_LIMITS_H
+#include MUME_STDLIB_H
+#include MUME_STRING_H
+#include MUME_ZLIB_H
+
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#define _ZIP_EOCD_SIGNATURE 0x06054b50
+#define _ZIP_CDIR_SIGNATURE 0x02014b50
+#define _ZIP_LOCAL_SIGNATURE 0x04034b50
+
+#define _ZIP_EOCD_SIZE 22
+#define _ZIP_CDIR_SIZE 46
+#define _ZIP_LOCAL_SIZE 30
+#define _ZIP_MAX_COMMENT 0xffff
+
+#define _ZIP_METHOD_STORED 0
+#define _ZIP_METHOD_DEFLATED 8
+#define _ZIP_FLAG_ENCRYPTED 0x0001
+
+/* Deflated entries are inflated in blocks of this size, and each
+ * stream caches the most recent blocks. */
+#define _ZIP_BLOCK_SIZE (64 * 1024)
+#define _ZIP_CACHE_BLOCKS 4
+
+/* The inflate state is copied every this many blocks, a backward
+ * seek past the cache inflates from the nearest copy before the
+ * block instead of the start. Each copy takes about 40K. */
+#define _ZIP_CHECKPOINT_BLOCKS 16
+
+/* Compressed data is read in chunks of this size if the archive
+ * isn't mapped. */
+#define _ZIP_INPUT_SIZE (16 * 1024)
+
+struct _zip_entry {
+    const char *name;
+    int method;
+    size_t csize;
+    size_t usize;
+    size_t header;                /* Offset of the local header. */
+};
+
+struct mume_zipfs_s {
+    mume_stream_t *archive;
+    mume_mutex_t *mutex;          /* Guards reading the archive,
+                                     and the reference count. */
+    struct _zip_entry *entries;   /* Sorted by name. */
+    size_t count;
+    char *names;
+    int refcount;
+};
+
+struct _zip_block {
+    size_t index;
+    size_t length;
+    unsigned int stamp;
+    char *data;
+};
+
+#if HAVE_ZLIB_H
+/* Checkpoints are allocated one by one, zlib keeps the address
+ * of the stream in its state. */
+struct _zip_checkpoint {
+    z_stream z;                   /* Before the block inflated. */
+    size_t consumed;              /* Compressed bytes used. */
+};
+#endif
+
+typedef struct _zip_stream_s {
+    mume_stream_t base;
+    mume_zipfs_t *zfs;
+    const struct _zip_entry *entry;
+    size_t offset;                /* Offset of the data. */
+    size_t cur;
+#if HAVE_ZLIB_H
+    z_stream z;
+    size_t consumed;              /* Compressed bytes fed. */
+    size_t next;                  /* Next block to inflate. */
+    unsigned int clock;
+    struct _zip_block blocks[_ZIP_CACHE_BLOCKS];
+    unsigned char *input;
+    struct _zip_checkpoint **checkpoints;
+    size_t checkpoint_count;      /* Of every _ZIP_CHECKPOINT_BLOCKS
+                                     blocks from the first ones. */
+#endif
+} _zip_stream_t;
+
+static inline unsigned int _zip_u16(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline unsigned long _zip_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16) |
+            ((unsigned long)p[3] << 24);
+}
+
+static size_t _zipfs_read(
+    mume_zipfs_t *zfs, size_t pos, void *data, size_t len)
+{
+    const void *mapped = mume_stream_peek(zfs->archive, pos, len);
+
+    if (mapped) {
+        memcpy(data, mapped, len);
+        return len;
+    }
+
+    mume_mutex_lock(zfs->mutex);
+
+    if (mume_stream_seek(zfs->archive, pos))
+        len = mume_stream_read(zfs->archive, data, len);
+    else
+        len = 0;
+
+    mume_mutex_unlock(zfs->mutex);
+
+    return len;
+}
+
+/* Get <len> bytes at <pos> in place, or read into a new <buffer>
+ * which must be freed by the caller. */
+static const unsigned char* _zipfs_load(
+    mume_zipfs_t *zfs, size_t pos, size_t len, unsigned char **buffer)
+{
+    const void *mapped = mume_stream_peek(zfs->archive, pos, len);
+
+    *buffer = NULL;
+    if (mapped)
+        return mapped;
+
+    *buffer = malloc_abort(MAX(len, 1));
+    if (_zipfs_read(zfs, pos, *buffer, len) != len) {
+        free(*buffer);
+        *buffer = NULL;
+        return NULL;
+    }
+
+    return *buffer;
+}
+
+static int _zip_entry_compare(const void *a, const void *b)
+{
+    return strcmp(((const struct _zip_entry*)a)->name,
+                  ((const struct _zip_entry*)b)->name);
+}
+
+static int _zipfs_read_directory(
+    mume_zipfs_t *zfs, const unsigned char *p, size_t size, size_t count)
+{
+    const unsigned char *end = p + size;
+    size_t i, name_len, names_len = 0;
+    char *name;
+
+    /* Names are copied into one pool, sized by a first pass. */
+    for (i = 0; i < count; ++i) {
+        if (end - p < _ZIP_CDIR_SIZE ||
+            _zip_u32(p) != _ZIP_CDIR_SIGNATURE)
+        {
+            return 0;
+        }
+
+        name_len = _zip_u16(p + 28);
+        names_len += name_len + 1;
+        p += _ZIP_CDIR_SIZE + name_len +
+             _zip_u16(p + 30) + _zip_u16(p + 32);
+
+        if (p > end)
+            return 0;
+    }
+
+    p = end - size;
+    zfs->entries = calloc_struct(MAX(count, 1), struct _zip_entry);
+    zfs->names = name = malloc_abort(MAX(names_len, 1));
+    zfs->count = count;
+
+    for (i = 0; i < count; ++i) {
+        struct _zip_entry *e = zfs->entries + i;
+        name_len = _zip_u16(p + 28);
+        memcpy(name, p + _ZIP_CDIR_SIZE, name_len);
+        name[name_len] = '\0';
+
+        e->name = name;
+        e->method = _zip_u16(p + 10);
+        e->csize = _zip_u32(p + 20);
+        e->usize = _zip_u32(p + 24);
+        e->header = _zip_u32(p + 42);
+
+        /* Encrypted entries aren't supported. */
+        if (_zip_u16(p + 8) & _ZIP_FLAG_ENCRYPTED)
+            e->method = -1;
+
+        name += name_len + 1;
+        p += _ZIP_CDIR_SIZE + name_len +
+             _zip_u16(p + 30) + _zip_u16(p + 32);
+    }
+
+    qsort(zfs->entries, count, sizeof(struct _zip_entry),
+          _zip_entry_compare);
+
+    return 1;
+}
+
+static int _zipfs_read_archive(mume_zipfs_t *zfs)
+{
+    const unsigned char *tail, *eocd, *cdir;
+    unsigned char *tail_buffer, *cdir_buffer;
+    size_t length, tail_size, count, size, offset;
+    int result = 0;
+
+    length = mume_stream_length(zfs->archive);
+    if (length < _ZIP_EOCD_SIZE)
+        return 0;
+
+    /* The end of central directory record is followed by a
+     * comment of at most 64K. */
+    tail_size = MIN(length, _ZIP_EOCD_SIZE + _ZIP_MAX_COMMENT);
+    tail = _zipfs_load(
+        zfs, length - tail_size, tail_size, &tail_buffer);
+
+    if (NULL == tail)
+        return 0;
+
+    eocd = tail + tail_size - _ZIP_EOCD_SIZE;
+    while (eocd >= tail && _zip_u32(eocd) != _ZIP_EOCD_SIGNATURE)
+        --eocd;
+
+    if (eocd < tail)
+        goto out;
+
+    count = _zip_u16(eocd + 10);
+    size = _zip_u32(eocd + 12);
+    offset = _zip_u32(eocd + 16);
+
+    /* Multiple disks and zip64 archives. */
+    if (_zip_u16(eocd + 4) || _zip_u16(eocd + 6) ||
+        count != _zip_u16(eocd + 8) || 0xffff == count ||
+        0xffffffff == size || 0xffffffff == offset ||
+        offset > length || length - offset < size)
+    {
+        goto out;
+    }
+
+    cdir = _zipfs_load(zfs, offset, size, &cdir_buffer);
+    if (cdir) {
+        result = _zipfs_read_directory(zfs, cdir, size, count);
+        free(cdir_buffer);
+    }
+
+out:
+    free(tail_buffer);
+    return result;
+}
+
+static const struct _zip_entry* _zipfs_find(
+    mume_zipfs_t *zfs, const char *name)
+{
+    struct _zip_entry key;
+    key.name = name;
+    return bsearch(&key, zfs->entries, zfs->count,
+                   sizeof(struct _zip_entry), _zip_entry_compare);
+}
+
+mume_zipfs_t* mume_zipfs_create(const char *path)
+{
+    mume_zipfs_t *zfs;
+    mume_stream_t *archive;
+
+#if HAVE_SYS_STAT_H
+    struct stat st;
+    if (stat(path, &st) || !S_ISREG(st.st_mode))
+        return NULL;
+#endif
+
+    archive = mume_mmap_stream_open(path);
+    if (NULL == archive)
+        return NULL;
+
+    zfs = calloc_struct(1, mume_zipfs_t);
+    zfs->archive = archive;
+    zfs->mutex = mume_mutex_new();
+    zfs->refcount = 1;
+
+    if (!_zipfs_read_archive(zfs)) {
+        mume_zipfs_destroy(zfs);
+        return NULL;
+    }
+
+    return zfs;
+}
+
+void mume_zipfs_destroy(mume_zipfs_t *zfs)
+{
+    int refcount;
+
+    /* Streams of other threads may release theirs. */
+    mume_mutex_lock(zfs->mutex);
+    refcount = --zfs->refcount;
+    mume_mutex_unlock(zfs->mutex);
+
+    if (0 == refcount) {
+        mume_stream_close(zfs->archive);
+        mume_mutex_delete(zfs->mutex);
+        free(zfs->entries);
+        free(zfs->names);
+        free(zfs);
+    }
+}
+
+mume_zipfs_t* mume_zipfs_reference(mume_zipfs_t *zfs)
+{
+    mume_mutex_lock(zfs->mutex);
+    ++zfs->refcount;
+    mume_mutex_unlock(zfs->mutex);
+    return zfs;
+}
+
+/* Compare <s> with the first <len> characters of <name> followed
+ * by a '/'. */
+static int _zip_prefix_compare(const char *s, const char *name, size_t len)
+{
+    int result = strncmp(s, name, len);
+
+    if (result)
+        return result;
+
+    return (unsigned char)s[len] - '/';
+}
+
+int mume_zipfs_exists(mume_zipfs_t *zfs, const char *name)
+{
+    size_t len = strlen(name);
+    size_t low = 0, high = zfs->count, mid;
+
+    if (_zipfs_find(zfs, name))
+        return 1;
+
+    /* A directory exists if any entry is under it, and the entry
+     * of the directory itself is optional. The first entry not
+     * before "<name>/" is searched, since names such as "<name>-a"
+     * sort between <name> and "<name>/". */
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (_zip_prefix_compare(zfs->entries[mid].name, name, len) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low < zfs->count &&
+            0 == strncmp(zfs->entries[low].name, name, len) &&
+            '/' == zfs->entries[low].name[len];
+}
+
+static size_t _zip_stream_length(void *self)
+{
+    return ((_zip_stream_t*)self)->entry->usize;
+}
+
+static int _zip_stream_eof(void *self)
+{
+    _zip_stream_t *stm = self;
+    return stm->cur >= stm->entry->usize;
+}
+
+static size_t _zip_stream_tell(void *self)
+{
+    return ((_zip_stream_t*)self)->cur;
+}
+
+static int _zip_stream_seek(void *self, size_t pos)
+{
+    _zip_stream_t *stm = self;
+
+    if (pos > stm->entry->usize)
+        return 0;
+
+    stm->cur = pos;
+    return 1;
+}
+
+static size_t _zip_stream_write(
+    void *self, const void *data, size_t len)
+{
+    return 0;
+}
+
+static size_t _stored_stream_read(
+    void *self, void *data, size_t len)
+{
+    _zip_stream_t *stm = self;
+
+    len = MIN(len, stm->entry->usize - stm->cur);
+    len = _zipfs_read(stm->zfs, stm->offset + stm->cur, data, len);
+    stm->cur += len;
+    return len;
+}
+
+static const void* _stored_stream_peek(
+    void *self, size_t pos, size_t len)
+{
+    _zip_stream_t *stm = self;
+
+    if (pos > stm->entry->usize || stm->entry->usize - pos < len)
+        return NULL;
+
+    return mume_stream_peek(stm->zfs->archive, stm->offset + pos, len);
+}
+
+static void _zip_stream_close(void *self)
+{
+    _zip_stream_t *stm = self;
+
+#if HAVE_ZLIB_H
+    if (_ZIP_METHOD_DEFLATED == stm->entry->method) {
+        size_t i;
+
+        inflateEnd(&stm->z);
+        for (i = 0; i < _ZIP_CACHE_BLOCKS; ++i)
+            free(stm->blocks[i].data);
+
+        for (i = 0; i < stm->checkpoint_count; ++i) {
+            inflateEnd(&stm->checkpoints[i]->z);
+            free(stm->checkpoints[i]);
+        }
+
+        free(stm->checkpoints);
+        free(stm->input);
+    }
+#endif
+
+    mume_zipfs_destroy(stm->zfs);
+    free(stm);
+}
+
+#if HAVE_ZLIB_H
+
+static int _deflated_stream_fill(_zip_stream_t *stm)
+{
+    size_t len = stm->entry->csize - stm->consumed;
+    const void *mapped;
+
+    if (0 == len)
+        return 0;
+
+    /* Feed all the data at once if the archive is mapped. */
+    len = MIN(len, UINT_MAX);
+    mapped = mume_stream_peek(
+        stm->zfs->archive, stm->offset + stm->consumed, len);
+
+    if (NULL == mapped) {
+        if (NULL == stm->input)
+            stm->input = malloc_abort(_ZIP_INPUT_SIZE);
+
+        len = MIN(len, _ZIP_INPUT_SIZE);
+        len = _zipfs_read(
+            stm->zfs, stm->offset + stm->consumed, stm->input, len);
+
+        mapped = stm->input;
+    }
+
+    stm->z.next_in = (Bytef*)mapped;
+    stm->z.avail_in = len;
+    stm->consumed += len;
+    return len > 0;
+}
+
+static void _deflated_stream_checkpoint(_zip_stream_t *stm)
+{
+    /* Copy the state before the block to inflate if it's the first
+     * one of a checkpoint not copied yet. The input buffered is
+     * read again from where it's used. */
+    struct _zip_checkpoint *cp;
+    size_t n = stm->next / _ZIP_CHECKPOINT_BLOCKS;
+
+    if (stm->next % _ZIP_CHECKPOINT_BLOCKS ||
+        n != stm->checkpoint_count + 1)
+    {
+        return;
+    }
+
+    cp = malloc_struct(struct _zip_checkpoint);
+    if (inflateCopy(&cp->z, &stm->z) != Z_OK) {
+        free(cp);
+        return;
+    }
+
+    cp->consumed = stm->consumed - stm->z.avail_in;
+    stm->checkpoints = realloc_abort(
+        stm->checkpoints, sizeof(struct _zip_checkpoint*) * n);
+
+    stm->checkpoints[stm->checkpoint_count++] = cp;
+}
+
+static int _deflated_stream_restore(_zip_stream_t *stm, size_t index)
+{
+    /* Go back to the nearest checkpoint before block <index>, or
+     * the start of the entry. */
+    struct _zip_checkpoint *cp;
+    size_t n = MIN(index / _ZIP_CHECKPOINT_BLOCKS, stm->checkpoint_count);
+
+    if (n > 0) {
+        cp = stm->checkpoints[n - 1];
+        inflateEnd(&stm->z);
+        if (Z_OK == inflateCopy(&stm->z, &cp->z)) {
+            stm->z.avail_in = 0;
+            stm->consumed = cp->consumed;
+            stm->next = n * _ZIP_CHECKPOINT_BLOCKS;
+            return 1;
+        }
+
+        /* Out of memory, inflate from the start. A stream failed
+         * to initialize can be ended again. */
+        if (inflateInit2(&stm->z, -MAX_WBITS) != Z_OK)
+            return 0;
+    }
+
+    inflateReset(&stm->z);
+    stm->z.avail_in = 0;
+    stm->consumed = 0;
+    stm->next = 0;
+    return 1;
+}
+
+static int _deflated_stream_inflate(
+    _zip_stream_t *stm, struct _zip_block *block)
+{
+    size_t begin = stm->next * _ZIP_BLOCK_SIZE;
+    int ret;
+
+    _deflated_stream_checkpoint(stm);
+
+    block->length = MIN(stm->entry->usize - begin, _ZIP_BLOCK_SIZE);
+    stm->z.next_out = (Bytef*)block->data;
+    stm->z.avail_out = block->length;
+
+    while (stm->z.avail_out) {
+        if (0 == stm->z.avail_in && !_deflated_stream_fill(stm))
+            return 0;
+
+        /* The end must come with the last block. */
+        ret = inflate(&stm->z, Z_NO_FLUSH);
+        if (ret != Z_OK && (ret != Z_STREAM_END || stm->z.avail_out)) {
+            mume_warning(("Inflate zip entry \"%s\" failed: %d\n",
+                          stm->entry->name, ret));
+            return 0;
+        }
+    }
+
+    block->index = stm->next++;
+    return 1;
+}
+
+static const struct _zip_block* _deflated_stream_block(
+    _zip_stream_t *stm, size_t index)
+{
+    struct _zip_block *block = NULL;
+    int i;
+
+    for (i = 0; i < _ZIP_CACHE_BLOCKS; ++i) {
+        if (stm->blocks[i].data && stm->blocks[i].index == index) {
+            block = stm->blocks + i;
+            block->stamp = ++stm->clock;
+            return block;
+        }
+    }
+
+    /* Seeking backward past the cache inflates from a checkpoint. */
+    if (index < stm->next && !_deflated_stream_restore(stm, index))
+        return NULL;
+
+    while (stm->next <= index) {
+        block = stm->blocks;
+        for (i = 1; i < _ZIP_CACHE_BLOCKS; ++i) {
+            if (stm->blocks[i].stamp < block->stamp)
+                block = stm->blocks + i;
+        }
+
+        if (NULL == block->data)
+            block->data = malloc_abort(_ZIP_BLOCK_SIZE);
+
+        block->stamp = ++stm->clock;
+        if (!_deflated_stream_inflate(stm, block)) {
+            free(block->data);
+            block->data = NULL;
+            block->stamp = 0;
+            return NULL;
+        }
+    }
+
+    return block;
+}
+
+static size_t _deflated_stream_read(
+    void *self, void *data, size_t len)
+{
+    _zip_stream_t *stm = self;
+    const struct _zip_block *block;
+    size_t offset, count, read = 0;
+
+    len = MIN(len, stm->entry->usize - stm->cur);
+    while (read < len) {
+        block = _deflated_stream_block(stm, stm->cur / _ZIP_BLOCK_SIZE);
+        if (NULL == block)
+            break;
+
+        offset = stm->cur % _ZIP_BLOCK_SIZE;
+        count = MIN(block->length - offset, len - read);
+        memcpy((char*)data + read, block->data + offset, count);
+        stm->cur += count;
+        read += count;
+    }
+
+    return read;
+}
+
+#endif /* HAVE_ZLIB_H */
+
+mume_stream_t* mume_zipfs_open(mume_zipfs_t *zfs, const char *name)
+{
+    static struct mume_stream_i _stored_impl = {
+        _zip_stream_length,
+        _zip_stream_eof,
+        _zip_stream_tell,
+        _zip_stream_seek,
+        _stored_stream_read,
+        _zip_stream_write,
+        _zip_stream_close,
+        _stored_stream_peek,
+    };
+#if HAVE_ZLIB_H
+    static struct mume_stream_i _deflated_impl = {
+        _zip_stream_length,
+        _zip_stream_eof,
+        _zip_stream_tell,
+        _zip_stream_seek,
+        _deflated_stream_read,
+        _zip_stream_write,
+        _zip_stream_close,
+    };
+#endif
+    const struct _zip_entry *entry = _zipfs_find(zfs, name);
+    unsigned char header[_ZIP_LOCAL_SIZE];
+    _zip_stream_t *stm;
+    size_t offset;
+
+    if (NULL == entry)
+        return NULL;
+
+#if HAVE_ZLIB_H
+    if (entry->method != _ZIP_METHOD_STORED &&
+        entry->method != _ZIP_METHOD_DEFLATED)
+    {
+        return NULL;
+    }
+#else
+    if (entry->method != _ZIP_METHOD_STORED)
+        return NULL;
+#endif
+
+    /* The extra field of the local header may differ from the
+     * central directory's. */
+    if (_zipfs_read(zfs, entry->header, header, _ZIP_LOCAL_SIZE) !=
+        _ZIP_LOCAL_SIZE || _zip_u32(header) != _ZIP_LOCAL_SIGNATURE)
+    {
+        mume_warning(("Bad zip entry: \"%s\"\n", name));
+        return NULL;
+    }
+
+    offset = entry->header + _ZIP_LOCAL_SIZE +
+             _zip_u16(header + 26) + _zip_u16(header + 28);
+
+    if (offset > mume_stream_length(zfs->archive) ||
+        mume_stream_length(zfs->archive) - offset < entry->csize ||
+        (_ZIP_METHOD_STORED == entry->method &&
+         entry->csize != entry->usize))
+    {
+        mume_warning(("Bad zip entry: \"%s\"\n", name));
+        return NULL;
+    }
+
+    stm = calloc_struct(1, _zip_stream_t);
+    stm->entry = entry;
+    stm->offset = offset;
+    stm->base.impl = &_stored_impl;
+
+#if HAVE_ZLIB_H
+    if (_ZIP_METHOD_DEFLATED == entry->method) {
+        /* Raw deflate data, without zlib header. */
+        if (inflateInit2(&stm->z, -MAX_WBITS) != Z_OK) {
+            free(stm);
+            return NULL;
+        }
+
+        stm->base.impl = &_deflated_impl;
+    }
+#endif
+
+    stm->zfs = mume_zipfs_reference(zfs);
+    stm->base.refcount = 0;
+    return (mume_stream_t*)stm;
+}
 
 const mume_class_t* mume_virtfs_zip_class(void)
 {
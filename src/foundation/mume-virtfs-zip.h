@@ -26,6 +26,29 @@ mume_public const mume_class_t* mume_virtfs_zip_class(void);
 
 mume_public mume_object_t mume_virtfs_zip_new(const char *path);
 
+/* Open the zip archive <path> for reading, its central directory
+ * is read once here. Return NULL if it isn't a zip archive or the
+ * archive isn't supported (zip64, multiple disks). */
+mume_public mume_zipfs_t* mume_zipfs_create(const char *path);
+
+/* Release a reference, the streams opened hold theirs. References
+ * can be taken and released from any thread. */
+mume_public void mume_zipfs_destroy(mume_zipfs_t *zfs);
+
+mume_public mume_zipfs_t* mume_zipfs_reference(mume_zipfs_t *zfs);
+
+/* Test if a file or directory <name> exists in the archive. */
+mume_public int mume_zipfs_exists(mume_zipfs_t *zfs, const char *name);
+
+/* Open the entry <name> as a read only stream. Stored entries are
+ * read from the archive in place, and can be peeked if the archive
+ * is mapped. Deflated entries are inflated on demand, the recent
+ * blocks inflated are cached by the stream, and the inflate state
+ * is kept every 1M for seeking backward. Return NULL if the
+ * entry doesn't exist or its compression isn't supported. */
+mume_public mume_stream_t* mume_zipfs_open(
+    mume_zipfs_t *zfs, const char *name);
+
 MUME_END_DECLS
 
 #endif /* !MUME_FOUNDATION_VIRTFS_ZIP_H */
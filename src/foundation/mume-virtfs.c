@@ -16,6 +16,7 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mume-virtfs.h"
+#include "mume-virtfs-zip.h"
 #include "mume-config.h"
 #include "mume-debug.h"
 #include "mume-memory.h"
@@ -27,11 +28,16 @@
 #include MUME_STDLIB_H
 #include MUME_PHYSFS_H
 
+#if HAVE_SYS_MMAN_H
+#include <sys/stat.h>
+#endif
+
 #define _MOUNT_DIR_LEN 16
 #define _MAX_PATH_LEN 256
 
 struct mume_virtfs_s {
     const char *mount;
+    mume_zipfs_t *zip;            /* Zip archive read directly. */
     int refcount;
 };
 
@@ -92,6 +98,8 @@ static int _change_writedir(mume_virtfs_t *vfs)
     const char *path = EXTRA_OF(mume_virtfs_t, vfs);
     if (_writefs == vfs)
         return 1;
+    if (vfs->zip)
+        return 0;
     if (PHYSFS_setWriteDir(path)) {
         _writefs = vfs;
         return 1;
@@ -246,6 +254,60 @@ static void _virtfs_stream_close(void *self)
     free(stm);
 }
 
+#if HAVE_SYS_MMAN_H
+
+/* Return nonzero if physfs takes <name>: it's relative, without
+ * "." or ".." components, and without ':' or '\\'. */
+static int _virtfs_is_safe_name(const char *name)
+{
+    size_t len;
+
+    if ('/' == name[0] || strpbrk(name, ":\\"))
+        return 0;
+
+    while (*name) {
+        len = strcspn(name, "/");
+        if ((1 == len && '.' == name[0]) ||
+            (2 == len && '.' == name[0] && '.' == name[1]))
+        {
+            return 0;
+        }
+
+        name += len;
+        if ('/' == *name)
+            ++name;
+    }
+
+    return 1;
+}
+
+/* Map the native file if the file system is a directory and <name>
+ * is a regular file in it, return NULL to fall back to physfs. */
+static mume_stream_t* _virtfs_open_mapped(
+    mume_virtfs_t *vfs, const char *name)
+{
+    char path[_MAX_PATH_LEN];
+    struct stat st;
+
+    /* physfs refuses these, don't bypass it. */
+    if (!_virtfs_is_safe_name(name))
+        return NULL;
+
+    if (snprintf(path, _MAX_PATH_LEN, "%s%c%s",
+                 (const char*)EXTRA_OF(mume_virtfs_t, vfs),
+                 mume_virtfs_dirsep(), name) >= _MAX_PATH_LEN)
+    {
+        return NULL;
+    }
+
+    if (lstat(path, &st) || !S_ISREG(st.st_mode))
+        return NULL;
+
+    return mume_mmap_stream_open(path);
+}
+
+#endif /* HAVE_SYS_MMAN_H */
+
 const char* mume_virtfs_basedir(void)
 {
     if (!_dirsgot)
@@ -312,6 +374,10 @@ mume_virtfs_t* mume_virtfs_create(const char *path)
         _physfs_reference(0);
         return NULL;
     }
+
+    /* Zip archives are read without physfs, which still serves
+     * the entries that can't be read directly. */
+    vfs->zip = mume_zipfs_create(absdir);
     return vfs;
 }
 
@@ -321,6 +387,8 @@ void mume_virtfs_destroy(mume_virtfs_t *vfs)
         if (_writefs == vfs) {
             _writefs = NULL;
         }
+        if (vfs->zip)
+            mume_zipfs_destroy(vfs->zip);
         free(vfs);
         _physfs_reference(0);
     }
@@ -335,6 +403,8 @@ mume_virtfs_t* mume_virtfs_reference(mume_virtfs_t *vfs)
 int mume_virtfs_exists(mume_virtfs_t *vfs, const char *name)
 {
     char mount[_MAX_PATH_LEN];
+    if (vfs->zip && mume_zipfs_exists(vfs->zip, name))
+        return 1;
     snprintf(mount, _MAX_PATH_LEN,
              "%s%s", vfs->mount, name);
     return PHYSFS_exists(mount);
@@ -359,7 +429,21 @@ mume_stream_t* mume_virtfs_open(
         _virtfs_stream_write,
         _virtfs_stream_close,
     };
-    _virtfs_stream_t *stm = malloc_struct(_virtfs_stream_t);
+    _virtfs_stream_t *stm;
+
+    if (MUME_OM_READ == mode) {
+        mume_stream_t *direct = NULL;
+        if (vfs->zip)
+            direct = mume_zipfs_open(vfs->zip, name);
+#if HAVE_SYS_MMAN_H
+        else
+            direct = _virtfs_open_mapped(vfs, name);
+#endif
+        if (direct)
+            return direct;
+    }
+
+    stm = malloc_struct(_virtfs_stream_t);
     switch (mode) {
     case MUME_OM_READ:
         {
@@ -1907,6 +1907,92 @@ void mume_validate_rect(
     }
 }
 
+static int _window_copy_region(
+    void *bwin, int x, int y, const cairo_region_t *rgn, int dx, int dy)
+{
+    mume_rect_t rect;
+    int i, n, begin, end, count;
+
+    /* The rectangles of a region are sorted in y-x bands, copy
+     * the bands and the rectangles in each band in the direction
+     * opposite to the moving, so the sources are not overwritten
+     * by the previous copies. */
+    n = cairo_region_num_rectangles(rgn);
+    begin = 0;
+    while (begin < n) {
+        cairo_region_get_rectangle(
+            rgn, dy > 0 ? n - 1 - begin : begin, &rect);
+
+        end = begin + 1;
+        while (end < n) {
+            mume_rect_t next;
+            cairo_region_get_rectangle(
+                rgn, dy > 0 ? n - 1 - end : end, &next);
+
+            if (next.y != rect.y)
+                break;
+
+            ++end;
+        }
+
+        count = end - begin;
+        for (i = 0; i < count; ++i) {
+            int j = (dy > 0) == (dx > 0) ? begin + i : end - 1 - i;
+
+            cairo_region_get_rectangle(
+                rgn, dy > 0 ? n - 1 - j : j, &rect);
+
+            if (!mume_backwin_scroll_area(
+                    bwin, x + rect.x - dx, y + rect.y - dy,
+                    rect.width, rect.height, dx, dy))
+            {
+                return 0;
+            }
+        }
+
+        begin = end;
+    }
+
+    return 1;
+}
+
+void mume_scroll_rect(
+    void *self, const mume_rect_t *rect, int dx, int dy)
+{
+    cairo_region_t *vis, *dst;
+    const cairo_region_t *urgn;
+    void *bwin;
+    int x, y;
+
+    if (!mume_window_is_mapped(self) ||
+        !mume_is_ancestors_mapped(self))
+    {
+        return;
+    }
+
+    vis = mume_window_region_create(self);
+    mume_window_region_clip_children(self, vis);
+    if (rect)
+        cairo_region_intersect_rectangle(vis, rect);
+
+    /* Only the visible and valid pixels can be copied. */
+    dst = cairo_region_copy(vis);
+    urgn = mume_window_get_urgn(self);
+    if (urgn)
+        cairo_region_subtract(dst, urgn);
+
+    cairo_region_translate(dst, dx, dy);
+    cairo_region_intersect(dst, vis);
+
+    bwin = mume_window_seek_backwin(self, &x, &y);
+    if ((dx || dy) && _window_copy_region(bwin, x, y, dst, dx, dy))
+        cairo_region_subtract(vis, dst);
+
+    mume_invalidate_region(self, vis);
+    cairo_region_destroy(dst);
+    cairo_region_destroy(vis);
+}
+
 mume_rect_t mume_current_invalid_rect(void)
 {
     mume_rect_t rect = mume_rect_empty;
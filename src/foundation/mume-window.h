@@ -285,6 +285,15 @@ mume_public void mume_invalidate_rect(
 mume_public void mume_validate_rect(
     void *self, const mume_rect_t *rect);
 
+/* Move the pixels of the <rect> area of a window by (dx, dy)
+ * in place, and invalidate the parts that can not be copied.
+ * If <rect> is NULL, the entire area of the window is moved.
+ * The whole area is invalidated if the backwin doesn't
+ * support scrolling.
+ */
+mume_public void mume_scroll_rect(
+    void *self, const mume_rect_t *rect, int dx, int dy);
+
 /* Get the invalid region extents of the last window that
  * receive the expose event. */
 mume_public mume_rect_t mume_current_invalid_rect(void);
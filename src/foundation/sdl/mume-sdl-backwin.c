@@ -24,6 +24,7 @@
 #include "mume-sdl-backend.h"
 #include "mume-sdl-cursor.h"
 #include MUME_ASSERT_H
+#include MUME_STRING_H
 
 #define _sdl_backwin_super_class mume_backwin_class
 #define _sdl_backwin_super_meta_class mume_backwin_meta_class
@@ -139,6 +140,50 @@ static void _sdl_backwin_end_paint(
     SDL_Flip(self->surface);
 }
 
+static int _sdl_backwin_scroll_area(
+    struct _sdl_backwin *self, int x, int y,
+    int w, int h, int dx, int dy)
+{
+    SDL_Surface *surface = self->surface;
+    Uint8 *src, *dst;
+    int bpp, i;
+
+    /* Keep both the source and the destination in the surface. */
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + dx < 0) { w += x + dx; x -= x + dx; }
+    if (y + dy < 0) { h += y + dy; y -= y + dy; }
+    if (x + w > surface->w) w = surface->w - x;
+    if (y + h > surface->h) h = surface->h - y;
+    if (x + dx + w > surface->w) w = surface->w - x - dx;
+    if (y + dy + h > surface->h) h = surface->h - y - dy;
+
+    if (w <= 0 || h <= 0)
+        return 1;
+
+    bpp = surface->format->BytesPerPixel;
+    SDL_LockSurface(surface);
+    src = (Uint8*)surface->pixels + y * surface->pitch + x * bpp;
+    dst = src + dy * surface->pitch + dx * bpp;
+
+    /* Copy bottom-up when moving down to not overwrite the source. */
+    if (dy > 0) {
+        for (i = h - 1; i >= 0; --i) {
+            memmove(dst + i * surface->pitch,
+                    src + i * surface->pitch, w * bpp);
+        }
+    }
+    else {
+        for (i = 0; i < h; ++i) {
+            memmove(dst + i * surface->pitch,
+                    src + i * surface->pitch, w * bpp);
+        }
+    }
+
+    SDL_UnlockSurface(surface);
+    return 1;
+}
+
 static void _sdl_backwin_handle_event(
     struct _sdl_backwin *self, SDL_Event *event)
 {
@@ -370,6 +415,7 @@ const void* mume_sdl_backwin_class(void)
         _mume_backwin_set_cursor, _sdl_backwin_set_cursor,
         _mume_backwin_begin_paint, _sdl_backwin_begin_paint,
         _mume_backwin_end_paint, _sdl_backwin_end_paint,
+        _mume_backwin_scroll_area, _sdl_backwin_scroll_area,
         _mume_sdl_backwin_handle_event,
         _sdl_backwin_handle_event,
         _mume_sdl_backwin_handle_key_down,
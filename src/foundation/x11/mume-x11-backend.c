@@ -3,6 +3,7 @@
  * James Wong, jamone@126.com
  *==================================================*/
 #include "mume-x11-backend.h"
+#include "mume-config.h"
 #include "mume-debug.h"
 #include "mume-events.h"
 #include "mume-memory.h"
@@ -15,6 +16,20 @@
 #include "mume-x11-util.h"
 #include MUME_ASSERT_H
 
+#if HAVE_SYS_EPOLL_H && HAVE_SYS_EVENTFD_H
+# define _X11_USE_EPOLL 1
+# include <stdint.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <unistd.h>
+#else
+# define _X11_USE_EPOLL 0
+#endif
+
+/* Upper bound of the X events dispatched by one handle_event,
+ * keeps the timers and posted events from starving. */
+#define _X11_EVENT_BATCH 512
+
 #define _x11_backend_super_class mume_backend_class
 
 struct _window_pair {
@@ -26,7 +41,11 @@ struct _x11_backend {
     const char _[MUME_SIZEOF_BACKEND];
     Display *display;
     int screen;
+    /* The read and write end, both are the same eventfd
+     * if epoll is used. */
     int wakeup_pipe[2];
+    /* -1 if waiting with select on the pipe. */
+    int epoll_fd;
     mume_oset_t *windows;
     void *root_window;
 };
@@ -58,6 +77,47 @@ static int _window_pair_compare(const void *a, const void *b)
     return (int)p1->xwindow - (int)p2->xwindow;
 }
 
+#if _X11_USE_EPOLL
+
+/* Wait with epoll on the X connection and an eventfd, leave
+ * <epoll_fd> -1 to fall back to select if any of them fails. */
+static void _x11_backend_open_epoll(struct _x11_backend *self)
+{
+    struct epoll_event ev;
+    int efd, wfd;
+
+    efd = epoll_create1(EPOLL_CLOEXEC);
+    if (-1 == efd) {
+        mume_warning(("epoll_create1 failed\n"));
+        return;
+    }
+
+    wfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (-1 == wfd) {
+        mume_warning(("eventfd failed\n"));
+        close(efd);
+        return;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = ConnectionNumber(self->display);
+    if (0 == epoll_ctl(efd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+        ev.data.fd = wfd;
+        if (0 == epoll_ctl(efd, EPOLL_CTL_ADD, ev.data.fd, &ev)) {
+            self->epoll_fd = efd;
+            self->wakeup_pipe[0] = wfd;
+            self->wakeup_pipe[1] = wfd;
+            return;
+        }
+    }
+
+    mume_warning(("epoll_ctl failed\n"));
+    close(wfd);
+    close(efd);
+}
+
+#endif /* _X11_USE_EPOLL */
+
 static void* _x11_backend_ctor(
     struct _x11_backend *self, int mode, va_list *app)
 {
@@ -75,7 +135,11 @@ static void* _x11_backend_ctor(
     window = RootWindow(self->display, self->screen);
     self->root_window =  mume_x11_backwin_new(self, window, 0);
 
-    if (0 != pipe(self->wakeup_pipe))
+    self->epoll_fd = -1;
+#if _X11_USE_EPOLL
+    _x11_backend_open_epoll(self);
+#endif
+    if (-1 == self->epoll_fd && 0 != pipe(self->wakeup_pipe))
         mume_error(("Open wakeup pipe failed\n"));
 
     return self;
@@ -88,7 +152,10 @@ static void* _x11_backend_dtor(struct _x11_backend *self)
 
     mume_oset_delete(self->windows);
     close(self->wakeup_pipe[0]);
-    close(self->wakeup_pipe[1]);
+    if (self->epoll_fd != -1)
+        close(self->epoll_fd);
+    else
+        close(self->wakeup_pipe[1]);
     XCloseDisplay(self->display);
 
     return _mume_dtor(_x11_backend_super_class(), self);
@@ -157,50 +224,103 @@ static void* _x11_backend_create_cursor(
     return NULL;
 }
 
-static int _x11_backend_handle_event(
-    struct _x11_backend *self, int wait)
+#if _X11_USE_EPOLL
+
+/* Wait until the X connection or the wakeup eventfd is readable,
+ * <wait> milliseconds at most. */
+static void _x11_backend_epoll_wait(struct _x11_backend *self, int wait)
 {
-    if (!XPending(self->display)) {
-        fd_set rfds;
-        int xfd = ConnectionNumber(self->display);
-        int nfd = MAX(xfd, self->wakeup_pipe[0]);
-        int result = 0;
-
-        FD_ZERO(&rfds);
-        FD_SET(xfd, &rfds);
-        FD_SET(self->wakeup_pipe[0], &rfds);
-        if (MUME_WAIT_INFINITE == wait) {
-            result = select(nfd + 1, &rfds, 0, 0, NULL);
-        }
-        else if (wait > 0) {
-            struct timeval tv;
-            tv.tv_sec = wait / 1000;
-            tv.tv_usec = wait % 1000 * 1000;
-            result = select(nfd + 1, &rfds, 0, 0, &tv);
-        }
+    int i, count;
+    uint64_t value;
+    struct epoll_event evs[2];
+
+    count = epoll_wait(self->epoll_fd, evs, COUNT_OF(evs),
+                       MUME_WAIT_INFINITE == wait ? -1 : wait);
 
-        if (result > 0 && FD_ISSET(self->wakeup_pipe[0], &rfds)) {
-            int cmd, n;
-            n = read(self->wakeup_pipe[0], &cmd, sizeof(cmd));
-            mume_debug(("Wakeup command: %d:%d\n", cmd, n));
+    for (i = 0; i < count; ++i) {
+        if (evs[i].data.fd == self->wakeup_pipe[0]) {
+            if (read(self->wakeup_pipe[0], &value, sizeof(value)) > 0)
+                mume_debug(("Wakeup count: %d\n", (int)value));
         }
     }
+}
 
-    if (XPending(self->display)) {
-        XEvent xevent;
-        XNextEvent(self->display, &xevent);
-        mume_x11_backend_dispatch(self, &xevent);
+#endif /* _X11_USE_EPOLL */
+
+static void _x11_backend_wait(struct _x11_backend *self, int wait)
+{
+    fd_set rfds;
+    int xfd = ConnectionNumber(self->display);
+    int nfd = MAX(xfd, self->wakeup_pipe[0]);
+    int result = 0;
+
+#if _X11_USE_EPOLL
+    if (self->epoll_fd != -1) {
+        _x11_backend_epoll_wait(self, wait);
+        return;
     }
+#endif
 
-    return 1;
+    FD_ZERO(&rfds);
+    FD_SET(xfd, &rfds);
+    FD_SET(self->wakeup_pipe[0], &rfds);
+    if (MUME_WAIT_INFINITE == wait) {
+        result = select(nfd + 1, &rfds, 0, 0, NULL);
+    }
+    else {
+        struct timeval tv;
+        tv.tv_sec = wait / 1000;
+        tv.tv_usec = wait % 1000 * 1000;
+        result = select(nfd + 1, &rfds, 0, 0, &tv);
+    }
+
+    if (result > 0 && FD_ISSET(self->wakeup_pipe[0], &rfds)) {
+        int cmd, n;
+        n = read(self->wakeup_pipe[0], &cmd, sizeof(cmd));
+        mume_debug(("Wakeup command: %d:%d\n", cmd, n));
+    }
 }
 
 static int _x11_backend_wakeup_event(struct _x11_backend *self)
 {
     int cmd = 0;
+
+#if _X11_USE_EPOLL
+    if (self->epoll_fd != -1) {
+        uint64_t value = 1;
+        return write(self->wakeup_pipe[1], &value, sizeof(value));
+    }
+#endif
+
     return write(self->wakeup_pipe[1], &cmd, sizeof(cmd));
 }
 
+static int _x11_backend_handle_event(
+    struct _x11_backend *self, int wait)
+{
+    int count;
+    XEvent xevent;
+
+    count = XPending(self->display);
+    if (0 == count && wait != 0) {
+        _x11_backend_wait(self, wait);
+        count = XPending(self->display);
+    }
+
+    /* Dispatch the queued events in one go rather than one per
+     * call, dispatching may remove events (e.g. configure), so
+     * check the queue again without reading. */
+    if (count > _X11_EVENT_BATCH)
+        count = _X11_EVENT_BATCH;
+
+    while (count-- > 0 && XEventsQueued(self->display, QueuedAlready)) {
+        XNextEvent(self->display, &xevent);
+        mume_x11_backend_dispatch(self, &xevent);
+    }
+
+    return 1;
+}
+
 static void _x11_backend_query_pointer(
     struct _x11_backend *self, int *x, int *y, int *state)
 {
@@ -25,7 +25,7 @@ MUME_BEGIN_DECLS
 
 #define MUME_SIZEOF_X11_BACKEND (MUME_SIZEOF_BACKEND + \
                                  sizeof(void*) * 3 +   \
-                                 sizeof(int) * 3)
+                                 sizeof(int) * 4)
 
 #define MUME_SIZEOF_X11_BACKEND_CLASS (MUME_SIZEOF_BACKEND_CLASS)
 
@@ -307,6 +307,31 @@ static void _x11_backwin_ungrab_pointer(struct _x11_backwin *self)
     XUngrabPointer(display, CurrentTime);
 }
 
+static int _x11_backwin_scroll_area(
+    struct _x11_backwin *self, int x, int y,
+    int w, int h, int dx, int dy)
+{
+    Display *display;
+    int screen;
+
+    if (!self->managed)
+        return 0;
+
+    display = mume_x11_backend_get_display(self->backend);
+    screen = mume_x11_backend_get_screen(self->backend);
+
+    if (self->surface)
+        cairo_surface_flush(self->surface);
+
+    /* Obscured parts of the source are reported by GraphicsExpose,
+     * which is handled as a normal expose. */
+    XCopyArea(display, self->window, self->window,
+              DefaultGC(display, screen),
+              x, y, w, h, x + dx, y + dy);
+
+    return 1;
+}
+
 static void _x11_backwin_handle_event(
     struct _x11_backwin *self, XEvent *xevent)
 {
@@ -678,6 +703,8 @@ const void* mume_x11_backwin_class(void)
         _x11_backwin_grab_pointer,
         _mume_backwin_ungrab_pointer,
         _x11_backwin_ungrab_pointer,
+        _mume_backwin_scroll_area,
+        _x11_backwin_scroll_area,
         _mume_x11_backwin_handle_event,
         _x11_backwin_handle_event,
         _mume_x11_backwin_handle_key_press,
@@ -59,7 +59,7 @@ static void* _book_ctor(
         if (NULL == self->id && self->path) {
             mume_stream_t *stm;
 
-            stm = mume_file_stream_open(self->path, MUME_OM_READ);
+            stm = mume_mmap_stream_open(self->path);
             if (stm) {
                 self->id = mume_create_digest(stm);
                 mume_stream_close(stm);
@@ -22,6 +22,8 @@
 
 struct _docdoc {
     const char _[MUME_SIZEOF_REFOBJ];
+    mume_mutex_t *mutex;
+    mume_pagecache_t *cache;
 };
 
 struct _docdoc_class {
@@ -35,16 +37,41 @@ struct _docdoc_class {
     int (*text_length)(void *self, int pageno);
     void (*extract_text)(void *self, int pageno,
                          char *tbuf, mume_rect_t *rbuf);
+    int (*get_text)(void *self, int pageno,
+                    char **tbuf, mume_rect_t **rbuf);
     void (*render_page)(void *self, cairo_t *cr, int x, int y,
                         int p, mume_matrix_t m, mume_rect_t r);
     mume_tocitem_t* (*get_toc_tree)(void *self);
     mume_doclink_t* (*get_page_links)(void *self, int pageno);
+    int (*reflow)(void *self, int width, int count);
+    int (*follow)(void *self, void *window, int code);
+    int (*update)(void *self);
+    int (*render_async)(void *self);
+    int (*set_stream)(void *self, mume_stream_t *stm);
 };
 
 MUME_STATIC_ASSERT(sizeof(struct _docdoc) == MUME_SIZEOF_DOCDOC);
 MUME_STATIC_ASSERT(sizeof(struct _docdoc_class) ==
                    MUME_SIZEOF_DOCDOC_CLASS);
 
+static void* _docdoc_ctor(
+    struct _docdoc *self, int mode, va_list *app)
+{
+    if (!_mume_ctor(_docdoc_super_class(), self, mode, app))
+        return NULL;
+
+    self->mutex = mume_mutex_new();
+    self->cache = mume_pagecache_new(MUME_PAGECACHE_DEFAULT_BUDGET);
+    return self;
+}
+
+static void* _docdoc_dtor(struct _docdoc *self)
+{
+    mume_pagecache_delete(self->cache);
+    mume_mutex_delete(self->mutex);
+    return _mume_dtor(_docdoc_super_class(), self);
+}
+
 static int _docdoc_load(void *self, mume_stream_t *stm)
 {
     return 0;
@@ -81,6 +108,23 @@ static void _docdoc_extract_text(
 {
 }
 
+static int _docdoc_get_text(
+    void *self, int pageno, char **tbuf, mume_rect_t **rbuf)
+{
+    int length = mume_docdoc_text_length(self, pageno);
+
+    *tbuf = NULL;
+    *rbuf = NULL;
+
+    if (length > 0) {
+        *tbuf = malloc_abort(length * sizeof(**tbuf));
+        *rbuf = malloc_abort(length * sizeof(**rbuf));
+        mume_docdoc_extract_text(self, pageno, *tbuf, *rbuf);
+    }
+
+    return length;
+}
+
 static void _docdoc_render_page(
     void *self, cairo_t *cr, int x, int y,
     int p, mume_matrix_t m, mume_rect_t r)
@@ -97,6 +141,31 @@ static mume_doclink_t* _docdoc_get_page_links(void *self, int pageno)
     return NULL;
 }
 
+static int _docdoc_reflow(void *self, int width, int count)
+{
+    return 0;
+}
+
+static int _docdoc_follow(void *self, void *window, int code)
+{
+    return 0;
+}
+
+static int _docdoc_update(void *self)
+{
+    return 0;
+}
+
+static int _docdoc_render_async(void *self)
+{
+    return 1;
+}
+
+static int _docdoc_set_stream(void *self, mume_stream_t *stm)
+{
+    return 0;
+}
+
 static void* _docdoc_class_ctor(
     struct _docdoc_class *self, int mode, va_list *app)
 {
@@ -124,12 +193,24 @@ static void* _docdoc_class_ctor(
             *(voidf**)&self->text_length = method;
         else if (selector == (voidf*)_mume_docdoc_extract_text)
             *(voidf**)&self->extract_text = method;
+        else if (selector == (voidf*)_mume_docdoc_get_text)
+            *(voidf**)&self->get_text = method;
         else if (selector == (voidf*)_mume_docdoc_render_page)
             *(voidf**)&self->render_page = method;
         else if (selector == (voidf*)_mume_docdoc_get_toc_tree)
             *(voidf**)&self->get_toc_tree = method;
         else if (selector == (voidf*)_mume_docdoc_get_page_links)
             *(voidf**)&self->get_page_links = method;
+        else if (selector == (voidf*)_mume_docdoc_reflow)
+            *(voidf**)&self->reflow = method;
+        else if (selector == (voidf*)_mume_docdoc_follow)
+            *(voidf**)&self->follow = method;
+        else if (selector == (voidf*)_mume_docdoc_update)
+            *(voidf**)&self->update = method;
+        else if (selector == (voidf*)_mume_docdoc_render_async)
+            *(voidf**)&self->render_async = method;
+        else if (selector == (voidf*)_mume_docdoc_set_stream)
+            *(voidf**)&self->set_stream = method;
     }
 
     return self;
@@ -146,6 +227,8 @@ const void* mume_docdoc_class(void)
         _docdoc_super_class(),
         sizeof(struct _docdoc),
         MUME_PROP_END,
+        _mume_ctor, _docdoc_ctor,
+        _mume_dtor, _docdoc_dtor,
         _mume_docdoc_load, _docdoc_load,
         _mume_docdoc_title, _docdoc_title,
         _mume_docdoc_count_pages,
@@ -158,12 +241,24 @@ const void* mume_docdoc_class(void)
         _docdoc_text_length,
         _mume_docdoc_extract_text,
         _docdoc_extract_text,
+        _mume_docdoc_get_text,
+        _docdoc_get_text,
         _mume_docdoc_render_page,
         _docdoc_render_page,
         _mume_docdoc_get_toc_tree,
         _docdoc_get_toc_tree,
         _mume_docdoc_get_page_links,
         _docdoc_get_page_links,
+        _mume_docdoc_reflow,
+        _docdoc_reflow,
+        _mume_docdoc_follow,
+        _docdoc_follow,
+        _mume_docdoc_update,
+        _docdoc_update,
+        _mume_docdoc_render_async,
+        _docdoc_render_async,
+        _mume_docdoc_set_stream,
+        _docdoc_set_stream,
         MUME_FUNC_END);
 }
 
@@ -238,6 +333,16 @@ void _mume_docdoc_extract_text(
         (_self, pageno, tbuf, rbuf));
 }
 
+int _mume_docdoc_get_text(
+    const void *_clazz, void *_self, int pageno,
+    char **tbuf, mume_rect_t **rbuf)
+{
+    MUME_SELECTOR_RETURN(
+        mume_docdoc_meta_class(), mume_docdoc_class(),
+        struct _docdoc_class, get_text,
+        (_self, pageno, tbuf, rbuf));
+}
+
 void _mume_docdoc_render_page(
     const void *_clazz, void *_self, cairo_t *cr, int x, int y,
     int pageno, mume_matrix_t ctm, mume_rect_t rect)
@@ -264,6 +369,65 @@ mume_doclink_t* _mume_docdoc_get_page_links(
         struct _docdoc_class, get_page_links, (_self, pageno));
 }
 
+int _mume_docdoc_reflow(
+    const void *_clazz, void *_self, int width, int count)
+{
+    MUME_SELECTOR_RETURN(
+        mume_docdoc_meta_class(), mume_docdoc_class(),
+        struct _docdoc_class, reflow, (_self, width, count));
+}
+
+int _mume_docdoc_follow(
+    const void *_clazz, void *_self, void *window, int code)
+{
+    MUME_SELECTOR_RETURN(
+        mume_docdoc_meta_class(), mume_docdoc_class(),
+        struct _docdoc_class, follow, (_self, window, code));
+}
+
+int _mume_docdoc_update(const void *_clazz, void *_self)
+{
+    MUME_SELECTOR_RETURN(
+        mume_docdoc_meta_class(), mume_docdoc_class(),
+        struct _docdoc_class, update, (_self));
+}
+
+int _mume_docdoc_render_async(const void *_clazz, void *_self)
+{
+    MUME_SELECTOR_RETURN(
+        mume_docdoc_meta_class(), mume_docdoc_class(),
+        struct _docdoc_class, render_async, (_self));
+}
+
+int _mume_docdoc_set_stream(
+    const void *_clazz, void *_self, mume_stream_t *stm)
+{
+    MUME_SELECTOR_RETURN(
+        mume_docdoc_meta_class(), mume_docdoc_class(),
+        struct _docdoc_class, set_stream, (_self, stm));
+}
+
+void mume_docdoc_lock(void *_self)
+{
+    struct _docdoc *self = _self;
+    assert(mume_is_of(_self, mume_docdoc_class()));
+    mume_mutex_lock(self->mutex);
+}
+
+void mume_docdoc_unlock(void *_self)
+{
+    struct _docdoc *self = _self;
+    assert(mume_is_of(_self, mume_docdoc_class()));
+    mume_mutex_unlock(self->mutex);
+}
+
+mume_pagecache_t* mume_docdoc_get_cache(const void *_self)
+{
+    const struct _docdoc *self = _self;
+    assert(mume_is_of(_self, mume_docdoc_class()));
+    return self->cache;
+}
+
 mume_tocitem_t* mume_tocitem_create(
     mume_tocitem_t *parent, mume_tocitem_t *sibling,
     const char *title, int pageno)
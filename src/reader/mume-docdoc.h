@@ -20,14 +20,15 @@
 
 /* The docdoc object represent a loaded (opened) document. */
 
-#include "mume-common.h"
+#include "mume-pagecache.h"
 
 MUME_BEGIN_DECLS
 
-#define MUME_SIZEOF_DOCDOC (MUME_SIZEOF_REFOBJ)
+#define MUME_SIZEOF_DOCDOC (MUME_SIZEOF_REFOBJ + \
+                            sizeof(void*) * 2)
 
 #define MUME_SIZEOF_DOCDOC_CLASS (MUME_SIZEOF_REFOBJ_CLASS + \
-                                  sizeof(voidf*) * 10)
+                                  sizeof(voidf*) * 16)
 
 typedef struct mume_tocitem_s mume_tocitem_t;
 typedef struct mume_doclink_s mume_doclink_t;
@@ -101,6 +102,17 @@ murdr_public void _mume_docdoc_extract_text(
 #define mume_docdoc_extract_text(_self, _pageno, _tbuf, _rbuf) \
     _mume_docdoc_extract_text(NULL, _self, _pageno, _tbuf, _rbuf)
 
+/* Selector for get the text of the specified page in one pass.
+ * The text and the rect of each character are returned in
+ * <tbuf> and <rbuf>, which must be freed by the caller with
+ * free. Return the text length, the buffers are NULL if zero. */
+murdr_public int _mume_docdoc_get_text(
+    const void *clazz, void *self, int pageno,
+    char **tbuf, mume_rect_t **rbuf);
+
+#define mume_docdoc_get_text(_self, _pageno, _tbuf, _rbuf) \
+    _mume_docdoc_get_text(NULL, _self, _pageno, _tbuf, _rbuf)
+
 /* Selector for render the specified page. */
 murdr_public void _mume_docdoc_render_page(
     const void *clazz, void *self, cairo_t *cr, int x, int y,
@@ -123,6 +135,64 @@ murdr_public mume_doclink_t* _mume_docdoc_get_page_links(
 #define mume_docdoc_get_page_links(_self, _pageno) \
     _mume_docdoc_get_page_links(NULL, _self, _pageno)
 
+/* Selector for reflow the pages to <width>, or back to the
+ * original pages if <width> is zero. Only the pages from the first
+ * one changed by the new width are paginated again, at most <count>
+ * pages each call. Return nonzero if there are more pages to
+ * paginate, zero if done or the document can't reflow. */
+murdr_public int _mume_docdoc_reflow(
+    const void *clazz, void *self, int width, int count);
+
+#define mume_docdoc_reflow(_self, _width, _count) \
+    _mume_docdoc_reflow(NULL, _self, _width, _count)
+
+/* Selector for follow the growth of the document's file, <window>
+ * is notified with MUME_EVENT_NOTIFY of <code> when data may be
+ * appended, then mume_docdoc_update reads it. Stop following if
+ * <window> is NULL. Return zero if the document can't grow. */
+murdr_public int _mume_docdoc_follow(
+    const void *clazz, void *self, void *window, int code);
+
+#define mume_docdoc_follow(_self, _window, _code) \
+    _mume_docdoc_follow(NULL, _self, _window, _code)
+
+/* Selector for read the data appended since the document is loaded
+ * or updated, without reading the data before. The last page may
+ * change and new pages are added after it. Return nonzero if the
+ * document is changed. */
+murdr_public int _mume_docdoc_update(const void *clazz, void *self);
+
+#define mume_docdoc_update(_self) \
+    _mume_docdoc_update(NULL, _self)
+
+/* Selector for whether the pages can be rendered on threads other
+ * than the GUI thread. Documents drawing with the GUI resources,
+ * like the fonts of the theme, must be rendered on the GUI thread. */
+murdr_public int _mume_docdoc_render_async(const void *clazz, void *self);
+
+#define mume_docdoc_render_async(_self) \
+    _mume_docdoc_render_async(NULL, _self)
+
+/* Selector for reading <stm> instead of the stream the document is
+ * loaded from, which has the same data, such as the source of a
+ * progress stream. Return zero if the document keeps its stream. */
+murdr_public int _mume_docdoc_set_stream(
+    const void *clazz, void *self, mume_stream_t *stm);
+
+#define mume_docdoc_set_stream(_self, _stm) \
+    _mume_docdoc_set_stream(NULL, _self, _stm)
+
+/* Document backends are not reentrant, any thread other than the
+ * GUI thread must hold the document lock when calling its selectors,
+ * and so must the GUI thread when a document is shared with others. */
+murdr_public void mume_docdoc_lock(void *self);
+
+murdr_public void mume_docdoc_unlock(void *self);
+
+/* Get the page cache of the document, both the document and
+ * its users can cache the page data in it. */
+murdr_public mume_pagecache_t* mume_docdoc_get_cache(const void *self);
+
 /* Utility functions. */
 murdr_public mume_tocitem_t* mume_tocitem_create(
     mume_tocitem_t *parent, mume_tocitem_t *sibling,
@@ -28,12 +28,32 @@ struct _docloader {
     mume_list_t *list;
 };
 
+/* A document loading on a worker thread. */
+struct _docload {
+    struct _docmgr *mgr;
+    char *file;
+    int type;
+    /* Receiver of the notify events, NULL if cancelled. */
+    void *window;
+    int code;
+    int state;
+    int progress;
+    /* Notify event not yet handled. */
+    int notified;
+    void *doc;
+    mume_thread_t *thread;
+};
+
 struct _docmgr {
     const char _[MUME_SIZEOF_OBJECT];
     /* Document loaders. */
     mume_oset_t *ldrs;
     /* Loaded documents. */
     mume_list_t *docs;
+    /* Guards the loads below. */
+    mume_mutex_t *mutex;
+    /* Documents loading. */
+    mume_list_t *loads;
 };
 
 MUME_STATIC_ASSERT(sizeof(struct _docmgr) == MUME_SIZEOF_DOCMGR);
@@ -60,12 +80,19 @@ static void* _docmgr_ctor(
     self->ldrs = mume_oset_new(
         _docloader_compare, _docloader_destruct, NULL);
     self->docs = mume_list_new(mume_object_destruct, NULL);
+    self->mutex = mume_mutex_new();
+    self->loads = mume_list_new(NULL, NULL);
 
     return self;
 }
 
+static void _docmgr_reap_loads(struct _docmgr *self, int all);
+
 static void* _docmgr_dtor(struct _docmgr *self)
 {
+    _docmgr_reap_loads(self, 1);
+    mume_list_delete(self->loads);
+    mume_mutex_delete(self->mutex);
     mume_list_delete(self->docs);
     mume_oset_delete(self->ldrs);
 
@@ -113,16 +140,16 @@ void mume_docmgr_register(void *_self, int type, const void *clazz)
     *(const void**)mume_list_data(ln) = clazz;
 }
 
-void* mume_docmgr_load(void *_self, int type, mume_stream_t *stm)
+/* Create a document from the stream, without adding it to the
+ * loaded documents. Can be called on any thread. */
+static void* _docmgr_create_doc(
+    struct _docmgr *self, int type, mume_stream_t *stm)
 {
-    struct _docmgr *self = _self;
     struct _docloader *lr;
     void **ldr;
     mume_oset_node_t *sn;
     mume_list_node_t *ln;
 
-    assert(mume_is_of(_self, mume_docmgr_class()));
-
     if (MUME_FILETYPE_UNKNOWN == type) {
         /* Check file type. */
         type = mume_filetc_check_magic(mume_filetc(), stm);
@@ -137,22 +164,164 @@ void* mume_docmgr_load(void *_self, int type, mume_stream_t *stm)
     lr = (struct _docloader*)mume_oset_data(sn);
     mume_list_foreach(lr->list, ln, ldr) {
         void *doc = mume_new(*ldr);
-        if (_mume_docdoc_load(NULL, doc, stm)) {
-            ln = mume_list_push_back(self->docs, sizeof(void*));
-            *(void**)mume_list_data(ln) = doc;
+        if (_mume_docdoc_load(NULL, doc, stm))
             return doc;
-        }
+
         mume_delete(doc);
     }
 
     return NULL;
 }
 
+static void _docmgr_add_doc(struct _docmgr *self, void *doc)
+{
+    mume_list_node_t *ln;
+    ln = mume_list_push_back(self->docs, sizeof(void*));
+    *(void**)mume_list_data(ln) = doc;
+}
+
+/* Must be called with the mutex locked. */
+static void _docload_notify(struct _docload *load)
+{
+    if (load->window && !load->notified) {
+        load->notified = 1;
+        mume_post_event(mume_make_notify_event(
+            load->window, load->window, load->code, NULL));
+    }
+}
+
+static int _docload_progress(void *data, size_t pos, size_t length)
+{
+    struct _docload *load = data;
+    int progress = 0;
+    int result;
+
+    if (length)
+        progress = (int)(100.0 * MIN(pos, length) / length);
+
+    mume_mutex_lock(load->mgr->mutex);
+    result = load->window != NULL;
+    if (result && progress > load->progress) {
+        load->progress = progress;
+        _docload_notify(load);
+    }
+
+    mume_mutex_unlock(load->mgr->mutex);
+    return result;
+}
+
+static void _docload_proc(void *param)
+{
+    struct _docload *load = param;
+    mume_stream_t *stm, *progress;
+    void *doc = NULL;
+    int cancelled;
+
+    stm = mume_mmap_stream_open(load->file);
+    if (stm) {
+        progress = mume_progress_stream_open(
+            stm, _docload_progress, load);
+        doc = _docmgr_create_doc(load->mgr, load->type, progress);
+        /* The document may keep reading from the stream, make it
+         * read the source directly. */
+        mume_progress_stream_detach(progress);
+        if (doc)
+            mume_docdoc_set_stream(doc, stm);
+
+        mume_stream_close(progress);
+        mume_stream_close(stm);
+    }
+
+    mume_mutex_lock(load->mgr->mutex);
+    cancelled = NULL == load->window;
+    if (!cancelled)
+        load->doc = doc;
+
+    load->state = MUME_DOCLOAD_FINISHED;
+    load->progress = 100;
+    _docload_notify(load);
+    mume_mutex_unlock(load->mgr->mutex);
+
+    /* Nobody wants the document of a cancelled load. */
+    if (cancelled && doc)
+        mume_delete(doc);
+}
+
+static mume_list_node_t* _docmgr_find_load(
+    struct _docmgr *self, void *window)
+{
+    mume_list_node_t *ln;
+    struct _docload *load;
+
+    mume_list_foreach(self->loads, ln, load) {
+        if (load->window == window)
+            return ln;
+    }
+
+    return NULL;
+}
+
+static void _docmgr_erase_load(
+    struct _docmgr *self, mume_list_node_t *ln)
+{
+    struct _docload *load = mume_list_data(ln);
+
+    mume_thread_join(load->thread);
+    mume_thread_delete(load->thread);
+
+    if (load->doc)
+        mume_delete(load->doc);
+
+    free(load->file);
+    mume_list_erase(self->loads, ln);
+}
+
+/* Join the cancelled loads which are finished, or all the loads if
+ * <all> is nonzero. */
+static void _docmgr_reap_loads(struct _docmgr *self, int all)
+{
+    mume_list_node_t *ln, *next;
+    struct _docload *load;
+
+    if (all) {
+        mume_mutex_lock(self->mutex);
+        mume_list_foreach(self->loads, ln, load)
+            load->window = NULL;
+
+        mume_mutex_unlock(self->mutex);
+    }
+
+    mume_list_foreach_safe(self->loads, ln, load, next) {
+        int finished;
+
+        mume_mutex_lock(self->mutex);
+        finished = MUME_DOCLOAD_FINISHED == load->state;
+        mume_mutex_unlock(self->mutex);
+
+        if (all || (NULL == load->window && finished))
+            _docmgr_erase_load(self, ln);
+    }
+}
+
+void* mume_docmgr_load(void *_self, int type, mume_stream_t *stm)
+{
+    struct _docmgr *self = _self;
+    void *doc;
+
+    assert(mume_is_of(_self, mume_docmgr_class()));
+
+    doc = _docmgr_create_doc(self, type, stm);
+    if (doc)
+        _docmgr_add_doc(self, doc);
+
+    return doc;
+}
+
 void* mume_docmgr_load_file(void *self, const char *file)
 {
     void *doc;
     int type = mume_filetc_check_ext(mume_filetc(), file);
-    mume_stream_t *stm = mume_file_stream_open(file, MUME_OM_READ);
+    mume_stream_t *stm = mume_mmap_stream_open(file);
 
     if (NULL == stm)
         return NULL;
@@ -162,3 +331,109 @@ void* mume_docmgr_load_file(void *self, const char *file)
 
     return doc;
 }
+
+int mume_docmgr_load_file_async(
+    void *_self, const char *file, void *window, int code)
+{
+    struct _docmgr *self = _self;
+    struct _docload *load;
+    mume_list_node_t *ln;
+
+    assert(mume_is_of(_self, mume_docmgr_class()));
+    assert(window);
+
+    mume_docmgr_cancel_load(self, window);
+
+    ln = mume_list_push_back(self->loads, sizeof(struct _docload));
+    load = mume_list_data(ln);
+    load->mgr = self;
+    load->file = strdup_abort(file);
+    load->type = mume_filetc_check_ext(mume_filetc(), file);
+    load->window = window;
+    load->code = code;
+    load->state = MUME_DOCLOAD_RUNNING;
+    load->progress = 0;
+    load->notified = 0;
+    load->doc = NULL;
+
+    /* The list is only changed on this thread, the worker holds
+     * the load until it's joined. */
+    load->thread = mume_thread_new(_docload_proc, load);
+    if (NULL == load->thread) {
+        free(load->file);
+        mume_list_erase(self->loads, ln);
+        return 0;
+    }
+
+    return 1;
+}
+
+int mume_docmgr_poll_load(void *_self, void *window, int *progress)
+{
+    struct _docmgr *self = _self;
+    struct _docload *load;
+    mume_list_node_t *ln;
+    int state = MUME_DOCLOAD_NONE;
+
+    assert(mume_is_of(_self, mume_docmgr_class()));
+
+    mume_mutex_lock(self->mutex);
+    ln = window ? _docmgr_find_load(self, window) : NULL;
+    if (ln) {
+        load = mume_list_data(ln);
+        load->notified = 0;
+        state = load->state;
+
+        if (progress)
+            *progress = load->progress;
+    }
+
+    mume_mutex_unlock(self->mutex);
+    return state;
+}
+
+void* mume_docmgr_finish_load(void *_self, void *window)
+{
+    struct _docmgr *self = _self;
+    struct _docload *load;
+    mume_list_node_t *ln;
+    void *doc;
+
+    assert(mume_is_of(_self, mume_docmgr_class()));
+
+    if (mume_docmgr_poll_load(self, window, NULL) !=
+        MUME_DOCLOAD_FINISHED)
+    {
+        return NULL;
+    }
+
+    ln = _docmgr_find_load(self, window);
+    load = mume_list_data(ln);
+    doc = load->doc;
+    load->doc = NULL;
+    _docmgr_erase_load(self, ln);
+
+    if (doc)
+        _docmgr_add_doc(self, doc);
+
+    _docmgr_reap_loads(self, 0);
+    return doc;
+}
+
+void mume_docmgr_cancel_load(void *_self, void *window)
+{
+    struct _docmgr *self = _self;
+    mume_list_node_t *ln;
+
+    assert(mume_is_of(_self, mume_docmgr_class()));
+
+    mume_mutex_lock(self->mutex);
+    ln = window ? _docmgr_find_load(self, window) : NULL;
+    if (ln)
+        ((struct _docload*)mume_list_data(ln))->window = NULL;
+
+    mume_mutex_unlock(self->mutex);
+
+    /* The worker may still be running, it's joined later. */
+    _docmgr_reap_loads(self, 0);
+}
@@ -25,11 +25,19 @@
 MUME_BEGIN_DECLS
 
 #define MUME_SIZEOF_DOCMGR (MUME_SIZEOF_OBJECT +    \
+                            sizeof(void*) +         \
+                            sizeof(void*) +         \
                             sizeof(void*) +         \
                             sizeof(void*))
 
 #define MUME_SIZEOF_DOCMGR_CLASS (MUME_SIZEOF_CLASS)
 
+enum mume_docload_state_e {
+    MUME_DOCLOAD_NONE,
+    MUME_DOCLOAD_RUNNING,
+    MUME_DOCLOAD_FINISHED
+};
+
 murdr_public const void* mume_docmgr_class(void);
 
 #define mume_docmgr_meta_class mume_meta_class
@@ -58,6 +66,35 @@ murdr_public void* mume_docmgr_load(
 murdr_public void* mume_docmgr_load_file(
     void *self, const char *file);
 
+/* Load a document from file on a worker thread, for <window>.
+ *
+ * Notify events with <code> are posted to <window> when the load
+ * makes progress or is finished, <window> should check the load
+ * with mume_docmgr_poll_load then. A load started before for the
+ * same window is cancelled.
+ *
+ * Return zero if the load can't be started.
+ */
+murdr_public int mume_docmgr_load_file_async(
+    void *self, const char *file, void *window, int code);
+
+/* Check the load of <window>, return one of mume_docload_state_e.
+ * <progress> is set to the progress in percent if not NULL.
+ */
+murdr_public int mume_docmgr_poll_load(
+    void *self, void *window, int *progress);
+
+/* Take the document of the finished load of <window>, which is
+ * managed by the docmgr like mume_docmgr_load does. Return NULL
+ * if the load is failed, or not finished yet.
+ */
+murdr_public void* mume_docmgr_finish_load(void *self, void *window);
+
+/* Cancel the load of <window>, no more events are posted to the
+ * window when this returns.
+ */
+murdr_public void mume_docmgr_cancel_load(void *self, void *window);
+
 MUME_END_DECLS
 
 #endif /* MUME_READER_DOCMGR_H */
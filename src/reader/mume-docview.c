@@ -17,6 +17,11 @@
  */
 #include "mume-docview.h"
 #include "mume-docdoc.h"
+#include "mume-docmgr.h"
+#include "mume-glyphidx.h"
+#include "mume-gstate.h"
+#include "mume-renderq.h"
+#include "mume-tilecache.h"
 #include MUME_CTYPE_H
 #include MUME_FLOAT_H
 
@@ -25,6 +30,18 @@
 #define _DOCVIEW_ZOOM_MIN 0.125
 #define _DOCVIEW_ZOOM_MAX 64.0
 
+/* Document backends serialize rendering with the document lock,
+ * so more render threads won't help a single document. */
+#define _DOCVIEW_RENDER_THREADS 1
+
+/* Pages paginated each time when the pages are reflowed, the
+ * first ones at once and the rest as idle work. */
+#define _DOCVIEW_REFLOW_PAGES 8
+
+/* Kinds of the page cache data. */
+#define _DOCVIEW_CACHE_TEXT 0
+#define _DOCVIEW_CACHE_LINKS 1
+
 #define _docview_super_class mume_scrollview_class
 #define _docview_super_meta_class mume_scrollview_meta_class
 
@@ -36,12 +53,17 @@ enum _docview_flags_e {
     _DOCVIEW_FLAG_CLKLINK,
     _DOCVIEW_FLAG_SELCHAR,
     _DOCVIEW_FLAG_SELWORD,
-    _DOCVIEW_FLAG_WORD_BOUND
+    _DOCVIEW_FLAG_WORD_BOUND,
+    _DOCVIEW_FLAG_REFLOW,
+    _DOCVIEW_FLAG_REFLOWING,
+    _DOCVIEW_FLAG_FOLLOW,
+    _DOCVIEW_FLAG_MEASURING
 };
 
 typedef struct _page_text {
     char *texts;
     mume_rect_t *coords;
+    mume_glyphidx_t *index;
     int length;
 } _page_text_t;
 
@@ -49,15 +71,21 @@ struct _docview {
     const char _[MUME_SIZEOF_SCROLLVIEW];
     void *doc;
     mume_rect_t *page_rects;  /* Page in screen (without border). */
-    _page_text_t *page_texts; /* Extracted texts in each page. */
-    mume_doclink_t **page_links;   /* Extracted links in each page. */
+    mume_rect_t *page_sizes;  /* Page measured at zoom 1, unrotated. */
+    int *page_tops;           /* Top of each page (with border). */
+    char *page_exact;         /* Whether the page size is measured. */
+    mume_tilecache_t *tiles;  /* Rendered page tiles. */
+    mume_renderq_t *renderq;  /* Background tile renderer. */
     mume_rect_t page_border;  /* Border size around each page. */
+    int page_count;           /* Pages of the arrays above. */
+    int reflow_width;         /* Page width reflowed to. */
     int view_width;           /* View width (without page border). */
     int view_height;          /* View height (without page border). */
     int flags;
     float zoom;
     int rotate;
     int first_visible;        /* First visible page. */
+    int loading;              /* Loading progress, or -1. */
     int sel_start_p;
     int sel_start_i;
     int sel_end_p;
@@ -82,15 +110,19 @@ static void _docview_reset(struct _docview *self)
 {
     self->doc = NULL;
     self->page_rects = NULL;
-    self->page_texts = NULL;
-    self->page_links = NULL;
+    self->page_sizes = NULL;
+    self->page_tops = NULL;
+    self->page_exact = NULL;
     self->page_border = mume_rect_make(4, 4, 4, 4);
+    self->page_count = 0;
+    self->reflow_width = 0;
     self->view_width = 0;
     self->view_height = 0;
     self->flags = 0;
     self->zoom = 1.0;
     self->rotate = 0;
     self->first_visible = -1;
+    self->loading = -1;
     self->sel_start_p = 0;
     self->sel_start_i = 0;
     self->sel_end_p = 0;
@@ -99,55 +131,147 @@ static void _docview_reset(struct _docview *self)
 
 static void _docview_clear(struct _docview *self)
 {
-    int i, c = mume_docview_count_pages(self);
+    if (self->loading >= 0)
+        mume_docmgr_cancel_load(mume_docmgr(), self);
 
     free(self->page_rects);
+    free(self->page_sizes);
+    free(self->page_tops);
+    free(self->page_exact);
 
-    if (self->page_texts) {
-        for (i = 0; i < c; ++i) {
-            free(self->page_texts[i].texts);
-            free(self->page_texts[i].coords);
-        }
+    if (self->doc) {
+        /* Texts and links extracted by this view. */
+        mume_docdoc_lock(self->doc);
+        mume_pagecache_invalidate(
+            mume_docdoc_get_cache(self->doc), self);
 
-        free(self->page_texts);
-    }
+        /* Leave the document in its original pages. */
+        if (self->reflow_width)
+            mume_docdoc_reflow(self->doc, 0, 0);
 
-    if (self->page_links) {
-        for (i = 0; i < c; ++i)
-            mume_doclink_destroy(self->page_links[i]);
+        if (mume_test_flag(self->flags, _DOCVIEW_FLAG_FOLLOW))
+            mume_docdoc_follow(self->doc, NULL, 0);
 
-        free(self->page_links);
-    }
+        mume_docdoc_unlock(self->doc);
 
-    if (self->doc)
+        mume_renderq_cancel(self->renderq, self->doc);
+        mume_tilecache_invalidate(self->tiles, self->doc);
         mume_refobj_release(self->doc);
+    }
 
     _docview_reset(self);
 }
 
-static void _docview_update_page_rects(struct _docview *self)
+static void _docview_scale_page(struct _docview *self, int pageno)
 {
-    int i, c;
-    mume_rect_t *rect;
+    /* Pages are only scaled and turned by the zoom and rotation,
+     * so the measured size is kept for all of them. */
+    mume_rect_t r = self->page_sizes[pageno];
+    int w = r.width * self->zoom;
+    int h = r.height * self->zoom;
+
+    if (self->rotate % 180)
+        self->page_rects[pageno] = mume_rect_make(0, 0, h, w);
+    else
+        self->page_rects[pageno] = mume_rect_make(0, 0, w, h);
+}
+
+static void _docview_measure_page(struct _docview *self, int pageno)
+{
+    /* The doc must be locked by the caller. */
     mume_matrix_t ctm;
 
-    self->view_width = 0;
-    self->view_height = 0;
-    c = mume_docview_count_pages(self);
-    for (i = 0; i < c; ++i) {
-        rect = self->page_rects + i;
+    ctm = mume_docdoc_get_matrix(self->doc, pageno, 1, 0);
+    self->page_sizes[pageno] = mume_rect_transform(
+        mume_docdoc_get_mediabox(self->doc, pageno), ctm);
 
-        ctm = mume_docdoc_get_matrix(
-            self->doc, i, self->zoom, self->rotate);
-        *rect = mume_docdoc_get_mediabox(self->doc, i);
-        *rect = mume_rect_transform(*rect, ctm);
+    self->page_exact[pageno] = 1;
+    _docview_scale_page(self, pageno);
+}
+
+static void _docview_layout_pages(struct _docview *self, int first)
+{
+    /* Pages before <first> are kept in place. The view width only
+     * grows then, the pages before are not visited again. */
+    int i, c, bh;
+    mume_rect_t *rect;
 
-        rect->y += self->view_height;
+    if (0 == first) {
+        self->view_width = 0;
+        self->view_height = 0;
+    }
+    else {
+        rect = self->page_rects + first - 1;
+        self->view_height = rect->y + rect->height;
+    }
+
+    c = mume_docview_count_pages(self);
+    for (i = first; i < c; ++i) {
+        rect = self->page_rects + i;
+        rect->y = self->view_height;
         if (rect->width > self->view_width)
             self->view_width = rect->width;
 
         self->view_height = rect->y + rect->height;
     }
+
+    /* Prefix sums of the bordered page heights, with an extra
+     * entry for the bottom of the last page. */
+    bh = self->page_border.y + self->page_border.height;
+    for (i = first; i < c; ++i)
+        self->page_tops[i] = self->page_rects[i].y + bh * i;
+
+    if (self->page_tops)
+        self->page_tops[c] = self->view_height + bh * c;
+}
+
+static void _docview_update_page_rects(struct _docview *self, int first)
+{
+    /* Only the first page and the pages measured before have the
+     * exact size, the others are estimated with the size of the
+     * first page until they come into view. The pages before
+     * <first> are not changed. */
+    int i, c;
+
+    c = mume_docview_count_pages(self);
+    if (0 == c) {
+        _docview_layout_pages(self, 0);
+        return;
+    }
+
+    if (!self->page_exact[0]) {
+        mume_docdoc_lock(self->doc);
+        _docview_measure_page(self, 0);
+        mume_docdoc_unlock(self->doc);
+    }
+
+    for (i = first; i < c; ++i) {
+        if (self->page_exact[i])
+            _docview_scale_page(self, i);
+        else
+            self->page_rects[i] = self->page_rects[0];
+    }
+
+    _docview_layout_pages(self, first);
+}
+
+/* Binary search the page at <y> in view space (with border),
+ * pages before the first or after the last are clamped. */
+static int _docview_page_at(const struct _docview *self, int y)
+{
+    int low, high, mid;
+
+    low = 0;
+    high = mume_docview_count_pages(self) - 1;
+    while (low < high) {
+        mid = low + (high - low + 1) / 2;
+        if (self->page_tops[mid] <= y)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    return low;
 }
 
 static void _docview_get_view_size(
@@ -174,6 +298,263 @@ static void _docview_update_scroll_size(struct _docview *self)
     mume_scrollview_set_size(self, width, height);
 }
 
+static void _docview_nearby_pages(
+    const struct _docview *self, int *first, int *last)
+{
+    /* Pages around the client area, the same area as prefetching
+     * tiles. */
+    int sy, ch;
+
+    mume_scrollview_get_scroll(self, NULL, &sy);
+    mume_scrollview_get_client(self, NULL, NULL, NULL, &ch);
+    *first = _docview_page_at(self, sy - ch);
+    *last = _docview_page_at(self, sy + ch * 2);
+}
+
+static void _docview_post_measure(struct _docview *self)
+{
+    /* Measuring changes the layout and the scroll position, which
+     * is left to a notification posted to self, instead of being
+     * done while painting or scrolling. */
+    int i, last;
+
+    if (0 == mume_docview_count_pages(self) ||
+        mume_test_flag(self->flags, _DOCVIEW_FLAG_MEASURING))
+    {
+        return;
+    }
+
+    _docview_nearby_pages(self, &i, &last);
+    for (; i <= last; ++i) {
+        if (!self->page_exact[i]) {
+            mume_add_flag(self->flags, _DOCVIEW_FLAG_MEASURING);
+            mume_post_event(mume_make_notify_event(
+                self, self, MUME_DOCVIEW_MEASURED, NULL));
+            break;
+        }
+    }
+}
+
+static void _docview_measure_visible(struct _docview *self)
+{
+    /* Measure the estimated pages around the client area, and keep
+     * the first visible page at the same place if the layout is
+     * changed. */
+    int sx, sy, i, last, anchor, offset, changed;
+
+    if (0 == mume_docview_count_pages(self))
+        return;
+
+    for (;;) {
+        mume_scrollview_get_scroll(self, &sx, &sy);
+        _docview_nearby_pages(self, &i, &last);
+        changed = -1;
+
+        mume_docdoc_lock(self->doc);
+        for (; i <= last; ++i) {
+            if (!self->page_exact[i]) {
+                _docview_measure_page(self, i);
+                if (changed < 0)
+                    changed = i;
+            }
+        }
+
+        mume_docdoc_unlock(self->doc);
+
+        if (changed < 0)
+            break;
+
+        anchor = _docview_page_at(self, sy);
+        offset = sy - self->page_tops[anchor];
+
+        _docview_layout_pages(self, changed);
+        _docview_update_scroll_size(self);
+
+        offset = MIN(offset, self->page_tops[anchor + 1] -
+                     self->page_tops[anchor] - 1);
+
+        self->first_visible = -1;
+        mume_scrollview_set_scroll(
+            self, sx, self->page_tops[anchor] + MAX(offset, 0));
+
+        mume_invalidate_region(self, NULL);
+    }
+}
+
+static void _docview_update_page_count(struct _docview *self, int first)
+{
+    /* The pages measured are kept, the new ones are estimated.
+     * Only the pages from <first> are laid out again, and they are
+     * only repainted if they are in the client area, with the
+     * space of the pages removed. */
+    mume_rect_t rect;
+    int i, sy, cw, ch, width, c = mume_docview_count_pages(self);
+    int shrunk = c < self->page_count;
+
+    if (c != self->page_count) {
+        self->page_rects = realloc_abort(
+            self->page_rects, MAX(c, 1) * sizeof(mume_rect_t));
+
+        self->page_sizes = realloc_abort(
+            self->page_sizes, MAX(c, 1) * sizeof(mume_rect_t));
+
+        self->page_tops = realloc_abort(
+            self->page_tops, (c + 1) * sizeof(int));
+
+        self->page_exact = realloc_abort(
+            self->page_exact, MAX(c, 1) * sizeof(char));
+
+        for (i = self->page_count; i < c; ++i)
+            self->page_exact[i] = 0;
+
+        self->page_count = c;
+    }
+
+    first = MIN(first, c);
+    width = self->view_width;
+    _docview_update_page_rects(self, first);
+    _docview_update_scroll_size(self);
+
+    /* Pages are centered in the view width. */
+    if (0 == first || width != self->view_width) {
+        mume_invalidate_region(self, NULL);
+        return;
+    }
+
+    mume_scrollview_get_scroll(self, NULL, &sy);
+    mume_scrollview_get_client(self, NULL, NULL, &cw, &ch);
+    rect.x = 0;
+    rect.y = self->page_tops[first] - sy;
+    rect.width = cw;
+    if (shrunk)
+        rect.height = MAX(ch - rect.y, 0);
+    else
+        rect.height = self->page_tops[c] - self->page_tops[first];
+
+    rect = mume_rect_intersect(rect, mume_rect_make(0, 0, cw, ch));
+    if (!mume_rect_is_empty(rect))
+        mume_invalidate_rect(self, &rect);
+}
+
+static int _docview_get_reflow_width(const struct _docview *self)
+{
+    int w, h;
+
+    if (!mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+        return 0;
+
+    mume_scrollview_get_client(self, NULL, NULL, &w, &h);
+    if (self->rotate % 180)
+        w = h;
+
+    w -= self->page_border.x + self->page_border.width;
+    return MAX(w / self->zoom, 1);
+}
+
+static void _docview_reflow(struct _docview *self)
+{
+    /* Pages are paginated a few at a time, and the rest is left
+     * to a notification posted to self, so the pages shown first
+     * don't wait for the whole document. */
+    int i, width, more, first = self->page_count;
+
+    width = _docview_get_reflow_width(self);
+    if (width != self->reflow_width) {
+        mume_renderq_cancel(self->renderq, self->doc);
+        mume_tilecache_invalidate(self->tiles, self->doc);
+
+        mume_docdoc_lock(self->doc);
+        mume_pagecache_invalidate(
+            mume_docdoc_get_cache(self->doc), self);
+        mume_docdoc_unlock(self->doc);
+
+        for (i = 0; i < self->page_count; ++i)
+            self->page_exact[i] = 0;
+
+        first = 0;
+        self->reflow_width = width;
+        self->first_visible = -1;
+        self->sel_start_p = 0;
+        self->sel_start_i = 0;
+        self->sel_end_p = 0;
+        self->sel_end_i = 0;
+    }
+
+    mume_docdoc_lock(self->doc);
+    more = mume_docdoc_reflow(
+        self->doc, width, _DOCVIEW_REFLOW_PAGES);
+    mume_docdoc_unlock(self->doc);
+
+    /* The pages paginated before are kept. */
+    _docview_update_page_count(self, first);
+
+    if (more && !mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOWING)) {
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_REFLOWING);
+        mume_post_event(mume_make_notify_event(
+            self, self, MUME_DOCVIEW_REFLOWED, NULL));
+    }
+}
+
+static void _docview_scroll_to_tail(struct _docview *self)
+{
+    int sx, cy, ch;
+
+    mume_scrollview_get_scroll(self, &sx, NULL);
+    mume_scrollview_get_size(self, NULL, &cy);
+    mume_scrollview_get_client(self, NULL, NULL, NULL, &ch);
+    mume_scrollview_set_scroll(self, sx, MAX(cy - ch, 0));
+}
+
+static void _docview_follow(struct _docview *self)
+{
+    /* Read what is appended to the document. The view stays at
+     * the tail if it was there. */
+    int sy, cy, ch, tail, changed, i;
+    int c = 0, first = 0;
+
+    mume_scrollview_get_scroll(self, NULL, &sy);
+    mume_scrollview_get_size(self, NULL, &cy);
+    mume_scrollview_get_client(self, NULL, NULL, NULL, &ch);
+    tail = sy + ch >= cy;
+
+    mume_renderq_cancel(self->renderq, self->doc);
+
+    /* The previous last page and the new pages are extracted,
+     * measured and rendered again, all the pages if the document
+     * is shrunk. A reflowed document only keeps the pages before
+     * the one paginated again. */
+    mume_docdoc_lock(self->doc);
+    changed = mume_docdoc_update(self->doc);
+    if (changed) {
+        c = MIN(self->page_count, mume_docview_count_pages(self));
+        if (mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+            first = c;
+        else
+            first = c < self->page_count ? 0 : MAX(c - 1, 0);
+
+        mume_pagecache_invalidate_from(
+            mume_docdoc_get_cache(self->doc), self, first);
+    }
+
+    mume_docdoc_unlock(self->doc);
+
+    if (!changed)
+        return;
+
+    mume_tilecache_invalidate_from(self->tiles, self->doc, first);
+    self->first_visible = -1;
+
+    for (i = first; i < c; ++i)
+        self->page_exact[i] = 0;
+
+    _docview_update_page_count(self, first);
+    if (mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+        _docview_reflow(self);
+
+    if (tail)
+        _docview_scroll_to_tail(self);
+}
+
 static mume_rect_t _docview_get_page_rect(
     const struct _docview *self, int pageno, int border)
 {
@@ -197,33 +578,97 @@ static mume_rect_t _docview_get_page_rect(
     return r;
 }
 
+static void _page_text_destroy(void *data)
+{
+    _page_text_t *text = data;
+
+    if (text->index)
+        mume_glyphidx_delete(text->index);
+
+    free(text->texts);
+    free(text->coords);
+    free(text);
+}
+
+static void _page_links_destroy(void *data)
+{
+    mume_doclink_destroy(data);
+}
+
+static void _docview_trim_cache(struct _docview *self)
+{
+    /* Must be called when no texts or links are in use, for they
+     * are not valid after the cache is trimmed. */
+    if (self->doc) {
+        mume_docdoc_lock(self->doc);
+        mume_pagecache_trim(mume_docdoc_get_cache(self->doc), NULL);
+        mume_docdoc_unlock(self->doc);
+    }
+}
+
+/* The data of this view is trimmed before the new data is cached,
+ * so the texts and links got before are not valid after getting
+ * another one. */
 static _page_text_t* _docview_get_page_text(
     const struct _docview *self, int pageno)
 {
-    _page_text_t *r = self->page_texts + pageno;
-    if (-1 == r->length) {
-        r->length = mume_docdoc_text_length(self->doc, pageno);
-        if (r->length > 0) {
-            r->texts = malloc_abort(r->length * sizeof(*(r->texts)));
-            r->coords = malloc_abort(r->length * sizeof(*(r->coords)));
+    mume_pagecache_t *cache = mume_docdoc_get_cache(self->doc);
+    _page_text_t *r;
+    size_t size;
+
+    mume_docdoc_lock(self->doc);
+    if (!mume_pagecache_find(
+            cache, self, _DOCVIEW_CACHE_TEXT, pageno, (void**)&r))
+    {
+        r = malloc_struct(_page_text_t);
+        r->index = NULL;
+        r->length = mume_docdoc_get_text(
+            self->doc, pageno, &r->texts, &r->coords);
+        size = sizeof(_page_text_t);
 
-            mume_docdoc_extract_text(
-                self->doc, pageno, r->texts, r->coords);
+        if (r->length > 0) {
+            r->index = mume_glyphidx_new(r->coords, r->length);
+            size += r->length * (sizeof(*(r->texts)) +
+                                 sizeof(*(r->coords)));
+            size += mume_glyphidx_size(r->index);
         }
+
+        mume_pagecache_trim(cache, self);
+        mume_pagecache_insert(
+            cache, self, _DOCVIEW_CACHE_TEXT, pageno,
+            r, size, _page_text_destroy);
     }
 
+    mume_docdoc_unlock(self->doc);
     return r;
 }
 
 static mume_doclink_t* _docview_get_page_links(
     const struct _docview *self, int pageno)
 {
-    if (NULL == self->page_links[pageno]) {
-        self->page_links[pageno] =
-                mume_docdoc_get_page_links(self->doc, pageno);
+    mume_pagecache_t *cache = mume_docdoc_get_cache(self->doc);
+    mume_doclink_t *r, *link;
+    size_t size = 0;
+
+    mume_docdoc_lock(self->doc);
+    if (!mume_pagecache_find(
+            cache, self, _DOCVIEW_CACHE_LINKS, pageno, (void**)&r))
+    {
+        r = mume_docdoc_get_page_links(self->doc, pageno);
+        for (link = r; link; link = link->next) {
+            size += sizeof(mume_doclink_t);
+            if (link->dest_value)
+                size += strlen(link->dest_value) + 1;
+        }
+
+        mume_pagecache_trim(cache, self);
+        mume_pagecache_insert(
+            cache, self, _DOCVIEW_CACHE_LINKS, pageno,
+            r, size, _page_links_destroy);
     }
 
-    return self->page_links[pageno];
+    mume_docdoc_unlock(self->doc);
+    return r;
 }
 
 static int _docview_find_closest_glyph(
@@ -233,8 +678,7 @@ static int _docview_find_closest_glyph(
     mume_rect_t rect;
     mume_matrix_t ctm;
     mume_point_t pt;
-    int i, result = -1;
-    int dist, maxdist = -1;
+    int result = -1;
 
     ctm = mume_docdoc_get_matrix(
         self->doc, pageno, self->zoom, self->rotate);
@@ -245,15 +689,8 @@ static int _docview_find_closest_glyph(
     pt = mume_point_transform(pt, ctm);
 
     text = _docview_get_page_text(self, pageno);
-    for (i = 0; i < text->length; ++i) {
-        rect = text->coords[i];
-        dist = hypot(pt.x - rect.x - rect.width / 2,
-                     pt.y - rect.y - rect.height / 2);
-        if (maxdist < 0 || dist < maxdist) {
-            maxdist = dist;
-            result = i;
-        }
-    }
+    if (text->index)
+        result = mume_glyphidx_closest(text->index, pt.x, pt.y);
 
     if (inside) {
         if (result != -1) {
@@ -387,8 +824,8 @@ static void _docview_get_page_sel(
     _page_text_t *text;
     int head_p, head_i, tail_p, tail_i;
 
-    text = _docview_get_page_text(self, pageno);
     _docview_get_sel_range(self, &head_p, &head_i, &tail_p, &tail_i);
+    text = _docview_get_page_text(self, pageno);
 
     if (pageno == head_p) {
         if (head_p != tail_p) {
@@ -416,19 +853,44 @@ static void _docview_get_page_sel(
 }
 
 static cairo_region_t* _docview_create_sel_region(
-    struct _docview *self, int pageno, int sel_begin, int sel_end)
+    struct _docview *self, int pageno, int sel_begin, int sel_end,
+    const mume_rect_t *clip)
 {
+    /* Only the lines that intersect with <clip> (in page space)
+     * are included if it is not NULL. */
     _page_text_t *text;
     mume_rect_t ra, rc;
     cairo_region_t *rgn;
     mume_matrix_t ctm;
-    int i;
+    int i, begin, end;
 
     text = _docview_get_page_text(self, pageno);
     rgn = cairo_region_create();
     ctm = mume_docdoc_get_matrix(
         self->doc, pageno, self->zoom, self->rotate);
 
+    if (clip && text->index) {
+        rc = mume_rect_transform(*clip, mume_matrix_invert(ctm));
+        if (!mume_glyphidx_range(text->index, rc, &begin, &end))
+            return rgn;
+
+        /* Extend to the whole lines, so the lines are merged
+         * the same as without clipping. */
+        begin = MAX(begin, sel_begin);
+        end = MIN(end, sel_end);
+        if (begin >= end)
+            return rgn;
+
+        while (begin > sel_begin && text->texts[begin - 1] != '\n')
+            --begin;
+
+        while (end < sel_end && text->texts[end - 1] != '\n')
+            ++end;
+
+        sel_begin = begin;
+        sel_end = end;
+    }
+
     ra = mume_rect_empty;
     for (i = sel_begin; i < sel_end; ++i) {
         rc = text->coords[i];
@@ -543,7 +1005,10 @@ static void _docview_select_to(
             mume_docview_page_to_client(self, i, &dx, &dy);
 
             _docview_get_page_sel(self, i, &begin, &end);
-            rgn1 = _docview_create_sel_region(self, i, begin, end);
+            rect = mume_rect_make(
+                -dx, -dy, mume_window_width(self), height);
+            rgn1 = _docview_create_sel_region(
+                self, i, begin, end, &rect);
             cairo_region_translate(rgn1, dx, dy);
             cairo_region_union(rgn0, rgn1);
             cairo_region_destroy(rgn1);
@@ -601,6 +1066,12 @@ static void* _docview_ctor(
         return NULL;
 
     mume_scrollview_set_line(self, 64, 64);
+    /* Pages are drawn relative to the scroll position. */
+    mume_scrollview_set_blit(self, 1);
+
+    self->tiles = mume_tilecache_new(MUME_TILECACHE_DEFAULT_BUDGET);
+    self->renderq = mume_renderq_new(
+        self, MUME_DOCVIEW_RENDERED, _DOCVIEW_RENDER_THREADS);
 
     _docview_reset(self);
     return self;
@@ -608,7 +1079,10 @@ static void* _docview_ctor(
 
 static void* _docview_dtor(struct _docview *self)
 {
+    /* Cancels the document's jobs in the render queue. */
     _docview_clear(self);
+    mume_renderq_delete(self->renderq);
+    mume_tilecache_delete(self->tiles);
     return _mume_dtor(_docview_super_class(), self);
 }
 
@@ -770,6 +1244,210 @@ static void _docview_handle_mouse_leave(
     }
 }
 
+static void _docview_schedule_tiles(struct _docview *self)
+{
+    /* Queue the missing tiles of the visible area, and those of one
+     * client height above and below it for prefetching. Documents
+     * that must be rendered on the GUI thread have only the tiles
+     * of the visible area rendered at once. */
+    const int ts = MUME_TILECACHE_TILE_SIZE;
+    mume_tilekey_t key;
+    mume_matrix_t ctm;
+    mume_rect_t area, page, rect, tile;
+    cairo_surface_t *surface;
+    int sx, sy, cw, ch, i, c, col, row, async, prefetch;
+
+    if (NULL == self->doc)
+        return;
+
+    async = mume_docdoc_render_async(self->doc);
+    mume_renderq_cancel(self->renderq, self->doc);
+
+    mume_scrollview_get_scroll(self, &sx, &sy);
+    mume_scrollview_get_client(self, NULL, NULL, &cw, &ch);
+    area = mume_rect_make(sx, sy - ch, cw, ch * 3);
+
+    c = mume_docview_count_pages(self);
+    i = MAX(mume_docview_first_visible(self) - 1, 0);
+    for (; i < c; ++i) {
+        page = _docview_get_page_rect(self, i, 0);
+        if (page.y >= area.y + area.height)
+            break;
+
+        /* Tiles are clipped to the page, so the estimated pages
+         * wait for being measured. */
+        rect = mume_rect_intersect(page, area);
+        if (mume_rect_is_empty(rect) || !self->page_exact[i])
+            continue;
+
+        rect = mume_rect_translate(rect, -page.x, -page.y);
+        mume_docdoc_lock(self->doc);
+        ctm = mume_docdoc_get_matrix(
+            self->doc, i, self->zoom, self->rotate);
+        mume_docdoc_unlock(self->doc);
+
+        for (row = rect.y / ts;
+             row <= (rect.y + rect.height - 1) / ts; ++row)
+        {
+            for (col = rect.x / ts;
+                 col <= (rect.x + rect.width - 1) / ts; ++col)
+            {
+                key = mume_tilekey_make(
+                    self->doc, i, self->zoom, self->rotate, col, row);
+
+                if (mume_tilecache_find(self->tiles, &key))
+                    continue;
+
+                tile = mume_rect_make(col * ts, row * ts, ts, ts);
+                tile = mume_rect_intersect(
+                    tile, mume_rect_make(0, 0, page.width, page.height));
+
+                /* Tiles in the client area come first. */
+                prefetch = (page.y + tile.y + tile.height <= sy ||
+                            page.y + tile.y >= sy + ch);
+
+                if (async) {
+                    mume_renderq_submit(
+                        self->renderq, &key, ctm, tile, prefetch);
+                }
+                else if (!prefetch) {
+                    surface = mume_renderq_render(&key, ctm, tile);
+                    if (surface) {
+                        mume_tilecache_insert(self->tiles, &key, surface);
+                        cairo_surface_destroy(surface);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void _docview_draw_page(
+    struct _docview *self, cairo_t *cr,
+    int x, int y, int pageno, mume_rect_t rect)
+{
+    /* Draw the <rect> part of the page (in page space) at the
+     * client position (x, y), tiles not rendered yet are left
+     * blank until the render queue finishes them. */
+    const int ts = MUME_TILECACHE_TILE_SIZE;
+    mume_tilekey_t key;
+    mume_rect_t page, tile, r;
+    cairo_surface_t *surface;
+    int col, row, c0, c1, r0, r1;
+
+    if (rect.width <= 0 || rect.height <= 0)
+        return;
+
+    page = self->page_rects[pageno];
+    page = mume_rect_make(0, 0, page.width, page.height);
+
+    c0 = rect.x / ts;
+    c1 = (rect.x + rect.width - 1) / ts;
+    r0 = rect.y / ts;
+    r1 = (rect.y + rect.height - 1) / ts;
+
+    for (row = r0; row <= r1; ++row) {
+        for (col = c0; col <= c1; ++col) {
+            tile = mume_rect_make(col * ts, row * ts, ts, ts);
+            tile = mume_rect_intersect(tile, page);
+            if (mume_rect_is_empty(tile))
+                continue;
+
+            key = mume_tilekey_make(
+                self->doc, pageno, self->zoom, self->rotate, col, row);
+
+            r = mume_rect_intersect(tile, rect);
+            cairo_rectangle(
+                cr, x + r.x - rect.x, y + r.y - rect.y, r.width, r.height);
+
+            surface = mume_tilecache_find(self->tiles, &key);
+            if (surface) {
+                cairo_set_source_surface(
+                    cr, surface, x + tile.x - rect.x, y + tile.y - rect.y);
+            }
+            else {
+                cairo_set_source_rgb(cr, 1, 1, 1);
+            }
+
+            cairo_fill(cr);
+        }
+    }
+}
+
+static void _docview_handle_rendered(struct _docview *self)
+{
+    mume_renderjob_t job;
+    mume_rect_t rect;
+    int sx, sy;
+
+    mume_scrollview_get_scroll(self, &sx, &sy);
+    while (mume_renderq_pop(self->renderq, &job)) {
+        if (NULL == job.surface)
+            continue;
+
+        /* Drop the outdated results. */
+        if (job.key.doc == self->doc && job.key.zoom == self->zoom &&
+            job.key.rotate == self->rotate)
+        {
+            mume_tilecache_insert(self->tiles, &job.key, job.surface);
+
+            rect = _docview_get_page_rect(self, job.key.pageno, 0);
+            rect = mume_rect_translate(
+                job.rect, rect.x - sx, rect.y - sy);
+            mume_invalidate_rect(self, &rect);
+        }
+
+        cairo_surface_destroy(job.surface);
+    }
+}
+
+static void _docview_handle_loading(struct _docview *self)
+{
+    void *doc;
+    int progress;
+
+    /* Events of a load cancelled are ignored. */
+    if (self->loading < 0)
+        return;
+
+    switch (mume_docmgr_poll_load(mume_docmgr(), self, &progress)) {
+    case MUME_DOCLOAD_RUNNING:
+        if (progress != self->loading) {
+            self->loading = progress;
+            mume_invalidate_region(self, NULL);
+        }
+        break;
+
+    case MUME_DOCLOAD_FINISHED:
+        doc = mume_docmgr_finish_load(mume_docmgr(), self);
+        self->loading = -1;
+
+        if (doc)
+            mume_docview_set_doc(self, doc);
+        else
+            mume_invalidate_region(self, NULL);
+        break;
+    }
+}
+
+/* Draw a progress bar in the middle of <rect> as the placeholder
+ * of the document loading. */
+static void _docview_draw_loading(
+    struct _docview *self, cairo_t *cr,
+    struct _docview_theme *thm, mume_rect_t rect)
+{
+    int width = rect.width / 2;
+    int height = 6;
+    int x = rect.x + (rect.width - width) / 2;
+    int y = rect.y + (rect.height - height) / 2;
+
+    mume_draw_resobj_brush(
+        cr, &thm->pagebg, x - 1, y - 1, width + 2, height + 2);
+
+    mume_draw_resobj_brush(
+        cr, &thm->selbg, x, y, width * self->loading / 100, height);
+}
+
 static void _docview_handle_expose(
     struct _docview *self, int x, int y, int w, int h, int count)
 {
@@ -777,7 +1455,6 @@ static void _docview_handle_expose(
     struct _docview_theme *thm;
     int sx, sy, i;
     mume_rect_t rr, r0, r1, r2;
-    mume_matrix_t m;
     cairo_region_t *c0, *c1;
     int sel_begin, sel_end;
     cairo_region_t *sel_rgn;
@@ -794,6 +1471,9 @@ static void _docview_handle_expose(
         return;
     }
 
+    _docview_trim_cache(self);
+    _docview_post_measure(self);
+
     cr = mume_window_begin_paint(self, MUME_PM_INVALID);
     if (NULL == cr) {
         mume_warning(("Docview begin paint failed\n"));
@@ -810,6 +1490,7 @@ static void _docview_handle_expose(
     c0 = cairo_region_create_rectangle(&r0);
 
     /* Pages. */
+    _docview_schedule_tiles(self);
     mume_scrollview_get_scroll(self, &sx, &sy);
     count = mume_docview_count_pages(self);
     for (i = mume_docview_first_visible(self); i < count; ++i) {
@@ -841,10 +1522,7 @@ static void _docview_handle_expose(
         x = r2.x;
         y = r2.y;
         mume_docview_client_to_page(self, i, &r2.x, &r2.y);
-
-        m = mume_docdoc_get_matrix(
-            self->doc, i, self->zoom, self->rotate);
-        mume_docdoc_render_page(self->doc, cr, x, y, i, m, r2);
+        _docview_draw_page(self, cr, x, y, i, r2);
 
 #ifdef DOCVIEW_DEBUG
         {
@@ -878,7 +1556,7 @@ static void _docview_handle_expose(
             cairo_operator_t oo;
 
             sel_rgn = _docview_create_sel_region(
-                self, i, sel_begin, sel_end);
+                self, i, sel_begin, sel_end, &r2);
             mume_docview_page_to_client(self, i, &tx, &ty);
             cairo_region_translate(sel_rgn, tx, ty);
 
@@ -906,6 +1584,9 @@ static void _docview_handle_expose(
     mume_draw_resobj_brush(
         cr, &thm->bkgnd, r0.x, r0.y, r0.width, r0.height);
 
+    if (self->loading >= 0)
+        _docview_draw_loading(self, cr, thm, r0);
+
     mume_window_end_paint(self, cr);
 }
 
@@ -936,10 +1617,43 @@ static void _docview_handle_command(
     }
 }
 
+static void _docview_handle_resize(
+    struct _docview *self, void *window, int w, int h, int ow, int oh)
+{
+    _mume_window_handle_resize(
+        _docview_super_class(), self, window, w, h, ow, oh);
+
+    if (self == window && self->doc &&
+        mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+    {
+        _docview_reflow(self);
+    }
+}
+
 static void _docview_handle_notify(
     struct _docview *self, void *window, int code, void *data)
 {
-    if (self == window && MUME_SCROLLVIEW_SCROLL == code) {
+    if (self == window && MUME_DOCVIEW_RENDERED == code) {
+        _docview_handle_rendered(self);
+    }
+    else if (self == window && MUME_DOCVIEW_MEASURED == code) {
+        mume_remove_flag(self->flags, _DOCVIEW_FLAG_MEASURING);
+        if (self->doc)
+            _docview_measure_visible(self);
+    }
+    else if (self == window && MUME_DOCVIEW_REFLOWED == code) {
+        mume_remove_flag(self->flags, _DOCVIEW_FLAG_REFLOWING);
+        if (self->doc)
+            _docview_reflow(self);
+    }
+    else if (self == window && MUME_DOCVIEW_MODIFIED == code) {
+        if (self->doc)
+            _docview_follow(self);
+    }
+    else if (self == window && MUME_DOCVIEW_LOADING == code) {
+        _docview_handle_loading(self);
+    }
+    else if (self == window && MUME_SCROLLVIEW_SCROLL == code) {
         const mume_point_t *pt = data;
         int sy;
 
@@ -947,6 +1661,7 @@ static void _docview_handle_notify(
         if (pt->y != sy) {
             /* Recalculate the first visible page. */
             self->first_visible = -1;
+            _docview_post_measure(self);
         }
     }
 }
@@ -978,6 +1693,8 @@ const void* mume_docview_class(void)
         _docview_handle_mouse_leave,
         _mume_window_handle_expose,
         _docview_handle_expose,
+        _mume_window_handle_resize,
+        _docview_handle_resize,
         _mume_window_handle_command,
         _docview_handle_command,
         _mume_window_handle_notify,
@@ -1007,47 +1724,83 @@ void* mume_docview_new(void *parent, int x, int y, int w, int h)
 void mume_docview_set_doc(void *_self, void *doc)
 {
     struct _docview *self = _self;
-    int i, page_count;
+    int flags;
 
     assert(mume_is_of(_self, mume_docview_class()));
     assert(!doc || mume_is_of(doc, mume_docdoc_class()));
 
+    /* The reflow and follow modes, and the flags of the posted
+     * notifications, are kept for the new document. */
+    flags = self->flags;
     _docview_clear(self);
 
+    if (mume_test_flag(flags, _DOCVIEW_FLAG_REFLOW))
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_REFLOW);
+
+    if (mume_test_flag(flags, _DOCVIEW_FLAG_REFLOWING))
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_REFLOWING);
+
+    if (mume_test_flag(flags, _DOCVIEW_FLAG_FOLLOW))
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_FOLLOW);
+
+    if (mume_test_flag(flags, _DOCVIEW_FLAG_MEASURING))
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_MEASURING);
+
     self->doc = doc;
     if (NULL == self->doc)
         return;
 
     mume_refobj_addref(doc);
 
-    page_count = mume_docview_count_pages(self);
+    if (mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+        _docview_reflow(self);
+    else
+        _docview_update_page_count(self, 0);
 
-    self->page_rects = malloc_abort(
-        page_count * sizeof(mume_rect_t));
+    if (mume_test_flag(self->flags, _DOCVIEW_FLAG_FOLLOW)) {
+        int follow;
 
-    self->page_texts = malloc_abort(
-        page_count * sizeof(_page_text_t));
+        mume_docdoc_lock(self->doc);
+        follow = mume_docdoc_follow(
+            self->doc, self, MUME_DOCVIEW_MODIFIED);
+        mume_docdoc_unlock(self->doc);
 
-    self->page_links = malloc_abort(
-        page_count * sizeof(mume_doclink_t*));
+        /* Such as a document not of a local file. */
+        if (!follow)
+            mume_remove_flag(self->flags, _DOCVIEW_FLAG_FOLLOW);
+    }
+}
 
-    for (i = 0; i < page_count; ++i) {
-        self->page_texts[i].texts = NULL;
-        self->page_texts[i].coords = NULL;
-        self->page_texts[i].length = -1;
-        self->page_links[i] = NULL;
+void* mume_docview_get_doc(const void *_self)
+{
+    const struct _docview *self = _self;
+    assert(mume_is_of(_self, mume_docview_class()));
+    return self->doc;
+}
+
+int mume_docview_load_file(void *_self, const char *file)
+{
+    struct _docview *self = _self;
+
+    assert(mume_is_of(_self, mume_docview_class()));
+
+    mume_docview_set_doc(self, NULL);
+    if (!mume_docmgr_load_file_async(
+            mume_docmgr(), file, self, MUME_DOCVIEW_LOADING))
+    {
+        return 0;
     }
 
-    _docview_update_page_rects(self);
-    _docview_update_scroll_size(self);
+    self->loading = 0;
     mume_invalidate_region(self, NULL);
+    return 1;
 }
 
-void* mume_docview_get_doc(const void *_self)
+int mume_docview_get_loading(const void *_self)
 {
     const struct _docview *self = _self;
     assert(mume_is_of(_self, mume_docview_class()));
-    return self->doc;
+    return self->loading;
 }
 
 int mume_docview_count_pages(const void *_self)
@@ -1065,8 +1818,7 @@ int mume_docview_count_pages(const void *_self)
 int mume_docview_first_visible(const void *_self)
 {
     struct _docview *self = (struct _docview*)_self;
-    int y, i, c;
-    mume_rect_t rect;
+    int y;
 
     assert(mume_is_of(_self, mume_docview_class()));
 
@@ -1074,16 +1826,9 @@ int mume_docview_first_visible(const void *_self)
         return self->first_visible;
 
     self->first_visible = 0;
-    c = mume_docview_count_pages(self);
-    mume_scrollview_get_scroll(self, NULL, &y);
-
-    for (i = 0; i < c; ++i) {
-        rect = _docview_get_page_rect(self, i, 1);
-
-        if (y >= rect.y && y < rect.y + rect.height) {
-            self->first_visible = i;
-            break;
-        }
+    if (mume_docview_count_pages(self) > 0) {
+        mume_scrollview_get_scroll(self, NULL, &y);
+        self->first_visible = _docview_page_at(self, y);
     }
 
     return self->first_visible;
@@ -1092,24 +1837,15 @@ int mume_docview_first_visible(const void *_self)
 int mume_docview_page_from(const void *_self, int y)
 {
     const struct _docview *self = _self;
-    int sy, i, c;
-    mume_rect_t rect = {0, 0, 0, 0};
-
-    c = mume_docview_count_pages(self);
-    mume_scrollview_get_scroll(self, NULL, &sy);
-    sy += y;
-
-    for (i = mume_docview_first_visible(self); i < c; ++i) {
-        rect = _docview_get_page_rect(self, i, 1);
+    int sy;
 
-        if (sy >= rect.y && sy < rect.y + rect.height)
-            return i;
+    assert(mume_is_of(_self, mume_docview_class()));
 
-        if (rect.y > sy)
-            break;
-    }
+    if (0 == mume_docview_count_pages(self))
+        return -1;
 
-    return sy < rect.y ? 0 : c - 1;
+    mume_scrollview_get_scroll(self, NULL, &sy);
+    return _docview_page_at(self, sy + y);
 }
 
 void mume_docview_client_to_page(
@@ -1154,11 +1890,16 @@ void mume_docview_set_zoom(void *_self, float zoom)
         zoom = _DOCVIEW_ZOOM_MAX;
 
     if (fabsf(zoom - self->zoom) > FLT_EPSILON) {
+        mume_renderq_cancel(self->renderq, self->doc);
+        mume_tilecache_invalidate(self->tiles, self->doc);
         self->zoom = zoom;
         self->first_visible = -1;
-        _docview_update_page_rects(self);
+        _docview_update_page_rects(self, 0);
         _docview_update_scroll_size(self);
         mume_invalidate_region(self, NULL);
+
+        if (self->doc && mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+            _docview_reflow(self);
     }
 }
 
@@ -1202,11 +1943,16 @@ void mume_docview_set_rotate(void *_self, int rotate)
         rotate += 360;
 
     if (self->rotate != rotate) {
+        mume_renderq_cancel(self->renderq, self->doc);
+        mume_tilecache_invalidate(self->tiles, self->doc);
         self->rotate = rotate;
         self->first_visible = -1;
-        _docview_update_page_rects(self);
+        _docview_update_page_rects(self, 0);
         _docview_update_scroll_size(self);
         mume_invalidate_region(self, NULL);
+
+        if (self->doc && mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+            _docview_reflow(self);
     }
 }
 
@@ -1245,6 +1991,84 @@ void mume_docview_rotate_by(void *self, int rotate)
     }
 }
 
+void mume_docview_set_reflow(void *_self, int reflow)
+{
+    struct _docview *self = _self;
+
+    assert(mume_is_of(_self, mume_docview_class()));
+
+    if (!reflow == !mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW))
+        return;
+
+    if (reflow)
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_REFLOW);
+    else
+        mume_remove_flag(self->flags, _DOCVIEW_FLAG_REFLOW);
+
+    if (self->doc)
+        _docview_reflow(self);
+}
+
+int mume_docview_get_reflow(const void *_self)
+{
+    const struct _docview *self = _self;
+    assert(mume_is_of(_self, mume_docview_class()));
+    return mume_test_flag(self->flags, _DOCVIEW_FLAG_REFLOW) != 0;
+}
+
+void mume_docview_set_follow(void *_self, int follow)
+{
+    struct _docview *self = _self;
+
+    assert(mume_is_of(_self, mume_docview_class()));
+
+    if (!follow == !mume_test_flag(self->flags, _DOCVIEW_FLAG_FOLLOW))
+        return;
+
+    if (follow)
+        mume_add_flag(self->flags, _DOCVIEW_FLAG_FOLLOW);
+    else
+        mume_remove_flag(self->flags, _DOCVIEW_FLAG_FOLLOW);
+
+    if (NULL == self->doc)
+        return;
+
+    mume_docdoc_lock(self->doc);
+    follow = mume_docdoc_follow(
+        self->doc, follow ? self : NULL, MUME_DOCVIEW_MODIFIED) && follow;
+    mume_docdoc_unlock(self->doc);
+
+    if (!follow) {
+        mume_remove_flag(self->flags, _DOCVIEW_FLAG_FOLLOW);
+    }
+    else {
+        /* Catch up with the data appended before. */
+        _docview_follow(self);
+        _docview_scroll_to_tail(self);
+    }
+}
+
+int mume_docview_get_follow(const void *_self)
+{
+    const struct _docview *self = _self;
+    assert(mume_is_of(_self, mume_docview_class()));
+    return mume_test_flag(self->flags, _DOCVIEW_FLAG_FOLLOW) != 0;
+}
+
+void mume_docview_set_cache_size(void *_self, size_t size)
+{
+    struct _docview *self = _self;
+    assert(mume_is_of(_self, mume_docview_class()));
+    mume_tilecache_set_budget(self->tiles, size);
+}
+
+size_t mume_docview_get_cache_size(const void *_self)
+{
+    const struct _docview *self = _self;
+    assert(mume_is_of(_self, mume_docview_class()));
+    return mume_tilecache_get_budget(self->tiles);
+}
+
 mume_type_t* mume_typeof_docview_theme(void)
 {
     static void *tp;
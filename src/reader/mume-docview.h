@@ -23,11 +23,20 @@
 MUME_BEGIN_DECLS
 
 #define MUME_SIZEOF_DOCVIEW (MUME_SIZEOF_SCROLLVIEW +   \
-                             sizeof(void*) * 4 +        \
-                             sizeof(int) * 14)
+                             sizeof(void*) * 7 +        \
+                             sizeof(int) * 17)
 
 #define MUME_SIZEOF_DOCVIEW_CLASS (MUME_SIZEOF_SCROLLVIEW_CLASS)
 
+enum mume_docview_notify_e {
+    MUME_DOCVIEW_RENDERED = MUME_SCROLLVIEW_NOTIFY_LAST,
+    MUME_DOCVIEW_REFLOWED,
+    MUME_DOCVIEW_MODIFIED,
+    MUME_DOCVIEW_LOADING,
+    MUME_DOCVIEW_MEASURED,
+    MUME_DOCVIEW_NOTIFY_LAST
+};
+
 murdr_public const void* mume_docview_class(void);
 
 murdr_public const void* mume_docview_meta_class(void);
@@ -39,6 +48,15 @@ murdr_public void mume_docview_set_doc(void *self, void *doc);
 
 murdr_public void* mume_docview_get_doc(const void *self);
 
+/* Load the document of <file> in the background and show it when
+ * it's loaded, the progress is shown meanwhile. Return zero if the
+ * load can't be started. */
+murdr_public int mume_docview_load_file(void *self, const char *file);
+
+/* Progress in percent of the document loading, or -1 if the view
+ * isn't loading a document. */
+murdr_public int mume_docview_get_loading(const void *self);
+
 murdr_public int mume_docview_count_pages(const void *self);
 
 murdr_public int mume_docview_first_visible(const void *self);
@@ -64,6 +82,28 @@ murdr_public int mume_docview_get_rotate(const void *self);
 
 murdr_public void mume_docview_rotate_by(void *self, int rotate);
 
+/* Reflow the pages to the view width if the document can, the
+ * pages are paginated in the background as idle work. The
+ * pagination belongs to the document, so a document reflowed in
+ * a view must not be shown in other views at the same time. */
+murdr_public void mume_docview_set_reflow(void *self, int reflow);
+
+murdr_public int mume_docview_get_reflow(const void *self);
+
+/* Follow the growth of the document's file, such as a log file
+ * being written. The appended data is read without reading the
+ * document again, and the view scrolls with the tail when it's
+ * at the tail. The mode is turned off if the document set can't
+ * be followed, such as one not of a local file. */
+murdr_public void mume_docview_set_follow(void *self, int follow);
+
+murdr_public int mume_docview_get_follow(const void *self);
+
+/* Set the memory budget in bytes of the rendered page tiles. */
+murdr_public void mume_docview_set_cache_size(void *self, size_t size);
+
+murdr_public size_t mume_docview_get_cache_size(const void *self);
+
 murdr_public mume_type_t* mume_typeof_docview_theme(void);
 
 MUME_END_DECLS
@@ -0,0 +1,272 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-glyphidx.h"
+#include MUME_MATH_H
+
+/* Average number of glyphs in each cell. */
+#define _GLYPHIDX_CELL_GLYPHS 4
+
+#define _glyph_center_x(_r) ((_r).x + (_r).width / 2)
+#define _glyph_center_y(_r) ((_r).y + (_r).height / 2)
+
+static int _glyphidx_col(const mume_glyphidx_t *self, int x)
+{
+    int col = (x - self->bound.x) / self->cell_width;
+
+    if (x < self->bound.x || col < 0)
+        return 0;
+
+    return MIN(col, self->cols - 1);
+}
+
+static int _glyphidx_row(const mume_glyphidx_t *self, int y)
+{
+    int row = (y - self->bound.y) / self->cell_height;
+
+    if (y < self->bound.y || row < 0)
+        return 0;
+
+    return MIN(row, self->rows - 1);
+}
+
+static int _glyphidx_cell(const mume_glyphidx_t *self, int i)
+{
+    mume_rect_t r = self->coords[i];
+
+    return _glyphidx_row(self, _glyph_center_y(r)) * self->cols +
+           _glyphidx_col(self, _glyph_center_x(r));
+}
+
+static void _glyphidx_visit(
+    const mume_glyphidx_t *self, int col, int row,
+    int x, int y, int *result, double *dist)
+{
+    int i, g, cell;
+    double dx, dy, d;
+
+    cell = row * self->cols + col;
+    for (i = self->cells[cell]; i < self->cells[cell + 1]; ++i) {
+        g = self->glyphs[i];
+        dx = x - _glyph_center_x(self->coords[g]);
+        dy = y - _glyph_center_y(self->coords[g]);
+        d = dx * dx + dy * dy;
+
+        if (-1 == *result || d < *dist || (d == *dist && g < *result)) {
+            *result = g;
+            *dist = d;
+        }
+    }
+}
+
+/* Lower bound of the distance from (x, y) to the glyphs out of
+ * the cells within <ring> around (col, row), or -1 if there is
+ * no cell out of them. */
+static double _glyphidx_ring_bound(
+    const mume_glyphidx_t *self, int col, int row,
+    int ring, int x, int y)
+{
+    double d, result = -1;
+
+    if (col - ring > 0) {
+        d = x - (self->bound.x + (col - ring) * self->cell_width);
+        d = MAX(d, 0);
+        result = d;
+    }
+
+    if (col + ring < self->cols - 1) {
+        d = self->bound.x + (col + ring + 1) * self->cell_width - x;
+        d = MAX(d, 0);
+        result = result < 0 ? d : MIN(result, d);
+    }
+
+    if (row - ring > 0) {
+        d = y - (self->bound.y + (row - ring) * self->cell_height);
+        d = MAX(d, 0);
+        result = result < 0 ? d : MIN(result, d);
+    }
+
+    if (row + ring < self->rows - 1) {
+        d = self->bound.y + (row + ring + 1) * self->cell_height - y;
+        d = MAX(d, 0);
+        result = result < 0 ? d : MIN(result, d);
+    }
+
+    return result;
+}
+
+mume_glyphidx_t* mume_glyphidx_ctor(
+    mume_glyphidx_t *self, const mume_rect_t *coords, int count)
+{
+    int i, x0, y0, x1, y1, cell, target;
+
+    self->coords = coords;
+    self->count = count;
+    self->bound = mume_rect_empty;
+    self->cell_width = 1;
+    self->cell_height = 1;
+    self->cols = 0;
+    self->rows = 0;
+    self->max_width = 0;
+    self->max_height = 0;
+    self->cells = NULL;
+    self->glyphs = NULL;
+
+    if (count <= 0)
+        return self;
+
+    x0 = x1 = _glyph_center_x(coords[0]);
+    y0 = y1 = _glyph_center_y(coords[0]);
+    for (i = 0; i < count; ++i) {
+        x0 = MIN(x0, _glyph_center_x(coords[i]));
+        y0 = MIN(y0, _glyph_center_y(coords[i]));
+        x1 = MAX(x1, _glyph_center_x(coords[i]));
+        y1 = MAX(y1, _glyph_center_y(coords[i]));
+        self->max_width = MAX(self->max_width, coords[i].width);
+        self->max_height = MAX(self->max_height, coords[i].height);
+    }
+
+    self->bound = mume_rect_make(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+
+    /* Make the cells roughly square. */
+    target = count / _GLYPHIDX_CELL_GLYPHS + 1;
+    self->cols = (int)ceil(sqrt(
+        (double)target * self->bound.width / self->bound.height));
+    self->cols = MAX(MIN(self->cols, target), 1);
+    self->rows = (target + self->cols - 1) / self->cols;
+    self->cell_width =
+        (self->bound.width + self->cols - 1) / self->cols;
+    self->cell_height =
+        (self->bound.height + self->rows - 1) / self->rows;
+
+    /* Counting sort the glyphs by cell. */
+    self->cells = calloc_abort(
+        self->cols * self->rows + 1, sizeof(int));
+    self->glyphs = malloc_abort(count * sizeof(int));
+
+    for (i = 0; i < count; ++i)
+        ++self->cells[_glyphidx_cell(self, i) + 1];
+
+    for (i = 0; i < self->cols * self->rows; ++i)
+        self->cells[i + 1] += self->cells[i];
+
+    /* Fill each cell using its start as the cursor, then shift
+     * the cursors (now the ends) back to the starts. */
+    for (i = 0; i < count; ++i) {
+        cell = _glyphidx_cell(self, i);
+        self->glyphs[self->cells[cell]++] = i;
+    }
+
+    for (i = self->cols * self->rows; i > 0; --i)
+        self->cells[i] = self->cells[i - 1];
+
+    self->cells[0] = 0;
+    return self;
+}
+
+mume_glyphidx_t* mume_glyphidx_dtor(mume_glyphidx_t *self)
+{
+    free(self->cells);
+    free(self->glyphs);
+    return self;
+}
+
+int mume_glyphidx_closest(
+    const mume_glyphidx_t *self, int x, int y)
+{
+    int col, row, ring, c, r, result = -1;
+    double bound, dist = 0;
+
+    if (self->count <= 0)
+        return -1;
+
+    col = _glyphidx_col(self, x);
+    row = _glyphidx_row(self, y);
+
+    /* Visit the cells ring by ring, until the rest of the cells
+     * are all farther than the closest glyph found. */
+    for (ring = 0; ; ++ring) {
+        for (r = row - ring; r <= row + ring; ++r) {
+            if (r < 0 || r >= self->rows)
+                continue;
+
+            for (c = col - ring; c <= col + ring; ++c) {
+                if (c < 0 || c >= self->cols)
+                    continue;
+
+                if (r != row - ring && r != row + ring &&
+                    c != col - ring && c != col + ring)
+                {
+                    continue;
+                }
+
+                _glyphidx_visit(self, c, r, x, y, &result, &dist);
+            }
+        }
+
+        bound = _glyphidx_ring_bound(self, col, row, ring, x, y);
+        if (bound < 0)
+            break;
+
+        if (result != -1 && bound * bound > dist)
+            break;
+    }
+
+    return result;
+}
+
+int mume_glyphidx_range(
+    const mume_glyphidx_t *self, mume_rect_t rect,
+    int *begin, int *end)
+{
+    int c0, c1, r0, r1, c, r, i, g;
+
+    *begin = self->count;
+    *end = 0;
+
+    if (self->count <= 0 || rect.width <= 0 || rect.height <= 0)
+        return 0;
+
+    /* Glyphs are bucketed by centers, so take in the glyphs
+     * whose centers are out of <rect> but may overlap it. */
+    c0 = _glyphidx_col(self, rect.x - self->max_width / 2 - 1);
+    c1 = _glyphidx_col(
+        self, rect.x + rect.width + self->max_width / 2 + 1);
+    r0 = _glyphidx_row(self, rect.y - self->max_height / 2 - 1);
+    r1 = _glyphidx_row(
+        self, rect.y + rect.height + self->max_height / 2 + 1);
+
+    for (r = r0; r <= r1; ++r) {
+        for (c = c0; c <= c1; ++c) {
+            for (i = self->cells[r * self->cols + c];
+                 i < self->cells[r * self->cols + c + 1]; ++i)
+            {
+                g = self->glyphs[i];
+                if (mume_rect_is_empty(
+                        mume_rect_intersect(self->coords[g], rect)))
+                {
+                    continue;
+                }
+
+                *begin = MIN(*begin, g);
+                *end = MAX(*end, g + 1);
+            }
+        }
+    }
+
+    return *end > *begin;
+}
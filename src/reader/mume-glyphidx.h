@@ -0,0 +1,77 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_READER_GLYPHIDX_H
+#define MUME_READER_GLYPHIDX_H
+
+/* The glyph index buckets the glyphs of a page into a uniform
+ * grid by their centers, so hit testing doesn't need to visit
+ * every glyph of the page. */
+
+#include "mume-common.h"
+
+MUME_BEGIN_DECLS
+
+typedef struct mume_glyphidx_s mume_glyphidx_t;
+
+struct mume_glyphidx_s {
+    const mume_rect_t *coords;  /* Glyph rects, not owned. */
+    int count;
+    mume_rect_t bound;          /* Bound of the glyph centers. */
+    int cell_width;
+    int cell_height;
+    int cols;
+    int rows;
+    int max_width;              /* Widest glyph. */
+    int max_height;             /* Highest glyph. */
+    int *cells;                 /* Start of each cell in <glyphs>. */
+    int *glyphs;                /* Glyph indices ordered by cell. */
+};
+
+/* Build the index of <count> glyphs, <coords> must be valid
+ * until the index is destroyed. */
+murdr_public mume_glyphidx_t* mume_glyphidx_ctor(
+    mume_glyphidx_t *self, const mume_rect_t *coords, int count);
+
+murdr_public mume_glyphidx_t* mume_glyphidx_dtor(
+    mume_glyphidx_t *self);
+
+/* Return the index of the glyph whose center is closest to
+ * (x, y), or -1 if there is no glyph. */
+murdr_public int mume_glyphidx_closest(
+    const mume_glyphidx_t *self, int x, int y);
+
+/* Get the range [<begin>, <end>) of the glyph indices that
+ * intersect with <rect>. Return zero if no glyph intersects. */
+murdr_public int mume_glyphidx_range(
+    const mume_glyphidx_t *self, mume_rect_t rect,
+    int *begin, int *end);
+
+#define mume_glyphidx_new(_coords, _count) \
+    mume_glyphidx_ctor(malloc_struct(mume_glyphidx_t), _coords, _count)
+
+#define mume_glyphidx_delete(_self) \
+    free(mume_glyphidx_dtor(_self))
+
+/* Bytes used by the index. */
+#define mume_glyphidx_size(_self) \
+    (sizeof(mume_glyphidx_t) + sizeof(int) * \
+     ((_self)->cols * (_self)->rows + 1 + (_self)->count))
+
+MUME_END_DECLS
+
+#endif /* MUME_READER_GLYPHIDX_H */
@@ -150,6 +150,7 @@ char* mume_create_digest(mume_stream_t *stm)
     gcry_md_hd_t hd;
     char buf[10240];
     char *result;
+    const void *data;
     size_t len;
     int algo = GCRY_MD_SHA1;
 
@@ -161,8 +162,15 @@ char* mume_create_digest(mume_stream_t *stm)
 
     /* gcry_md_reset(hd); */
 
-    while ((len = mume_stream_read(stm, buf, sizeof(buf))))
-        gcry_md_write(hd, buf, len);
+    len = mume_stream_length(stm);
+    data = mume_stream_peek(stm, 0, len);
+    if (data) {
+        gcry_md_write(hd, data, len);
+    }
+    else {
+        while ((len = mume_stream_read(stm, buf, sizeof(buf))))
+            gcry_md_write(hd, buf, len);
+    }
 
     gcry_md_final(hd);
     len = gcry_md_get_algo_dlen(algo);
@@ -118,7 +118,9 @@ void mume_index_view_set_doc(void *_self, void *doc)
 
     mume_refobj_addref(self->doc);
 
+    mume_docdoc_lock(self->doc);
     toc = mume_docdoc_get_toc_tree(self->doc);
+    mume_docdoc_unlock(self->doc);
     if (toc) {
         _index_view_build_tree(self, mume_treeview_root(self), toc);
         mume_tocitem_destroy(toc);
@@ -135,6 +135,79 @@ static void _open_initial_doc(const char *file)
     }
 }
 
+static double _seconds_since(const mume_timeval_t *t0)
+{
+    mume_timeval_t t1;
+
+    mume_gettimeofday(&t1);
+    t1 = mume_timeval_sub(&t1, t0);
+    return t1.tv_sec + t1.tv_usec / 1000000.0;
+}
+
+/* Report how long it takes to open the pdf document and render
+ * its first page. No backend is needed, so it runs headless. Txt
+ * documents take their fonts from the theme, which needs one. */
+static int _time_first_paint(const char *file)
+{
+    void *doc;
+    mume_stream_t *stm;
+    mume_timeval_t t0;
+    mume_matrix_t ctm;
+    mume_rect_t rect;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    double load_time;
+
+    if (NULL == file) {
+        fprintf(stderr, "No document to time\n");
+        return 1;
+    }
+
+    mume_gettimeofday(&t0);
+    stm = mume_mmap_stream_open(file);
+    if (NULL == stm) {
+        fprintf(stderr, "Open document error: %s\n", file);
+        return 1;
+    }
+
+    doc = mume_new(mume_pdf_doc_class());
+    if (!mume_docdoc_load(doc, stm)) {
+        fprintf(stderr, "Load document error: %s\n", file);
+        mume_stream_close(stm);
+        mume_delete(doc);
+        return 1;
+    }
+
+    mume_stream_close(stm);
+
+    load_time = _seconds_since(&t0);
+    mume_docdoc_lock(doc);
+
+    if (mume_docdoc_count_pages(doc) > 0) {
+        ctm = mume_docdoc_get_matrix(doc, 0, 1.0f, 0);
+        rect = mume_rect_transform(
+            mume_docdoc_get_mediabox(doc, 0), ctm);
+        rect.x = 0;
+        rect.y = 0;
+
+        surface = cairo_image_surface_create(
+            CAIRO_FORMAT_RGB24, MAX(rect.width, 1), MAX(rect.height, 1));
+        cr = cairo_create(surface);
+        mume_docdoc_render_page(doc, cr, 0, 0, 0, ctm, rect);
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+    }
+
+    mume_docdoc_unlock(doc);
+
+    printf("%s: %d pages, load %.3fs, first paint %.3fs\n",
+           file, mume_docdoc_count_pages(doc),
+           load_time, _seconds_since(&t0));
+
+    mume_delete(doc);
+    return 0;
+}
+
 static void _save_profile(const char *file)
 {
     void *profile = mume_profile();
@@ -172,7 +245,7 @@ int main(int argc, char* argv[])
     const char *profile_name = NULL;
     const char *theme_name = NULL;
     mume_dlhdl_t *dlhdl = NULL;
-    int c, width = 0, height = 0;
+    int c, width = 0, height = 0, timing = 0;
     unsigned int flags = 0;
     void *backend = NULL;
     void *frontend = mume_frontend_new();
@@ -184,6 +257,7 @@ int main(int argc, char* argv[])
         { "height", required_argument, NULL, 'h' },
         { "profile", required_argument, NULL, 'p' },
         { "theme", required_argument, NULL, 't' },
+        { "timing", no_argument, NULL, 'T' },
         { 0, 0, 0, 0 },
     };
 
@@ -217,12 +291,22 @@ int main(int argc, char* argv[])
         case 't':
             theme_name = optarg;
             break;
+
+        case 'T':
+            timing = 1;
+            break;
         }
     }
 
     _init_environments();
     mume_init_libcrypto();
 
+    if (timing) {
+        c = _time_first_paint(argv[optind]);
+        mume_delete(frontend);
+        return c;
+    }
+
     if (NULL == backend_name) {
         backend_name = getenv("MUME_BACKEND_NAME");
     }
@@ -0,0 +1,211 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-pagecache.h"
+
+struct _entry {
+    const void *owner;
+    int kind;
+    int pageno;
+    void *data;
+    size_t size;
+    void (*destroy)(void *data);
+    struct _entry *prev;    /* More recently used. */
+    struct _entry *next;    /* Less recently used. */
+};
+
+#define _entry_node(_entry) \
+    ((mume_oset_node_t*)((char*)(_entry) - sizeof(mume_oset_node_t)))
+
+static int _entry_compare(const void *a, const void *b)
+{
+    const struct _entry *e1 = a;
+    const struct _entry *e2 = b;
+
+    if (e1->owner != e2->owner)
+        return (const char*)e1->owner < (const char*)e2->owner ? -1 : 1;
+
+    if (e1->kind != e2->kind)
+        return e1->kind - e2->kind;
+
+    return e1->pageno - e2->pageno;
+}
+
+static void _entry_destruct(void *obj, void *p)
+{
+    struct _entry *entry = obj;
+
+    if (entry->destroy)
+        entry->destroy(entry->data);
+}
+
+static void _pagecache_unlink(
+    mume_pagecache_t *self, struct _entry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        self->lru_front = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        self->lru_back = entry->prev;
+
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void _pagecache_link_front(
+    mume_pagecache_t *self, struct _entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = self->lru_front;
+
+    if (entry->next)
+        entry->next->prev = entry;
+    else
+        self->lru_back = entry;
+
+    self->lru_front = entry;
+}
+
+static void _pagecache_remove(
+    mume_pagecache_t *self, struct _entry *entry)
+{
+    _pagecache_unlink(self, entry);
+    self->size -= entry->size;
+    mume_oset_erase(self->entries, _entry_node(entry));
+}
+
+mume_pagecache_t* mume_pagecache_ctor(
+    mume_pagecache_t *self, size_t budget)
+{
+    self->entries = mume_oset_new(_entry_compare, _entry_destruct, NULL);
+    self->lru_front = NULL;
+    self->lru_back = NULL;
+    self->size = 0;
+    self->budget = budget;
+    self->hits = 0;
+    self->misses = 0;
+    self->evictions = 0;
+    return self;
+}
+
+mume_pagecache_t* mume_pagecache_dtor(mume_pagecache_t *self)
+{
+    mume_oset_delete(self->entries);
+    return self;
+}
+
+int mume_pagecache_find(
+    mume_pagecache_t *self, const void *owner,
+    int kind, int pageno, void **data)
+{
+    mume_oset_node_t *node;
+    struct _entry key, *entry;
+
+    key.owner = owner;
+    key.kind = kind;
+    key.pageno = pageno;
+
+    node = mume_oset_find(self->entries, &key);
+    if (NULL == node) {
+        ++self->misses;
+        return 0;
+    }
+
+    entry = mume_oset_data(node);
+    if (entry != self->lru_front) {
+        _pagecache_unlink(self, entry);
+        _pagecache_link_front(self, entry);
+    }
+
+    ++self->hits;
+    *data = entry->data;
+    return 1;
+}
+
+void mume_pagecache_insert(
+    mume_pagecache_t *self, const void *owner, int kind, int pageno,
+    void *data, size_t size, void (*destroy)(void *data))
+{
+    mume_oset_node_t *node;
+    struct _entry *entry;
+
+    node = mume_oset_newnode(sizeof(struct _entry));
+    entry = mume_oset_data(node);
+    entry->owner = owner;
+    entry->kind = kind;
+    entry->pageno = pageno;
+    entry->data = data;
+    entry->size = size;
+    entry->destroy = destroy;
+
+    /* Data must not be replaced, others may be using it. */
+    assert(NULL == mume_oset_find(self->entries, entry));
+
+    mume_oset_insert(self->entries, node);
+    _pagecache_link_front(self, entry);
+    self->size += size;
+}
+
+void mume_pagecache_trim(
+    mume_pagecache_t *self, const void *owner)
+{
+    struct _entry *entry, *prev;
+
+    for (entry = self->lru_back;
+         entry && self->size > self->budget; entry = prev)
+    {
+        prev = entry->prev;
+        if (owner && entry->owner != owner)
+            continue;
+
+        _pagecache_remove(self, entry);
+        ++self->evictions;
+    }
+}
+
+void mume_pagecache_invalidate(
+    mume_pagecache_t *self, const void *owner)
+{
+    if (NULL == owner) {
+        mume_oset_clear(self->entries);
+        self->lru_front = NULL;
+        self->lru_back = NULL;
+        self->size = 0;
+        return;
+    }
+
+    mume_pagecache_invalidate_from(self, owner, 0);
+}
+
+void mume_pagecache_invalidate_from(
+    mume_pagecache_t *self, const void *owner, int pageno)
+{
+    struct _entry *entry, *next;
+
+    for (entry = self->lru_front; entry; entry = next) {
+        next = entry->next;
+        if ((NULL == owner || entry->owner == owner) &&
+            entry->pageno >= pageno)
+        {
+            _pagecache_remove(self, entry);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_READER_PAGECACHE_H
+#define MUME_READER_PAGECACHE_H
+
+/* The page cache holds the data derived from document pages
+ * (display lists, extracted texts, links, etc.) within a byte
+ * budget. Each document has one, the data of different owners
+ * and kinds are evicted together in least recently used order.
+ *
+ * The cache is protected by the document lock. Data is never
+ * freed when inserted, but only by mume_pagecache_trim, so a
+ * found data can be used until the owner trims the cache. */
+
+#include "mume-common.h"
+
+MUME_BEGIN_DECLS
+
+/* Default memory budget in bytes. */
+#define MUME_PAGECACHE_DEFAULT_BUDGET (32 * 1024 * 1024)
+
+typedef struct mume_pagecache_s mume_pagecache_t;
+
+struct mume_pagecache_s {
+    mume_oset_t *entries;
+    void *lru_front;            /* Most recently used entry. */
+    void *lru_back;             /* Least recently used entry. */
+    size_t size;                /* Bytes of all the cached data. */
+    size_t budget;              /* Maximum bytes allowed. */
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
+
+murdr_public mume_pagecache_t* mume_pagecache_ctor(
+    mume_pagecache_t *self, size_t budget);
+
+/* Destroy all the remaining data. */
+murdr_public mume_pagecache_t* mume_pagecache_dtor(
+    mume_pagecache_t *self);
+
+/* Find the data of <kind> for the page <pageno> of <owner>, and
+ * mark it as the most recently used. Return zero if not cached. */
+murdr_public int mume_pagecache_find(
+    mume_pagecache_t *self, const void *owner,
+    int kind, int pageno, void **data);
+
+/* Cache <data> that occupies <size> bytes, it will be destroyed
+ * by <destroy> when evicted or invalidated. */
+murdr_public void mume_pagecache_insert(
+    mume_pagecache_t *self, const void *owner, int kind, int pageno,
+    void *data, size_t size, void (*destroy)(void *data));
+
+/* Evict the least recently used data until the cache is within
+ * budget. Only the data of <owner> is evicted if it is not NULL,
+ * other owners may still be using theirs. */
+murdr_public void mume_pagecache_trim(
+    mume_pagecache_t *self, const void *owner);
+
+/* Destroy all the data of <owner>, or all data if it is NULL. */
+murdr_public void mume_pagecache_invalidate(
+    mume_pagecache_t *self, const void *owner);
+
+/* Destroy the data of all kinds of <owner>, or of all owners if it
+ * is NULL, for the pages from <pageno> on. */
+murdr_public void mume_pagecache_invalidate_from(
+    mume_pagecache_t *self, const void *owner, int pageno);
+
+#define mume_pagecache_new(_budget) \
+    mume_pagecache_ctor(malloc_struct(mume_pagecache_t), _budget)
+
+#define mume_pagecache_delete(_self) \
+    free(mume_pagecache_dtor(_self))
+
+#define mume_pagecache_set_budget(_self, _budget) \
+    ((_self)->budget = (_budget))
+
+#define mume_pagecache_get_budget(_self) ((_self)->budget)
+
+#define mume_pagecache_size(_self) ((_self)->size)
+
+#define mume_pagecache_count(_self) mume_oset_size((_self)->entries)
+
+#define mume_pagecache_hits(_self) ((_self)->hits)
+
+#define mume_pagecache_misses(_self) ((_self)->misses)
+
+#define mume_pagecache_evictions(_self) ((_self)->evictions)
+
+MUME_END_DECLS
+
+#endif /* MUME_READER_PAGECACHE_H */
@@ -0,0 +1,248 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-renderq.h"
+#include "mume-docdoc.h"
+
+static void _renderjob_destruct(void *obj, void *p)
+{
+    mume_renderjob_t *job = obj;
+
+    if (job->surface)
+        cairo_surface_destroy(job->surface);
+
+    mume_refobj_release((void*)job->key.doc);
+}
+
+static int _renderq_key_equal(
+    const mume_tilekey_t *k1, const mume_tilekey_t *k2)
+{
+    return k1->doc == k2->doc && k1->pageno == k2->pageno &&
+           k1->zoom == k2->zoom && k1->rotate == k2->rotate &&
+           k1->column == k2->column && k1->row == k2->row;
+}
+
+static mume_renderjob_t* _renderq_next_pending(mume_renderq_t *self)
+{
+    mume_list_node_t *node;
+    mume_renderjob_t *job, *result = NULL;
+
+    mume_list_foreach(self->jobs, node, job) {
+        if (job->state != MUME_RENDERJOB_PENDING)
+            continue;
+
+        if (NULL == result || job->priority < result->priority)
+            result = job;
+    }
+
+    return result;
+}
+
+cairo_surface_t* mume_renderq_render(
+    const mume_tilekey_t *key, mume_matrix_t ctm, mume_rect_t rect)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    void *doc = (void*)key->doc;
+
+    surface = cairo_image_surface_create(
+        CAIRO_FORMAT_RGB24, rect.width, rect.height);
+
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        mume_error(("cairo_image_surface_create(%d, %d)\n",
+                    rect.width, rect.height));
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    cr = cairo_create(surface);
+    mume_docdoc_lock(doc);
+    mume_docdoc_render_page(doc, cr, 0, 0, key->pageno, ctm, rect);
+    mume_docdoc_unlock(doc);
+    cairo_destroy(cr);
+
+    return surface;
+}
+
+static void _renderq_proc(void *param)
+{
+    mume_renderq_t *self = param;
+    mume_renderjob_t *job;
+    cairo_surface_t *surface;
+    int notify;
+
+    for (;;) {
+        mume_sem_wait(self->sem);
+        mume_mutex_lock(self->mutex);
+
+        if (self->quit) {
+            mume_mutex_unlock(self->mutex);
+            break;
+        }
+
+        /* The job may have been cancelled. */
+        job = _renderq_next_pending(self);
+        if (NULL == job) {
+            mume_mutex_unlock(self->mutex);
+            continue;
+        }
+
+        job->state = MUME_RENDERJOB_RUNNING;
+        mume_mutex_unlock(self->mutex);
+
+        surface = mume_renderq_render(&job->key, job->ctm, job->rect);
+
+        mume_mutex_lock(self->mutex);
+        job->surface = surface;
+        job->state = MUME_RENDERJOB_DONE;
+        notify = !self->notified;
+        self->notified = 1;
+        mume_mutex_unlock(self->mutex);
+
+        if (notify) {
+            mume_post_event(mume_make_notify_event(
+                self->window, self->window, self->code, NULL));
+        }
+    }
+}
+
+mume_renderq_t* mume_renderq_ctor(
+    mume_renderq_t *self, void *window, int code, int thread_count)
+{
+    int i;
+
+    assert(thread_count > 0);
+
+    self->mutex = mume_mutex_new();
+    self->sem = mume_sem_new();
+    self->jobs = mume_list_new(_renderjob_destruct, NULL);
+    self->threads = malloc_abort(
+        thread_count * sizeof(mume_thread_t*));
+    self->thread_count = thread_count;
+    self->quit = 0;
+    self->notified = 0;
+    self->window = window;
+    self->code = code;
+
+    for (i = 0; i < thread_count; ++i)
+        self->threads[i] = mume_thread_new(_renderq_proc, self);
+
+    return self;
+}
+
+mume_renderq_t* mume_renderq_dtor(mume_renderq_t *self)
+{
+    int i;
+
+    mume_mutex_lock(self->mutex);
+    self->quit = 1;
+    mume_mutex_unlock(self->mutex);
+
+    for (i = 0; i < self->thread_count; ++i)
+        mume_sem_post(self->sem);
+
+    for (i = 0; i < self->thread_count; ++i) {
+        if (self->threads[i]) {
+            mume_thread_join(self->threads[i]);
+            mume_thread_delete(self->threads[i]);
+        }
+    }
+
+    free(self->threads);
+    mume_list_delete(self->jobs);
+    mume_sem_delete(self->sem);
+    mume_mutex_delete(self->mutex);
+    return self;
+}
+
+int mume_renderq_submit(
+    mume_renderq_t *self, const mume_tilekey_t *key,
+    mume_matrix_t ctm, mume_rect_t rect, int priority)
+{
+    mume_list_node_t *node;
+    mume_renderjob_t *job;
+
+    mume_mutex_lock(self->mutex);
+    mume_list_foreach(self->jobs, node, job) {
+        if (_renderq_key_equal(&job->key, key)) {
+            if (job->state == MUME_RENDERJOB_PENDING &&
+                priority < job->priority)
+            {
+                job->priority = priority;
+            }
+
+            mume_mutex_unlock(self->mutex);
+            return 0;
+        }
+    }
+
+    node = mume_list_push_back(self->jobs, sizeof(mume_renderjob_t));
+    job = mume_list_data(node);
+    job->key = *key;
+    job->ctm = ctm;
+    job->rect = rect;
+    job->priority = priority;
+    job->state = MUME_RENDERJOB_PENDING;
+    job->surface = NULL;
+    mume_refobj_addref((void*)key->doc);
+    mume_mutex_unlock(self->mutex);
+
+    mume_sem_post(self->sem);
+    return 1;
+}
+
+void mume_renderq_cancel(mume_renderq_t *self, const void *doc)
+{
+    mume_list_node_t *node, *next;
+    mume_renderjob_t *job;
+
+    mume_mutex_lock(self->mutex);
+    mume_list_foreach_safe(self->jobs, node, job, next) {
+        if (job->state != MUME_RENDERJOB_PENDING)
+            continue;
+
+        if (NULL == doc || job->key.doc == doc)
+            mume_list_erase(self->jobs, node);
+    }
+
+    mume_mutex_unlock(self->mutex);
+}
+
+int mume_renderq_pop(mume_renderq_t *self, mume_renderjob_t *job)
+{
+    mume_list_node_t *node;
+    mume_renderjob_t *it;
+    int result = 0;
+
+    mume_mutex_lock(self->mutex);
+    mume_list_foreach(self->jobs, node, it) {
+        if (it->state == MUME_RENDERJOB_DONE) {
+            *job = *it;
+            /* The surface is moved to the caller. */
+            it->surface = NULL;
+            mume_list_erase(self->jobs, node);
+            result = 1;
+            break;
+        }
+    }
+
+    if (!result)
+        self->notified = 0;
+
+    mume_mutex_unlock(self->mutex);
+    return result;
+}
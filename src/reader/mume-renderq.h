@@ -0,0 +1,99 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_READER_RENDERQ_H
+#define MUME_READER_RENDERQ_H
+
+/* The render queue rasterizes document tiles on worker threads,
+ * and notifies the owner window through the event queue when
+ * some of them are finished. */
+
+#include "mume-tilecache.h"
+
+MUME_BEGIN_DECLS
+
+typedef struct mume_renderq_s mume_renderq_t;
+typedef struct mume_renderjob_s mume_renderjob_t;
+
+enum mume_renderjob_state_e {
+    MUME_RENDERJOB_PENDING,
+    MUME_RENDERJOB_RUNNING,
+    MUME_RENDERJOB_DONE
+};
+
+struct mume_renderjob_s {
+    mume_tilekey_t key;
+    mume_matrix_t ctm;
+    mume_rect_t rect;           /* Tile rect in page space. */
+    int priority;               /* Smaller is more urgent. */
+    int state;
+    cairo_surface_t *surface;   /* Rendered result. */
+};
+
+struct mume_renderq_s {
+    mume_mutex_t *mutex;
+    mume_sem_t *sem;            /* Posted once for each job. */
+    mume_list_t *jobs;
+    mume_thread_t **threads;
+    int thread_count;
+    int quit;
+    int notified;               /* Notify event not yet handled. */
+    void *window;               /* Receiver of the notify event. */
+    int code;                   /* Notify code. */
+};
+
+murdr_public mume_renderq_t* mume_renderq_ctor(
+    mume_renderq_t *self, void *window, int code, int thread_count);
+
+/* Stop and join all the worker threads. */
+murdr_public mume_renderq_t* mume_renderq_dtor(
+    mume_renderq_t *self);
+
+/* Queue a job to render the <rect> of the page specified by <key>.
+ * Return zero if the same tile is already queued. The document of
+ * <key> will be referenced until the job is popped or cancelled. */
+murdr_public int mume_renderq_submit(
+    mume_renderq_t *self, const mume_tilekey_t *key,
+    mume_matrix_t ctm, mume_rect_t rect, int priority);
+
+/* Remove the pending jobs of <doc>, or all pending jobs if <doc>
+ * is NULL. Running jobs are not affected. */
+murdr_public void mume_renderq_cancel(
+    mume_renderq_t *self, const void *doc);
+
+/* Pop a finished job into <job>, return zero if there is none.
+ * The caller owns the surface of the job, the document reference
+ * is released so <job->key.doc> is only good for comparing. */
+murdr_public int mume_renderq_pop(
+    mume_renderq_t *self, mume_renderjob_t *job);
+
+/* Render the <rect> of the page specified by <key> into a new
+ * surface on the calling thread, with the document locked. Return
+ * NULL if failed. */
+murdr_public cairo_surface_t* mume_renderq_render(
+    const mume_tilekey_t *key, mume_matrix_t ctm, mume_rect_t rect);
+
+#define mume_renderq_new(_window, _code, _count) \
+    mume_renderq_ctor(malloc_struct(mume_renderq_t), \
+                      _window, _code, _count)
+
+#define mume_renderq_delete(_self) \
+    free(mume_renderq_dtor(_self))
+
+MUME_END_DECLS
+
+#endif /* MUME_READER_RENDERQ_H */
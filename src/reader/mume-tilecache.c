@@ -0,0 +1,204 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-tilecache.h"
+
+struct _tile {
+    mume_tilekey_t key;
+    cairo_surface_t *surface;
+    size_t size;
+    struct _tile *prev;     /* More recently used. */
+    struct _tile *next;     /* Less recently used. */
+};
+
+#define _tile_node(_tile) \
+    ((mume_oset_node_t*)((char*)(_tile) - sizeof(mume_oset_node_t)))
+
+static int _tile_compare(const void *a, const void *b)
+{
+    const mume_tilekey_t *k1 = a;
+    const mume_tilekey_t *k2 = b;
+
+    if (k1->doc != k2->doc)
+        return (const char*)k1->doc < (const char*)k2->doc ? -1 : 1;
+
+    if (k1->pageno != k2->pageno)
+        return k1->pageno - k2->pageno;
+
+    if (k1->zoom != k2->zoom)
+        return k1->zoom < k2->zoom ? -1 : 1;
+
+    if (k1->rotate != k2->rotate)
+        return k1->rotate - k2->rotate;
+
+    if (k1->row != k2->row)
+        return k1->row - k2->row;
+
+    return k1->column - k2->column;
+}
+
+static void _tile_destruct(void *obj, void *p)
+{
+    struct _tile *tile = obj;
+    cairo_surface_destroy(tile->surface);
+}
+
+static void _tilecache_unlink(
+    mume_tilecache_t *self, struct _tile *tile)
+{
+    if (tile->prev)
+        tile->prev->next = tile->next;
+    else
+        self->lru_front = tile->next;
+
+    if (tile->next)
+        tile->next->prev = tile->prev;
+    else
+        self->lru_back = tile->prev;
+
+    tile->prev = NULL;
+    tile->next = NULL;
+}
+
+static void _tilecache_link_front(
+    mume_tilecache_t *self, struct _tile *tile)
+{
+    tile->prev = NULL;
+    tile->next = self->lru_front;
+
+    if (tile->next)
+        tile->next->prev = tile;
+    else
+        self->lru_back = tile;
+
+    self->lru_front = tile;
+}
+
+static void _tilecache_remove(
+    mume_tilecache_t *self, struct _tile *tile)
+{
+    _tilecache_unlink(self, tile);
+    self->size -= tile->size;
+    mume_oset_erase(self->tiles, _tile_node(tile));
+}
+
+static void _tilecache_shrink(mume_tilecache_t *self, size_t budget)
+{
+    while (self->size > budget && self->lru_back)
+        _tilecache_remove(self, self->lru_back);
+}
+
+mume_tilecache_t* mume_tilecache_ctor(
+    mume_tilecache_t *self, size_t budget)
+{
+    self->tiles = mume_oset_new(_tile_compare, _tile_destruct, NULL);
+    self->lru_front = NULL;
+    self->lru_back = NULL;
+    self->size = 0;
+    self->budget = budget;
+    return self;
+}
+
+mume_tilecache_t* mume_tilecache_dtor(mume_tilecache_t *self)
+{
+    mume_oset_delete(self->tiles);
+    return self;
+}
+
+cairo_surface_t* mume_tilecache_find(
+    mume_tilecache_t *self, const mume_tilekey_t *key)
+{
+    mume_oset_node_t *node;
+    struct _tile *tile;
+
+    node = mume_oset_find(self->tiles, key);
+    if (NULL == node)
+        return NULL;
+
+    tile = mume_oset_data(node);
+    if (tile != self->lru_front) {
+        _tilecache_unlink(self, tile);
+        _tilecache_link_front(self, tile);
+    }
+
+    return tile->surface;
+}
+
+void mume_tilecache_insert(
+    mume_tilecache_t *self, const mume_tilekey_t *key,
+    cairo_surface_t *surface)
+{
+    mume_oset_node_t *node;
+    struct _tile *tile;
+    size_t size;
+
+    size = cairo_image_surface_get_stride(surface) *
+           cairo_image_surface_get_height(surface);
+
+    /* Never hold a tile larger than the whole budget. */
+    if (size > self->budget)
+        return;
+
+    node = mume_oset_find(self->tiles, key);
+    if (node)
+        _tilecache_remove(self, mume_oset_data(node));
+
+    _tilecache_shrink(self, self->budget - size);
+
+    node = mume_oset_newnode(sizeof(struct _tile));
+    tile = mume_oset_data(node);
+    tile->key = *key;
+    tile->surface = cairo_surface_reference(surface);
+    tile->size = size;
+
+    mume_oset_insert(self->tiles, node);
+    _tilecache_link_front(self, tile);
+    self->size += size;
+}
+
+void mume_tilecache_invalidate(
+    mume_tilecache_t *self, const void *doc)
+{
+    if (NULL == doc) {
+        mume_oset_clear(self->tiles);
+        self->lru_front = NULL;
+        self->lru_back = NULL;
+        self->size = 0;
+        return;
+    }
+
+    mume_tilecache_invalidate_from(self, doc, 0);
+}
+
+void mume_tilecache_invalidate_from(
+    mume_tilecache_t *self, const void *doc, int pageno)
+{
+    struct _tile *tile, *next;
+
+    for (tile = self->lru_front; tile; tile = next) {
+        next = tile->next;
+        if (tile->key.doc == doc && tile->key.pageno >= pageno)
+            _tilecache_remove(self, tile);
+    }
+}
+
+void mume_tilecache_set_budget(
+    mume_tilecache_t *self, size_t budget)
+{
+    self->budget = budget;
+    _tilecache_shrink(self, budget);
+}
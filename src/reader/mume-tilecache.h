@@ -0,0 +1,108 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_READER_TILECACHE_H
+#define MUME_READER_TILECACHE_H
+
+#include "mume-common.h"
+
+MUME_BEGIN_DECLS
+
+/* Width and height of a tile in device pixels. */
+#define MUME_TILECACHE_TILE_SIZE 256
+
+/* Default memory budget in bytes. */
+#define MUME_TILECACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef struct mume_tilekey_s mume_tilekey_t;
+typedef struct mume_tilecache_s mume_tilecache_t;
+
+struct mume_tilekey_s {
+    const void *doc;
+    int pageno;
+    float zoom;
+    int rotate;
+    int column;
+    int row;
+};
+
+struct mume_tilecache_s {
+    mume_oset_t *tiles;
+    void *lru_front;    /* Most recently used tile. */
+    void *lru_back;     /* Least recently used tile. */
+    size_t size;        /* Bytes of all the cached surfaces. */
+    size_t budget;      /* Maximum bytes allowed. */
+};
+
+static inline mume_tilekey_t mume_tilekey_make(
+    const void *doc, int pageno, float zoom,
+    int rotate, int column, int row)
+{
+    mume_tilekey_t key;
+    key.doc = doc;
+    key.pageno = pageno;
+    key.zoom = zoom;
+    key.rotate = rotate;
+    key.column = column;
+    key.row = row;
+    return key;
+}
+
+murdr_public mume_tilecache_t* mume_tilecache_ctor(
+    mume_tilecache_t *self, size_t budget);
+
+murdr_public mume_tilecache_t* mume_tilecache_dtor(
+    mume_tilecache_t *self);
+
+/* Return the cached surface of <key> and mark it as the most
+ * recently used, or NULL if not cached. The cache keeps the
+ * reference of the returned surface. */
+murdr_public cairo_surface_t* mume_tilecache_find(
+    mume_tilecache_t *self, const mume_tilekey_t *key);
+
+/* Cache <surface> for <key>, the cache adds a reference to it.
+ * Least recently used tiles will be evicted when over budget. */
+murdr_public void mume_tilecache_insert(
+    mume_tilecache_t *self, const mume_tilekey_t *key,
+    cairo_surface_t *surface);
+
+/* Remove all the tiles of <doc>, or all tiles if <doc> is NULL. */
+murdr_public void mume_tilecache_invalidate(
+    mume_tilecache_t *self, const void *doc);
+
+/* Remove the tiles of the pages of <doc> from <pageno> on. */
+murdr_public void mume_tilecache_invalidate_from(
+    mume_tilecache_t *self, const void *doc, int pageno);
+
+murdr_public void mume_tilecache_set_budget(
+    mume_tilecache_t *self, size_t budget);
+
+#define mume_tilecache_new(_budget) \
+    mume_tilecache_ctor(malloc_struct(mume_tilecache_t), _budget)
+
+#define mume_tilecache_delete(_self) \
+    free(mume_tilecache_dtor(_self))
+
+#define mume_tilecache_get_budget(_self) ((_self)->budget)
+
+#define mume_tilecache_size(_self) ((_self)->size)
+
+#define mume_tilecache_count(_self) mume_oset_size((_self)->tiles)
+
+MUME_END_DECLS
+
+#endif /* MUME_READER_TILECACHE_H */
@@ -21,30 +21,92 @@
 
 #define _pdf_doc_super_class mume_docdoc_class
 
+/* Kinds of the page cache data. */
+#define _PDF_DOC_CACHE_LIST 0
+
+/* The memory used by a display list is not exposed by mupdf,
+ * account each of them as an average sized one. */
+#define _PDF_DOC_LIST_SIZE (512 * 1024)
+
+/* Documents with more pages load the page infos in background. */
+#define _PDF_DOC_FILL_PAGES 64
+
 struct _pdf_doc {
     const char _[MUME_SIZEOF_DOCDOC];
     pdf_xref *xref;
     fz_glyph_cache *glyph_cache;
+    int page_count;
+    int lazy_pages;           /* Pages looked up by the counts. */
     pdf_page **pages;         /* Loaded pages. */
-    fz_display_list **disps;  /* Extracted display lists. */
     fz_rect *media_boxes;     /* Original media boxes from PDF. */
     int *page_rotates;        /* Original page rotates from PDF. */
+    char *page_infos;         /* Whether the above are loaded. */
+    mume_mutex_t *mutex;      /* Serialize the xref accesses. */
+    mume_thread_t *filler;    /* Background page info loader. */
+    int filler_quit;          /* Guarded by <mutex>. */
+    fz_pixmap *pixmap;        /* Reused rendering target. */
+    cairo_surface_t *surface; /* Cairo surface of <pixmap>. */
 };
 
 static void _pdf_doc_reset(struct _pdf_doc *self)
 {
     self->xref = NULL;
     self->glyph_cache = NULL;
+    self->page_count = 0;
+    self->lazy_pages = 0;
     self->pages = NULL;
-    self->disps = NULL;
     self->media_boxes = NULL;
     self->page_rotates = NULL;
+    self->page_infos = NULL;
+    self->filler = NULL;
+    self->filler_quit = 0;
+    self->pixmap = NULL;
+    self->surface = NULL;
+}
+
+/* The page arrays of the xref are private to mupdf, this follows
+ * their use in mupdf 0.9: pdf_count_pages returns page_len, and
+ * pdf_free_xref drops the first page_len entries of page_objs and
+ * page_refs, which must not be NULL. Replace them with <count>
+ * empty entries, filled as the pages are looked up. */
+static void _pdf_doc_resize_page_refs(pdf_xref *xref, int count)
+{
+    int i;
+
+    for (i = 0; i < xref->page_len; ++i) {
+        if (xref->page_objs[i])
+            fz_drop_obj(xref->page_objs[i]);
+
+        if (xref->page_refs[i])
+            fz_drop_obj(xref->page_refs[i]);
+    }
+
+    fz_free(xref->page_objs);
+    fz_free(xref->page_refs);
+    xref->page_len = count;
+    xref->page_cap = count;
+    xref->page_objs = NULL;
+    xref->page_refs = NULL;
+    if (count > 0) {
+        xref->page_objs = fz_calloc(count, sizeof(fz_obj*));
+        xref->page_refs = fz_calloc(count, sizeof(fz_obj*));
+    }
 }
 
 static void _pdf_doc_clear(struct _pdf_doc *self)
 {
     int i, c = mume_docdoc_count_pages(self);
 
+    if (self->filler) {
+        mume_mutex_lock(self->mutex);
+        self->filler_quit = 1;
+        mume_mutex_unlock(self->mutex);
+        mume_thread_join(self->filler);
+        mume_thread_delete(self->filler);
+    }
+
+    mume_pagecache_invalidate(mume_docdoc_get_cache(self), self);
+
     if (self->pages) {
         for (i = 0; i < c; ++i) {
             if (self->pages[i])
@@ -54,33 +116,226 @@ static void _pdf_doc_clear(struct _pdf_doc *self)
         free(self->pages);
     }
 
-    if (self->disps) {
-        for (i = 0; i < c; ++i) {
-            if (self->disps[i])
-                fz_free_display_list(self->disps[i]);
-        }
+    if (self->surface)
+        cairo_surface_destroy(self->surface);
 
-        free(self->disps);
-    }
+    if (self->pixmap)
+        fz_drop_pixmap(self->pixmap);
 
     if (self->glyph_cache)
         fz_free_glyph_cache(self->glyph_cache);
 
-    if (self->xref)
+    if (self->xref) {
+        /* Not all the pages may have been looked up. */
+        _pdf_doc_resize_page_refs(self->xref, 0);
         pdf_free_xref(self->xref);
+    }
 
     free(self->media_boxes);
     free(self->page_rotates);
+    free(self->page_infos);
 
     _pdf_doc_reset(self);
 }
 
+/* Return the number of pages under <node>, or -1 if it is a
+ * Pages node without a valid Count. */
+static int _pdf_doc_node_count(fz_obj *node)
+{
+    fz_obj *type = fz_dict_gets(node, "Type");
+    fz_obj *count;
+
+    if ((fz_is_name(type) && strcmp(fz_to_name(type), "Pages") == 0) ||
+        fz_is_array(fz_dict_gets(node, "Kids")))
+    {
+        count = fz_dict_gets(node, "Count");
+        if (!fz_is_int(count) || fz_to_int(count) < 0)
+            return -1;
+
+        return fz_to_int(count);
+    }
+
+    return 1;
+}
+
+/* Return the Count of the Pages <node> if its kids add up to it,
+ * or -1, then the counts can't be used to find the pages. */
+static int _pdf_doc_check_count(fz_obj *node)
+{
+    fz_obj *kids = fz_dict_gets(node, "Kids");
+    int i, n, k, sum = 0;
+    int count = _pdf_doc_node_count(node);
+
+    if (count <= 0 || !fz_is_array(kids))
+        return -1;
+
+    n = fz_array_len(kids);
+    for (i = 0; i < n; ++i) {
+        k = _pdf_doc_node_count(fz_array_get(kids, i));
+        if (k < 0)
+            return -1;
+
+        sum += k;
+    }
+
+    return sum == count ? count : -1;
+}
+
+static void _pdf_doc_load_page_tree(struct _pdf_doc *self)
+{
+    /* The mutex must be locked by the caller, if the document
+     * is loaded. Find the pages by walking the whole tree. */
+    fz_error err;
+
+    _pdf_doc_resize_page_refs(self->xref, 0);
+    self->lazy_pages = 0;
+    err = pdf_load_page_tree(self->xref);
+    if (err) {
+        mume_error(("pdf_load_page_tree: %d\n", err));
+        _pdf_doc_resize_page_refs(self->xref, 0);
+    }
+}
+
+static fz_obj* _pdf_doc_find_page_obj(struct _pdf_doc *self, int pageno)
+{
+    /* Instead of walking the whole page tree as pdf_load_page_tree
+     * does, descend to the page with the counts of the kids, and
+     * pick up the inherited attributes on the way. */
+    static const char *inherits[] = {
+        "Resources", "MediaBox", "CropBox", "Rotate"
+    };
+    fz_obj *values[COUNT_OF(inherits)];
+    fz_obj *node, *kids, *kid, *obj;
+    int i, n, index, depth;
+
+    memset(values, 0, sizeof(values));
+    node = fz_dict_gets(self->xref->trailer, "Root");
+    node = fz_dict_gets(node, "Pages");
+    index = pageno;
+
+    /* Bound the depth in case of a cyclic tree. */
+    for (depth = 0; depth < 64; ++depth) {
+        for (i = 0; i < COUNT_OF(inherits); ++i) {
+            obj = fz_dict_gets(node, inherits[i]);
+            if (obj)
+                values[i] = obj;
+        }
+
+        kids = fz_dict_gets(node, "Kids");
+        if (!fz_is_array(kids))
+            break;
+
+        if (_pdf_doc_check_count(node) < 0)
+            return NULL;
+
+        n = fz_array_len(kids);
+        for (i = 0; i < n; ++i) {
+            kid = fz_array_get(kids, i);
+            if (index < _pdf_doc_node_count(kid))
+                break;
+
+            index -= _pdf_doc_node_count(kid);
+        }
+
+        if (i == n)
+            return NULL;
+
+        node = kid;
+    }
+
+    if (fz_is_array(kids) || index != 0 || !fz_is_indirect(node))
+        return NULL;
+
+    obj = fz_copy_dict(fz_resolve_indirect(node));
+    for (i = 0; i < COUNT_OF(inherits); ++i) {
+        if (values[i] && !fz_dict_gets(obj, inherits[i]))
+            fz_dict_puts(obj, inherits[i], values[i]);
+    }
+
+    /* See _pdf_doc_resize_page_refs. */
+    self->xref->page_refs[pageno] = fz_keep_obj(node);
+    self->xref->page_objs[pageno] = obj;
+    return obj;
+}
+
+static fz_obj* _pdf_doc_get_page_obj(struct _pdf_doc *self, int pageno)
+{
+    /* The mutex must be locked by the caller. The whole tree has
+     * fewer pages than the counts if they are wrong. */
+    fz_obj *obj;
+
+    if (pageno >= pdf_count_pages(self->xref))
+        return NULL;
+
+    if (self->xref->page_objs[pageno] || !self->lazy_pages)
+        return self->xref->page_objs[pageno];
+
+    obj = _pdf_doc_find_page_obj(self, pageno);
+    if (obj)
+        return obj;
+
+    mume_warning(("Page %d not found by the counts, "
+                  "loading the page tree\n", pageno));
+    _pdf_doc_load_page_tree(self);
+    if (pageno >= pdf_count_pages(self->xref))
+        return NULL;
+
+    return self->xref->page_objs[pageno];
+}
+
+static int _pdf_doc_find_page_ref(struct _pdf_doc *self, fz_obj *ref)
+{
+    /* The mutex must be locked by the caller. Count the pages
+     * before <ref> by going up the tree from it, for the page
+     * refs are only known for the loaded pages. */
+    fz_obj *node, *parent, *kids, *kid;
+    int i, n, k, depth, index = 0;
+
+    if (!self->lazy_pages)
+        return pdf_find_page_number(self->xref, ref);
+
+    node = ref;
+    for (depth = 0; depth < 64; ++depth) {
+        parent = fz_dict_gets(node, "Parent");
+        kids = fz_dict_gets(parent, "Kids");
+        if (!fz_is_array(kids))
+            break;
+
+        n = fz_array_len(kids);
+        for (i = 0; i < n; ++i) {
+            kid = fz_array_get(kids, i);
+            if (fz_to_num(kid) == fz_to_num(node) &&
+                fz_to_gen(kid) == fz_to_gen(node))
+            {
+                break;
+            }
+
+            k = _pdf_doc_node_count(kid);
+            if (k < 0)
+                return -1;
+
+            index += k;
+        }
+
+        if (i == n)
+            return -1;
+
+        node = parent;
+    }
+
+    if (index >= self->page_count)
+        return -1;
+
+    return index;
+}
+
 static pdf_page* _pdf_doc_get_page(struct _pdf_doc *self, int pageno)
 {
+    /* The mutex must be locked by the caller. */
     if (self->pages[pageno])
         return self->pages[pageno];
 
-    if (NULL == self->pages[pageno]) {
+    if (_pdf_doc_get_page_obj(self, pageno)) {
         fz_error err = pdf_load_page(
             &self->pages[pageno], self->xref, pageno);
 
@@ -92,31 +347,47 @@ static pdf_page* _pdf_doc_get_page(struct _pdf_doc *self, int pageno)
     return self->pages[pageno];
 }
 
+static void _pdf_doc_free_list(void *list)
+{
+    fz_free_display_list(list);
+}
+
 static fz_display_list* _pdf_doc_get_list(
     struct _pdf_doc *self, int pageno)
 {
+    mume_pagecache_t *cache = mume_docdoc_get_cache(self);
+    fz_display_list *list;
     pdf_page *page;
+    fz_error err;
+    fz_device *mdev;
+
+    /* None of our display lists is in use here. */
+    mume_pagecache_trim(cache, self);
 
-    if (self->disps[pageno])
-        return self->disps[pageno];
+    if (mume_pagecache_find(
+            cache, self, _PDF_DOC_CACHE_LIST, pageno, (void**)&list))
+    {
+        return list;
+    }
 
+    mume_mutex_lock(self->mutex);
     page = _pdf_doc_get_page(self, pageno);
-    if (NULL == self->disps[pageno]) {
-        fz_error err;
-        fz_device *mdev;
+    list = fz_new_display_list();
+    mdev = fz_new_list_device(list);
+    err = pdf_run_page(self->xref, page, mdev, fz_identity);
 
-        self->disps[pageno] = fz_new_display_list();
-        mdev = fz_new_list_device(self->disps[pageno]);
-        err = pdf_run_page(self->xref, page, mdev, fz_identity);
+    if (err) {
+        mume_error(("pdf_run_page(%d): %d\n", pageno, err));
+    }
 
-        if (err) {
-            mume_error(("pdf_run_page(%d): %d\n", pageno, err));
-        }
+    fz_free_device(mdev);
+    mume_mutex_unlock(self->mutex);
 
-        fz_free_device(mdev);
-    }
+    mume_pagecache_insert(
+        cache, self, _PDF_DOC_CACHE_LIST, pageno,
+        list, _PDF_DOC_LIST_SIZE, _pdf_doc_free_list);
 
-    return self->disps[pageno];
+    return list;
 }
 
 static int _pdf_doc_find_page_no(
@@ -135,7 +406,10 @@ static int _pdf_doc_find_page_no(
     if (fz_is_int(dest))
         return fz_to_int(dest);
 
-    return pdf_find_page_number(self->xref, dest);
+    if (!fz_is_indirect(dest))
+        return -1;
+
+    return _pdf_doc_find_page_ref(self, dest);
 }
 
 static mume_tocitem_t* _pdf_doc_build_toc_tree(
@@ -319,6 +593,70 @@ static void _pdf_stream_close(fz_stream *stm)
     mume_stream_close(stm->state);
 }
 
+static void _pdf_doc_load_info(struct _pdf_doc *self, int pageno)
+{
+    /* The mutex must be locked by the caller. */
+    fz_rect *mbox = self->media_boxes + pageno;
+    int *rotate = self->page_rotates + pageno;
+    fz_obj *page_obj, *box_obj;
+
+    if (self->page_infos[pageno])
+        return;
+
+    *mbox = fz_empty_rect;
+    *rotate = 0;
+
+    page_obj = _pdf_doc_get_page_obj(self, pageno);
+    if (!page_obj) {
+        self->page_infos[pageno] = 1;
+        return;
+    }
+
+    box_obj = fz_dict_gets(page_obj, "MediaBox");
+    *mbox = pdf_to_rect(box_obj);
+    if (fz_is_empty_rect(*mbox)) {
+        fz_warn("Cannot find page bounds, guessing page bounds.");
+        mbox->x1 = 612;
+        mbox->y1 = 792;
+    }
+
+    box_obj = fz_dict_gets(page_obj, "CropBox");
+    if (fz_is_array(box_obj))
+        *mbox = fz_intersect_rect(*mbox, pdf_to_rect(box_obj));
+
+    *rotate = fz_to_int(fz_dict_gets(page_obj, "Rotate"));
+    if (*rotate % 90)
+        *rotate = 0;
+
+    self->page_infos[pageno] = 1;
+}
+
+static void _pdf_doc_ensure_info(struct _pdf_doc *self, int pageno)
+{
+    /* The filler thread writes the infos, so they are only
+     * accessed with the mutex locked. */
+    mume_mutex_lock(self->mutex);
+    _pdf_doc_load_info(self, pageno);
+    mume_mutex_unlock(self->mutex);
+}
+
+static void _pdf_doc_fill_info(void *p)
+{
+    /* Load the page infos ahead of use, the mutex is released
+     * between pages so the other users don't wait long. */
+    struct _pdf_doc *self = p;
+    int i, quit = 0, c = self->page_count;
+
+    for (i = 0; i < c && !quit; ++i) {
+        mume_mutex_lock(self->mutex);
+        quit = self->filler_quit;
+        if (!quit)
+            _pdf_doc_load_info(self, i);
+
+        mume_mutex_unlock(self->mutex);
+    }
+}
+
 static void* _pdf_doc_ctor(
     struct _pdf_doc *self, int mode, va_list *app)
 {
@@ -326,12 +664,14 @@ static void* _pdf_doc_ctor(
         return NULL;
 
     _pdf_doc_reset(self);
+    self->mutex = mume_mutex_new();
     return self;
 }
 
 static void* _pdf_doc_dtor(struct _pdf_doc *self)
 {
     _pdf_doc_clear(self);
+    mume_mutex_delete(self->mutex);
     return _mume_dtor(_pdf_doc_super_class(), self);
 }
 
@@ -339,9 +679,7 @@ static int _pdf_doc_load(struct _pdf_doc *self, mume_stream_t *stm)
 {
     fz_error error;
     fz_stream *fzstm;
-    fz_rect *mbox;
-    fz_obj *page_obj, *box_obj;
-    int i, c;
+    int c;
 
     _pdf_doc_clear(self);
 
@@ -357,78 +695,94 @@ static int _pdf_doc_load(struct _pdf_doc *self, mume_stream_t *stm)
 
     assert(!pdf_needs_password(self->xref));
 
-    /* Load meta information. */
-    error = pdf_load_page_tree(self->xref);
-    if (error) {
+    /* Only take the page count from the page tree, the pages
+     * are looked up when first used. Walk the whole tree as
+     * before if the count is missing or wrong. */
+    c = _pdf_doc_check_count(fz_dict_gets(fz_dict_gets(
+        self->xref->trailer, "Root"), "Pages"));
+    if (c > 0) {
+        _pdf_doc_resize_page_refs(self->xref, c);
+        self->lazy_pages = 1;
+    }
+    else {
+        _pdf_doc_load_page_tree(self);
+        c = pdf_count_pages(self->xref);
+    }
+
+    if (c <= 0) {
         mume_error(("Cannot load page tree\n"));
+        _pdf_doc_clear(self);
         return 0;
     }
 
-    c = pdf_count_pages(self->xref);
+    self->page_count = c;
     self->glyph_cache = fz_new_glyph_cache();
     self->pages = calloc_abort(c, sizeof(pdf_page*));
-    self->disps = calloc_abort(c, sizeof(fz_display_list*));
     self->media_boxes = malloc_abort(c * sizeof(fz_rect));
     self->page_rotates = malloc_abort(c * sizeof(int));
+    self->page_infos = calloc_abort(c, sizeof(char));
 
-    /* Extract each pages' media box and rotation. */
-    for (i = 0; i < c; ++i) {
-        mbox = self->media_boxes + i;
-        page_obj = self->xref->page_objs[i];
-        if (!page_obj) {
-            *mbox = fz_empty_rect;
-            continue;
-        }
+    /* Pages, media boxes and rotations are loaded on demand, so
+     * opening doesn't visit every page. Large documents fill the
+     * rest in the background. */
+    if (c > _PDF_DOC_FILL_PAGES)
+        self->filler = mume_thread_new(_pdf_doc_fill_info, self);
 
-        box_obj = fz_dict_gets(page_obj, "MediaBox");
-        *mbox = pdf_to_rect(box_obj);
-        if (fz_is_empty_rect(*mbox)) {
-            fz_warn("Cannot find page bounds, guessing page bounds.");
-            mbox->x1 = 612;
-            mbox->y1 = 792;
-        }
+    return 1;
+}
 
-        box_obj = fz_dict_gets(page_obj, "CropBox");
-        if (fz_is_array(box_obj))
-            *mbox = fz_intersect_rect(*mbox, pdf_to_rect(box_obj));
+static int _pdf_doc_set_stream(struct _pdf_doc *self, mume_stream_t *stm)
+{
+    /* The xref reads on from where the stream replaced is. */
+    fz_stream *fzstm;
 
-        self->page_rotates[i] = fz_to_int(
-            fz_dict_gets(page_obj, "Rotate"));
+    if (NULL == self->xref)
+        return 0;
 
-        if (self->page_rotates[i] % 90)
-            self->page_rotates[i] = 0;
+    mume_mutex_lock(self->mutex);
+    fzstm = self->xref->file;
+    if (!mume_stream_seek(stm, mume_stream_tell(fzstm->state))) {
+        mume_mutex_unlock(self->mutex);
+        return 0;
     }
 
+    mume_stream_reference(stm);
+    mume_stream_close(fzstm->state);
+    fzstm->state = stm;
+    mume_mutex_unlock(self->mutex);
     return 1;
 }
 
 static const char* _pdf_doc_title(struct _pdf_doc *self)
 {
+    const char *title = NULL;
+
     if (self->xref) {
         fz_obj *info, *obj;
+        mume_mutex_lock(self->mutex);
         info = fz_dict_gets(self->xref->trailer, "Info");
         if (info) {
             obj = fz_dict_gets(info, "Title");
             if (obj)
-                return pdf_to_utf8(obj);
+                title = pdf_to_utf8(obj);
         }
+
+        mume_mutex_unlock(self->mutex);
     }
 
-    return NULL;
+    return title;
 }
 
 static int _pdf_doc_count_pages(const struct _pdf_doc *self)
 {
-    if (self->xref)
-        return pdf_count_pages(self->xref);
-
-    return 0;
+    return self->page_count;
 }
 
 static mume_rect_t _pdf_doc_get_mediabox(
     struct _pdf_doc *self, int pageno)
 {
     mume_rect_t rect;
+    _pdf_doc_ensure_info(self, pageno);
     rect.x = self->media_boxes[pageno].x0;
     rect.y = self->media_boxes[pageno].y0;
     rect.width = self->media_boxes[pageno].x1 - rect.x;
@@ -441,8 +795,12 @@ static mume_matrix_t _pdf_doc_get_matrix(
 {
     mume_matrix_t m;
     fz_matrix ctm = fz_identity;
-    fz_rect mbox = self->media_boxes[pageno];
-    int rotation = (self->page_rotates[pageno] + rotate) % 360;
+    fz_rect mbox;
+    int rotation;
+
+    _pdf_doc_ensure_info(self, pageno);
+    mbox = self->media_boxes[pageno];
+    rotation = (self->page_rotates[pageno] + rotate) % 360;
     if (rotation < 0)
         rotation = rotation + 360;
 
@@ -471,12 +829,16 @@ static mume_matrix_t _pdf_doc_get_matrix(
     return m;
 }
 
-static int _pdf_doc_text_length(struct _pdf_doc *self, int pageno)
+static int _pdf_doc_get_text(
+    struct _pdf_doc *self, int pageno,
+    char **tbuf, mume_rect_t **rbuf)
 {
     fz_display_list *list;
     fz_text_span *text, *span;
     fz_device *tdev;
-    int length = 0;
+    char *t;
+    mume_rect_t *r;
+    int i, length = 0;
 
     list = _pdf_doc_get_list(self, pageno);
     text = fz_new_text_span();
@@ -493,97 +855,170 @@ static int _pdf_doc_text_length(struct _pdf_doc *self, int pageno)
         length += 1;
     }
 
+    *tbuf = NULL;
+    *rbuf = NULL;
+
+    if (length > 0) {
+        t = *tbuf = malloc_abort(length * sizeof(**tbuf));
+        r = *rbuf = malloc_abort(length * sizeof(**rbuf));
+
+        for (span = text; span; span = span->next) {
+            for (i = 0; i < span->len; i++) {
+                *t = span->text[i].c;
+
+                if (*t < 32)
+                    *t = '?';
+
+                t++;
+                *r++ = _fz_bbox_to_mume_rect(span->text[i].bbox);
+            }
+
+            if (!span->eol && span->next)
+                continue;
+
+            *t++ = '\n';
+            *r++ = mume_rect_empty;
+        }
+    }
+
     fz_free_device(tdev);
     fz_free_text_span(text);
 
     return length;
 }
 
+static int _pdf_doc_text_length(struct _pdf_doc *self, int pageno)
+{
+    char *tbuf;
+    mume_rect_t *rbuf;
+    int length;
+
+    length = _pdf_doc_get_text(self, pageno, &tbuf, &rbuf);
+    free(tbuf);
+    free(rbuf);
+    return length;
+}
+
 static void _pdf_doc_extract_text(
     struct _pdf_doc *self, int pageno, char *tbuf, mume_rect_t *rbuf)
 {
-    fz_display_list *list;
-    fz_text_span *text, *span;
-    fz_device *tdev;
-    int i;
+    char *t;
+    mume_rect_t *r;
+    int length;
+
+    length = _pdf_doc_get_text(self, pageno, &t, &r);
+    if (length > 0) {
+        memcpy(tbuf, t, length * sizeof(*t));
+        memcpy(rbuf, r, length * sizeof(*r));
+    }
 
-    list = _pdf_doc_get_list(self, pageno);
-    text = fz_new_text_span();
-    tdev = fz_new_text_device(text);
-    fz_execute_display_list(
-        list, tdev, fz_identity, fz_infinite_bbox);
+    free(t);
+    free(r);
+}
 
-    for (span = text; span; span = span->next) {
-        for (i = 0; i < span->len; i++) {
-            *tbuf = span->text[i].c;
+/* Get a pixmap of at least <width> x <height> to render into.
+ * The pixmap and its cairo surface are kept between calls, so
+ * that exposing doesn't allocate and wrap a new one each time. */
+static fz_pixmap* _pdf_doc_get_pixmap(
+    struct _pdf_doc *self, int width, int height)
+{
+    fz_colorspace *colorspace;
+    fz_pixmap *pixmap = self->pixmap;
+    fz_bbox bbox;
 
-            if (*tbuf < 32)
-                *tbuf = '?';
+    /* Reuse the pixmap unless it is too small or far too large,
+     * for the unused area still costs memory and drawing time. */
+    if (pixmap && pixmap->w >= width && pixmap->h >= height &&
+        pixmap->w * pixmap->h <= 4 * width * height)
+    {
+        return pixmap;
+    }
 
-            tbuf++;
-            *rbuf++ = _fz_bbox_to_mume_rect(span->text[i].bbox);
-        }
+    if (self->surface) {
+        cairo_surface_destroy(self->surface);
+        self->surface = NULL;
+    }
 
-        if (!span->eol && span->next)
-            continue;
+    if (self->pixmap) {
+        fz_drop_pixmap(self->pixmap);
+        self->pixmap = NULL;
+    }
+
+#ifdef _WIN32
+    colorspace = fz_device_bgr;
+#else
+    colorspace = fz_device_rgb;
+#endif
 
-        *tbuf++ = '\n';
-        *rbuf++ = mume_rect_empty;
+    bbox.x0 = 0;
+    bbox.y0 = 0;
+    bbox.x1 = width;
+    bbox.y1 = height;
+    pixmap = fz_new_pixmap_with_rect(colorspace, bbox);
+    if (NULL == pixmap) {
+        mume_error(("fz_new_pixmap_with_rect(%d, %d)\n",
+                    width, height));
+        return NULL;
     }
 
-    fz_free_device(tdev);
-    fz_free_text_span(text);
+    self->surface = cairo_image_surface_create_for_data(
+        pixmap->samples, CAIRO_FORMAT_ARGB32, pixmap->w, pixmap->h,
+        cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, pixmap->w));
+
+    if (cairo_surface_status(self->surface) != CAIRO_STATUS_SUCCESS) {
+        mume_error(("cairo_image_surface_create_for_data(%d, %d)\n",
+                    pixmap->w, pixmap->h));
+        cairo_surface_destroy(self->surface);
+        self->surface = NULL;
+        fz_drop_pixmap(pixmap);
+        return NULL;
+    }
+
+    self->pixmap = pixmap;
+    return pixmap;
 }
 
 static void _pdf_doc_render_page(
     struct _pdf_doc *self, cairo_t *cr, int x, int y,
     int pageno, mume_matrix_t ctm, mume_rect_t rect)
 {
-    /* TODO: implement a fz_device to rendering directly to cairo. */
-    fz_colorspace *colorspace;
     fz_bbox bbox;
     fz_device *idev;
     fz_pixmap *pixmap;
     fz_display_list *list;
-    cairo_format_t format;
-    cairo_surface_t *surface;
-    int stride;
+    int i, stride;
 
-#ifdef _WIN32
-    colorspace = fz_device_bgr;
-#else
-    colorspace = fz_device_rgb;
-#endif
+    if (rect.width <= 0 || rect.height <= 0)
+        return;
 
     list = _pdf_doc_get_list(self, pageno);
-    bbox = _mume_rect_to_fz_bbox(rect);
-    pixmap = fz_new_pixmap_with_rect(colorspace, bbox);
-    if (NULL == pixmap) {
-        mume_error(("fz_new_pixmap_with_rect(%d, %d, %d, %d)\n",
-                    bbox.x0, bbox.y0, bbox.x1, bbox.y1));
+    pixmap = _pdf_doc_get_pixmap(self, rect.width, rect.height);
+    if (NULL == pixmap)
         return;
+
+    /* Move the pixmap to the rendering area, and only clear the
+     * part that will be shown. */
+    bbox = _mume_rect_to_fz_bbox(rect);
+    pixmap->x = bbox.x0;
+    pixmap->y = bbox.y0;
+    stride = pixmap->w * pixmap->n;
+    for (i = 0; i < rect.height; ++i) {
+        memset(pixmap->samples + i * stride, 255,
+               rect.width * pixmap->n);
     }
 
-    fz_clear_pixmap_with_color(pixmap, 255);
     idev = fz_new_draw_device(self->glyph_cache, pixmap);
     fz_execute_display_list(
         list, idev, _mume_matrix_to_fz_matrix(ctm), bbox);
     fz_free_device(idev);
 
-    /* Create cairo surface. */
-    format = CAIRO_FORMAT_ARGB32;
-    stride = cairo_format_stride_for_width(format, pixmap->w);
-    surface = cairo_image_surface_create_for_data(
-        pixmap->samples, format, pixmap->w, pixmap->h, stride);
-
-    if (surface) {
-        cairo_set_source_surface(cr, surface, x, y);
-        cairo_rectangle(cr, x, y, rect.width, rect.height);
-        cairo_fill(cr);
-        cairo_surface_destroy(surface);
-    }
+    cairo_surface_mark_dirty(self->surface);
+    cairo_set_source_surface(cr, self->surface, x, y);
+    cairo_rectangle(cr, x, y, rect.width, rect.height);
+    cairo_fill(cr);
 
-    fz_drop_pixmap(pixmap);
+    /* Release the surface from the source of <cr>. */
+    cairo_set_source_rgb(cr, 0, 0, 0);
 }
 
 static mume_tocitem_t* _pdf_doc_get_toc_tree(struct _pdf_doc *self)
@@ -591,12 +1026,14 @@ static mume_tocitem_t* _pdf_doc_get_toc_tree(struct _pdf_doc *self)
     pdf_outline *outline;
     mume_tocitem_t *item = NULL;
 
+    mume_mutex_lock(self->mutex);
     outline = pdf_load_outline(self->xref);
     if (outline) {
         item = _pdf_doc_build_toc_tree(self, NULL, outline);
         pdf_free_outline(outline);
     }
 
+    mume_mutex_unlock(self->mutex);
     return item;
 }
 
@@ -611,6 +1048,7 @@ static mume_doclink_t* _pdf_doc_get_page_links(
     mume_doclink_t *first = NULL;
     mume_doclink_t *node = NULL;
 
+    mume_mutex_lock(self->mutex);
     page = _pdf_doc_get_page(self, pageno);
     for (link = page->links; link; link = link->next) {
         sr = _fz_rect_to_mume_rect(link->rect);
@@ -623,6 +1061,7 @@ static mume_doclink_t* _pdf_doc_get_page_links(
             first = node;
     }
 
+    mume_mutex_unlock(self->mutex);
     return first;
 }
 
@@ -653,11 +1092,15 @@ const void* mume_pdf_doc_class(void)
         _pdf_doc_text_length,
         _mume_docdoc_extract_text,
         _pdf_doc_extract_text,
+        _mume_docdoc_get_text,
+        _pdf_doc_get_text,
         _mume_docdoc_render_page,
         _pdf_doc_render_page,
         _mume_docdoc_get_toc_tree,
         _pdf_doc_get_toc_tree,
         _mume_docdoc_get_page_links,
         _pdf_doc_get_page_links,
+        _mume_docdoc_set_stream,
+        _pdf_doc_set_stream,
         MUME_FUNC_END);
 }
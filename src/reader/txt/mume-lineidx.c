@@ -0,0 +1,463 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-txt-doc.h"
+#include "mume-lineidx.h"
+#include MUME_ASSERT_H
+#include MUME_STRING_H
+
+/* Bytes read from the stream at a time. */
+#define _LINEIDX_BLOCK_SIZE (8 * 1024 * 1024)
+
+/* A block is split into slices of at least this size, and each
+ * slice is scanned by its own worker thread. */
+#define _LINEIDX_SLICE_SIZE (1024 * 1024)
+#define _LINEIDX_MAX_THREADS 4
+
+/* How line breaks are encoded. */
+struct _breaks {
+    int unit;                   /* Bytes of a character. */
+    int low;                    /* Byte of the ASCII code in a unit. */
+    char nl;
+    char cr;
+};
+
+struct _slice {
+    const struct _breaks *breaks;
+    const char *block;
+    const char *begin;
+    const char *end;
+    const char *limit;          /* End of the block. */
+    uint32_t *starts;           /* Line starts in the block. */
+    size_t count;
+    size_t capacity;
+};
+
+static void _slice_push(struct _slice *self, const char *p)
+{
+    if (self->count == self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 1024;
+        self->starts = realloc_abort(
+            self->starts, self->capacity * sizeof(uint32_t));
+    }
+
+    self->starts[self->count++] = p - self->block;
+}
+
+static void _breaks_init(struct _breaks *self, int encoding)
+{
+    self->unit = 1;
+    self->low = 0;
+    self->nl = '\n';
+    self->cr = '\r';
+
+    switch (encoding) {
+    case MUME_ENCODING_UTF16_LE:
+        self->unit = 2;
+        break;
+
+    case MUME_ENCODING_UTF16_BE:
+        self->unit = 2;
+        self->low = 1;
+        break;
+
+    case MUME_ENCODING_EBCDIC:
+    case MUME_ENCODING_INTERNATIONAL_EBCDIC:
+        self->nl = 0x25;
+        self->cr = 0x0d;
+        break;
+    }
+}
+
+/* Whether the character at <p> is <c>, <p> must be the start of a
+ * character. */
+static int _breaks_is(
+    const struct _breaks *self, const char *p, const char *limit, char c)
+{
+    if (limit - p < self->unit || p[self->low] != c)
+        return 0;
+
+    return 1 == self->unit || 0 == p[1 - self->low];
+}
+
+/* Start of the character whose ASCII code byte is at <p>, or NULL
+ * if the byte is a part of another character. */
+static const char* _slice_char(const struct _slice *self, const char *p)
+{
+    const struct _breaks *b = self->breaks;
+
+    if (1 == b->unit)
+        return p;
+
+    p -= b->low;
+    if ((p - self->block) % b->unit ||
+        self->limit - p < b->unit || p[1 - b->low])
+    {
+        return NULL;
+    }
+
+    return p;
+}
+
+static void _slice_scan(void *p)
+{
+    /* Search '\n' and '\r' with memchr separately, which checks
+     * many bytes at a time, and merge the results in order. */
+    struct _slice *self = p;
+    const struct _breaks *b = self->breaks;
+    const char *e = self->end;
+    const char *n = memchr(self->begin, b->nl, e - self->begin);
+    const char *r = memchr(self->begin, b->cr, e - self->begin);
+    const char *c;
+
+    while (n || r) {
+        if (n && (NULL == r || n < r)) {
+            if ((c = _slice_char(self, n)))
+                _slice_push(self, c + b->unit);
+
+            n = memchr(n + 1, b->nl, e - n - 1);
+        }
+        else {
+            /* The line after "\r\n" is pushed at the '\n', and a
+             * '\r' ending the block depends on the next block. */
+            if ((c = _slice_char(self, r)) &&
+                self->limit - c >= 2 * b->unit &&
+                !_breaks_is(b, c + b->unit, self->limit, b->nl))
+            {
+                _slice_push(self, c + b->unit);
+            }
+
+            r = memchr(r + 1, b->cr, e - r - 1);
+        }
+    }
+}
+
+/* A thread scanning a slice of each block, it is started for the
+ * first block needing it and kept until the whole scan ends. */
+struct _worker {
+    struct _slice *slice;
+    mume_thread_t *thread;
+    mume_sem_t *start;
+    mume_sem_t *done;
+    int quit;
+};
+
+static void _worker_proc(void *p)
+{
+    struct _worker *self = p;
+
+    for (;;) {
+        mume_sem_wait(self->start);
+        if (self->quit)
+            break;
+
+        _slice_scan(self->slice);
+        mume_sem_post(self->done);
+    }
+}
+
+/* Let the worker scan <slice>, return 0 if it cannot be started. */
+static int _worker_run(struct _worker *self, struct _slice *slice)
+{
+    if (NULL == self->thread) {
+        if (NULL == self->start)
+            self->start = mume_sem_new();
+
+        if (self->start && self->done)
+            self->thread = mume_thread_new(_worker_proc, self);
+
+        if (NULL == self->thread)
+            return 0;
+    }
+
+    self->slice = slice;
+    return mume_sem_post(self->start);
+}
+
+static void _worker_stop(struct _worker *self)
+{
+    if (self->thread) {
+        self->quit = 1;
+        mume_sem_post(self->start);
+        mume_thread_join(self->thread);
+        mume_thread_delete(self->thread);
+    }
+
+    if (self->start)
+        mume_sem_delete(self->start);
+}
+
+static void _lineidx_add(
+    mume_lineidx_t *self, size_t start, size_t *last)
+{
+    *last = start;
+    if (self->count++ % self->stride)
+        return;
+
+    if (self->used == self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 1024;
+        self->starts = realloc_abort(
+            self->starts, self->capacity *
+            (self->wide ? sizeof(uint64_t) : sizeof(uint32_t)));
+    }
+
+    if (self->wide)
+        ((uint64_t*)self->starts)[self->used++] = start;
+    else
+        ((uint32_t*)self->starts)[self->used++] = start;
+}
+
+static void _lineidx_scan_block(
+    mume_lineidx_t *self, const struct _breaks *breaks,
+    const char *block, size_t length,
+    size_t base, struct _slice *slices,
+    struct _worker *workers, size_t *last)
+{
+    int running[_LINEIDX_MAX_THREADS];
+    size_t i, j, n, unit = breaks->unit;
+
+    n = length / _LINEIDX_SLICE_SIZE;
+    n = MAX(MIN(n, _LINEIDX_MAX_THREADS), 1);
+
+    /* Slices are split at character boundaries. */
+    for (i = 0; i < n; ++i) {
+        slices[i].breaks = breaks;
+        slices[i].block = block;
+        slices[i].begin = block + length * i / n / unit * unit;
+        slices[i].end = block + length * (i + 1) / n / unit * unit;
+        slices[i].limit = block + length;
+        slices[i].count = 0;
+    }
+
+    slices[n - 1].end = block + length;
+
+    /* The first slice is scanned by the calling thread. */
+    for (i = 1; i < n; ++i)
+        running[i] = _worker_run(workers + i, slices + i);
+
+    _slice_scan(slices);
+
+    for (i = 1; i < n; ++i) {
+        if (running[i])
+            mume_sem_wait(workers[i].done);
+        else
+            _slice_scan(slices + i);
+    }
+
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < slices[i].count; ++j)
+            _lineidx_add(self, base + slices[i].starts[j], last);
+    }
+}
+
+mume_lineidx_t* mume_lineidx_ctor(mume_lineidx_t *self, size_t stride)
+{
+    assert(stride > 0);
+
+    self->starts = NULL;
+    self->used = 0;
+    self->capacity = 0;
+    self->stride = stride;
+    self->count = 0;
+    self->length = 0;
+    self->wide = 0;
+    self->encoding = MUME_ENCODING_UNKNOWN;
+    return self;
+}
+
+mume_lineidx_t* mume_lineidx_dtor(mume_lineidx_t *self)
+{
+    free(self->starts);
+    return self;
+}
+
+/* Get the block at <offset>, read into <buffer>, or in place if
+ * <buffer> is NULL and the stream is mapped. */
+static size_t _lineidx_next_block(
+    mume_stream_t *stm, char *buffer, size_t offset, const char **block)
+{
+    size_t count;
+
+    if (buffer) {
+        *block = buffer;
+        return mume_stream_read(stm, buffer, _LINEIDX_BLOCK_SIZE);
+    }
+
+    count = MIN(mume_stream_length(stm) - offset, _LINEIDX_BLOCK_SIZE);
+    *block = mume_stream_peek(stm, offset, count);
+    return *block ? count : 0;
+}
+
+/* Scan the lines of <stm> from its current position <offset>, the
+ * text before ends with a '\r' if <pending_cr>, and <last> is the
+ * start of the last line added. */
+static void _lineidx_scan(
+    mume_lineidx_t *self, mume_stream_t *stm,
+    size_t offset, int pending_cr, size_t last)
+{
+    struct _slice slices[_LINEIDX_MAX_THREADS];
+    struct _worker workers[_LINEIDX_MAX_THREADS];
+    struct _breaks breaks;
+    const char *block;
+    char *buffer = NULL;
+    mume_sem_t *done = NULL;
+    size_t i, count;
+
+    _breaks_init(&breaks, self->encoding);
+    memset(slices, 0, sizeof(slices));
+    memset(workers, 0, sizeof(workers));
+
+    /* All the workers post the same semaphore when done, which is
+     * only needed if a block has several slices. */
+    if (mume_stream_length(stm) - offset >= 2 * _LINEIDX_SLICE_SIZE)
+        done = mume_sem_new();
+
+    for (i = 0; i < COUNT_OF(workers); ++i)
+        workers[i].done = done;
+
+    if (NULL == mume_stream_peek(stm, offset, 0))
+        buffer = malloc_abort(_LINEIDX_BLOCK_SIZE);
+
+    while ((count = _lineidx_next_block(stm, buffer, offset, &block))) {
+        if (pending_cr &&
+            !_breaks_is(&breaks, block, block + count, breaks.nl))
+        {
+            _lineidx_add(self, offset, &last);
+        }
+
+        _lineidx_scan_block(
+            self, &breaks, block, count, offset,
+            slices, workers, &last);
+
+        pending_cr = count >= breaks.unit && _breaks_is(
+            &breaks, block + count - breaks.unit,
+            block + count, breaks.cr);
+
+        offset += count;
+    }
+
+    /* A line starting at the end is empty, don't count it. */
+    if (last == offset) {
+        if (0 == --self->count % self->stride)
+            --self->used;
+    }
+
+    self->length = offset;
+
+    for (i = 0; i < COUNT_OF(slices); ++i) {
+        _worker_stop(workers + i);
+        free(slices[i].starts);
+    }
+
+    if (done)
+        mume_sem_delete(done);
+
+    free(buffer);
+}
+
+static void _lineidx_widen(mume_lineidx_t *self)
+{
+    uint64_t *starts;
+    size_t i;
+
+    starts = malloc_abort(MAX(self->capacity, 1) * sizeof(uint64_t));
+    for (i = 0; i < self->used; ++i)
+        starts[i] = ((uint32_t*)self->starts)[i];
+
+    free(self->starts);
+    self->starts = starts;
+    self->wide = 1;
+}
+
+int mume_lineidx_build(mume_lineidx_t *self, mume_stream_t *stm)
+{
+    size_t last;
+    int encoding = self->encoding;
+
+    free(self->starts);
+    mume_lineidx_ctor(self, self->stride);
+    self->encoding = encoding;
+
+    if (!mume_stream_seek(stm, 0))
+        return 0;
+
+    self->wide = mume_stream_length(stm) > (uint32_t)-1;
+    _lineidx_add(self, 0, &last);
+    _lineidx_scan(self, stm, 0, 0, last);
+    return 1;
+}
+
+int mume_lineidx_extend(mume_lineidx_t *self, mume_stream_t *stm)
+{
+    struct _breaks breaks;
+    char tail[2];
+    size_t length = mume_stream_length(stm);
+    size_t last = (size_t)-1;
+    int pending_cr = 0;
+
+    if (length < self->length)
+        return 0;
+
+    if (length == self->length)
+        return 1;
+
+    if (!self->wide && length > (uint32_t)-1)
+        _lineidx_widen(self);
+
+    /* The empty line dropped at the end of the text is a line now,
+     * and so is the one after a '\r' unless '\n' follows. */
+    _breaks_init(&breaks, self->encoding);
+    if (self->length < (size_t)breaks.unit) {
+        if (0 == self->count)
+            _lineidx_add(self, 0, &last);
+    }
+    else {
+        if (!mume_stream_seek(stm, self->length - breaks.unit) ||
+            mume_stream_read(stm, tail, breaks.unit) != breaks.unit)
+        {
+            return 0;
+        }
+
+        if (_breaks_is(&breaks, tail, tail + breaks.unit, breaks.nl)) {
+            _lineidx_add(self, self->length, &last);
+        }
+        else {
+            pending_cr = _breaks_is(
+                &breaks, tail, tail + breaks.unit, breaks.cr);
+        }
+    }
+
+    if (!mume_stream_seek(stm, self->length))
+        return 0;
+
+    _lineidx_scan(self, stm, self->length, pending_cr, last);
+    return 1;
+}
+
+size_t mume_lineidx_start(const mume_lineidx_t *self, size_t lineno)
+{
+    if (lineno >= self->count)
+        return self->length;
+
+    assert(0 == lineno % self->stride);
+    lineno /= self->stride;
+
+    if (self->wide)
+        return ((const uint64_t*)self->starts)[lineno];
+
+    return ((const uint32_t*)self->starts)[lineno];
+}
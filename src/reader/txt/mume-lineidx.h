@@ -0,0 +1,93 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MUME_READER_LINEIDX_H
+#define MUME_READER_LINEIDX_H
+
+/* The line index records the start offset of every <stride> lines
+ * of a text stream, the lines in between are found by scanning from
+ * the nearest recorded one. Lines are separated by "\n", "\r" or
+ * "\r\n" in the text encoding. The stream is scanned in large
+ * blocks, and the slices of a block are scanned in parallel.
+ * Offsets are stored in 32 bits unless the stream is larger
+ * than 4GB. */
+
+#include "mume-txt-def.h"
+
+MUME_BEGIN_DECLS
+
+typedef struct mume_lineidx_s mume_lineidx_t;
+
+struct mume_lineidx_s {
+    void *starts;               /* Start offset of every <stride> lines. */
+    size_t used;                /* Number of offsets in <starts>. */
+    size_t capacity;
+    size_t stride;
+    size_t count;               /* Number of lines. */
+    size_t length;              /* Length of the text. */
+    int wide;                   /* Offsets are 64 bits. */
+    int encoding;               /* Encoding of the text. */
+};
+
+/* Record one of every <stride> lines, or all the lines if
+ * <stride> is 1. */
+mutxt_public mume_lineidx_t* mume_lineidx_ctor(
+    mume_lineidx_t *self, size_t stride);
+
+mutxt_public mume_lineidx_t* mume_lineidx_dtor(mume_lineidx_t *self);
+
+/* Scan all the lines of <stm> from the beginning, replacing the
+ * previous index. Return zero if the stream can't be read. */
+mutxt_public int mume_lineidx_build(
+    mume_lineidx_t *self, mume_stream_t *stm);
+
+/* Scan the text appended to <stm> since the index is built or
+ * extended, adding its lines without scanning the text before.
+ * Return zero if the stream is truncated or can't be read. */
+mutxt_public int mume_lineidx_extend(
+    mume_lineidx_t *self, mume_stream_t *stm);
+
+/* Start offset of the line <lineno>, which must be a multiple of
+ * the stride, or the text length if <lineno> is the line count. */
+mutxt_public size_t mume_lineidx_start(
+    const mume_lineidx_t *self, size_t lineno);
+
+#define mume_lineidx_new(_stride) \
+    mume_lineidx_ctor(malloc_struct(mume_lineidx_t), _stride)
+
+#define mume_lineidx_delete(_self) \
+    free(mume_lineidx_dtor(_self))
+
+#define mume_lineidx_count(_self) ((_self)->count)
+
+#define mume_lineidx_stride(_self) ((_self)->stride)
+
+#define mume_lineidx_length(_self) ((_self)->length)
+
+/* Line breaks are searched as the characters of <_encoding> (one of
+ * mume_encoding_e), ASCII by default. Set before building. */
+#define mume_lineidx_set_encoding(_self, _encoding) \
+    ((_self)->encoding = (_encoding))
+
+/* Bytes used by the index. */
+#define mume_lineidx_size(_self) \
+    (sizeof(mume_lineidx_t) + (_self)->capacity * \
+     ((_self)->wide ? sizeof(uint64_t) : sizeof(uint32_t)))
+
+MUME_END_DECLS
+
+#endif /* MUME_READER_LINEIDX_H */
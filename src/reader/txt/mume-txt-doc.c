@@ -16,9 +16,22 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mume-txt-doc.h"
+#include "mume-lineidx.h"
+#include MUME_STRING_H
+#include <sys/stat.h>
 
 #define _TXT_DOC_PAGE_LINE_COUNT 50
 
+/* Only the start of every 4 pages is kept in the line index, the
+ * lines in between are found when the block of 4 pages is read. */
+#define _TXT_DOC_BLOCK_LINE_COUNT (_TXT_DOC_PAGE_LINE_COUNT * 4)
+
+/* Memory budget of the line blocks read and the lines shaped. */
+#define _TXT_DOC_BLOCK_BUDGET (8 * 1024 * 1024)
+
+/* Bytes checked to detect the text encoding. */
+#define _TXT_DOC_SAMPLE_SIZE (64 * 1024)
+
 /* Default page size. */
 #define _TXT_DOC_PAGE_WIDTH 612
 #define _TXT_DOC_PAGE_HEIGHT 792
@@ -35,37 +48,103 @@
 
 #define _txt_doc_super_class mume_docdoc_class
 
-struct _line_info {
-    size_t offset;
-    size_t length;
+/* Lines between two recorded starts of the line index. */
+struct _line_block {
+    int count;
+    size_t *starts;               /* Start of each line and the end. */
     char *text;
 };
 
+/* Start of a page when the lines are reflowed. */
+struct _page_start {
+    int lineno;
+    int offset;                   /* Byte offset in the line. */
+    int widest;                   /* Widest line of the page. */
+    int wrapped;                  /* Some line of the page is wrapped. */
+};
+
+/* A line shaped in a single row, it is cached with the key (font
+ * face, font size, line number) and shared by measuring, wrapping,
+ * text extraction and drawing. Zooming only changes the ctm, so the
+ * line is not shaped again. */
+struct _shaped_line {
+    int length;
+    int width;
+    int glyph_count;
+    cairo_glyph_t *glyphs;        /* Relative to the line's top left. */
+    mume_rect_t *rects;           /* Rect of each byte. */
+    int *clusters;                /* Byte of each glyph. */
+};
+
+/* A row of text in a page. */
+struct _text_row {
+    const char *text;
+    int length;
+    int lineno;
+    int offset;                   /* Byte offset in the line. */
+    int joined;                   /* Wrapped from the previous row. */
+};
+
 struct _txt_doc {
     const char _[MUME_SIZEOF_DOCDOC];
     mume_stream_t *stm;
-    mume_vector_t *lines;
+    mume_lineidx_t *lines;
+    int encoding;                 /* Text encoding of the stream. */
+    size_t bom;                   /* Size of the byte order mark. */
+    mume_pagecache_t *blocks;     /* Line blocks and shaped lines. */
+    mume_mutex_t *mutex;          /* Serialize the line reads. */
     mume_rect_t *media_boxes;     /* Media boxes buffer. */
+    mume_filemon_t *monitor;      /* Follow the file's growth. */
+    dev_t file_dev;               /* File followed. */
+    ino_t file_ino;
+    int reflow_width;             /* Width of the reflowed text. */
+    struct _page_start *pages;    /* Reflowed pages paginated. */
+    int page_count;
+    int page_capacity;
+    int next_line;                /* Start of the next page. */
+    int next_offset;
+    int *breaks;                  /* Rows of the line wrapped. */
+    int break_capacity;
+    void *layout;                 /* Text layout to shape lines. */
 };
 
-static void _line_info_destruct(void *obj, void *p)
-{
-    struct _line_info *line = obj;
-    free(line->text);
-}
-
 static void _txt_doc_reset(struct _txt_doc *self)
 {
     self->stm = NULL;
     self->lines = NULL;
+    self->encoding = MUME_ENCODING_UNKNOWN;
+    self->bom = 0;
+    self->blocks = NULL;
     self->media_boxes = NULL;
+    self->monitor = NULL;
+    self->file_dev = 0;
+    self->file_ino = 0;
+    self->reflow_width = 0;
+    self->pages = NULL;
+    self->page_count = 0;
+    self->page_capacity = 0;
+    self->next_line = 0;
+    self->next_offset = 0;
+    self->breaks = NULL;
+    self->break_capacity = 0;
 }
 
 static void _txt_doc_clear(struct _txt_doc *self)
 {
+    if (self->monitor)
+        mume_filemon_delete(self->monitor);
+
     mume_stream_close(self->stm);
-    mume_vector_delete(self->lines);
+
+    if (self->lines)
+        mume_lineidx_delete(self->lines);
+
+    if (self->blocks)
+        mume_pagecache_delete(self->blocks);
+
     free(self->media_boxes);
+    free(self->pages);
+    free(self->breaks);
 
     _txt_doc_reset(self);
 }
@@ -73,11 +152,19 @@ static void _txt_doc_clear(struct _txt_doc *self)
 static int _txt_doc_line_count(const struct _txt_doc *self)
 {
     if (self->lines)
-        return mume_vector_size(self->lines);
+        return mume_lineidx_count(self->lines);
 
     return 0;
 }
 
+/* Number of pages when the lines are not reflowed. */
+static int _txt_doc_line_pages(const struct _txt_doc *self)
+{
+    int count = _txt_doc_line_count(self);
+    return (count + _TXT_DOC_PAGE_LINE_COUNT - 1) /
+           _TXT_DOC_PAGE_LINE_COUNT;
+}
+
 static void _txt_doc_page_line_range(
     const struct _txt_doc *self, int pageno, int *begin, int *end)
 {
@@ -91,25 +178,164 @@ static void _txt_doc_page_line_range(
     }
 }
 
+static void _txt_doc_detect_encoding(
+    struct _txt_doc *self, mume_stream_t *stm)
+{
+    unsigned char *buf = malloc_abort(_TXT_DOC_SAMPLE_SIZE);
+    size_t count = 0;
+
+    if (mume_stream_seek(stm, 0))
+        count = mume_stream_read(stm, buf, _TXT_DOC_SAMPLE_SIZE);
+
+    self->encoding = mume_encoding_check(buf, count, NULL, NULL);
+    self->bom = mume_encoding_bom_size(self->encoding, buf, count);
+    free(buf);
+}
+
+/* Read the text of [<begin>, <end>) as UTF-8 into <block> of
+ * <size> bytes, the block is resized to fit if the text is
+ * decoded. */
+static struct _line_block* _txt_doc_read_text(
+    const struct _txt_doc *self, struct _line_block *block,
+    size_t size, size_t begin, size_t end, size_t *length)
+{
+    unsigned char *raw;
+    size_t count, used;
+
+    mume_stream_seek(self->stm, begin);
+
+    if (!mume_encoding_need_decode(self->encoding)) {
+        *length = mume_stream_read(self->stm, block->text, end - begin);
+        return block;
+    }
+
+    /* Pages are decoded when read, so opening a file costs the
+     * same whatever its encoding is. */
+    raw = malloc_abort(end - begin);
+    count = mume_stream_read(self->stm, raw, end - begin);
+    *length = mume_encoding_decode(
+        self->encoding, raw, count, &used, block->text);
+
+    free(raw);
+
+    size -= MUME_ENCODING_UTF8_SIZE(end - begin) - *length;
+    block = realloc_abort(block, size);
+    block->starts = (size_t*)(block + 1);
+    block->text = (char*)(block->starts + block->count + 1);
+    return block;
+}
+
+static struct _line_block* _txt_doc_read_block(
+    const struct _txt_doc *self, int blockno)
+{
+    struct _line_block *block;
+    size_t first, last, begin, end, size, i, j;
+    const char *mapped = NULL;
+    char *t;
+
+    first = blockno * mume_lineidx_stride(self->lines);
+    last = first + mume_lineidx_stride(self->lines);
+    last = MIN(last, mume_lineidx_count(self->lines));
+    begin = mume_lineidx_start(self->lines, first);
+    end = mume_lineidx_start(self->lines, last);
+
+    /* Skip the byte order mark of the first line. */
+    begin = MAX(begin, self->bom);
+    end = MAX(end, begin);
+
+    size = sizeof(struct _line_block) +
+           (last - first + 1) * sizeof(size_t);
+
+    if (mume_encoding_need_decode(self->encoding))
+        size += MUME_ENCODING_UTF8_SIZE(end - begin);
+    else if (!(mapped = mume_stream_peek(self->stm, begin, end - begin)))
+        size += end - begin;
+
+    block = malloc_abort(size);
+    block->count = last - first;
+    block->starts = (size_t*)(block + 1);
+
+    if (mapped) {
+        /* The text of a mapped file is used in place, and is never
+         * written through the block. */
+        block->text = (char*)mapped;
+        end -= begin;
+    }
+    else {
+        block->text = (char*)(block->starts + block->count + 1);
+        block = _txt_doc_read_text(self, block, size, begin, end, &end);
+        size = (block->text + end) - (char*)block;
+    }
+
+    t = block->text;
+
+    /* Split the lines the same way the index does. */
+    block->starts[0] = 0;
+    for (i = 1, j = 0; j < end && i < block->count; ++j) {
+        if ('\n' == t[j] ||
+            ('\r' == t[j] && (j + 1 == end || t[j + 1] != '\n')))
+        {
+            block->starts[i++] = j + 1;
+        }
+    }
+
+    /* The lines are missing if the stream is changed. */
+    for (; i <= block->count; ++i)
+        block->starts[i] = end;
+
+    mume_pagecache_insert(
+        self->blocks, self, 0, blockno, block, size, free);
+
+    return block;
+}
+
+static void _txt_doc_begin_lines(const struct _txt_doc *self)
+{
+    /* Line texts are valid until _txt_doc_end_lines. Blocks read
+     * before are evicted here when over budget, none of them is
+     * in use now. */
+    mume_mutex_lock(self->mutex);
+    mume_pagecache_trim(self->blocks, NULL);
+}
+
+static void _txt_doc_end_lines(const struct _txt_doc *self)
+{
+    mume_mutex_unlock(self->mutex);
+}
+
 static const char* _txt_doc_get_line_text(
     const struct _txt_doc *self, int lineno, int *len)
 {
-    struct _line_info *line;
+    /* Must be called between _txt_doc_begin_lines and
+     * _txt_doc_end_lines. */
+    struct _line_block *block;
+    size_t begin, end;
+    int i, blockno;
 
     assert(lineno < _txt_doc_line_count(self));
-    line = mume_vector_at(self->lines, lineno);
 
-    if (len)
-        *len = line->length;
+    blockno = lineno / mume_lineidx_stride(self->lines);
+    if (!mume_pagecache_find(
+            self->blocks, self, 0, blockno, (void**)&block))
+    {
+        block = _txt_doc_read_block(self, blockno);
+    }
 
-    if (line->text)
-        return line->text;
+    i = lineno % mume_lineidx_stride(self->lines);
+    begin = block->starts[i];
+    end = block->starts[i + 1];
 
-    line->text = malloc_abort(line->length);
-    mume_stream_seek(self->stm, line->offset);
-    mume_stream_read(self->stm, line->text, line->length);
+    /* Drop the line break. */
+    if (end > begin && '\n' == block->text[end - 1])
+        --end;
 
-    return line->text;
+    if (end > begin && '\r' == block->text[end - 1])
+        --end;
+
+    if (len)
+        *len = end - begin;
+
+    return block->text + begin;
 }
 
 static mume_resobj_charfmt_t* _txt_doc_get_charfmt(
@@ -125,6 +351,197 @@ static mume_resobj_charfmt_t* _txt_doc_get_charfmt(
     return cf;
 }
 
+/* Get the line <lineno> shaped with <cf>. Must be called between
+ * _txt_doc_begin_lines and _txt_doc_end_lines. */
+static const struct _shaped_line* _txt_doc_get_shaped_line(
+    const struct _txt_doc *self, mume_resobj_charfmt_t *cf, int lineno)
+{
+    struct _shaped_line *sl;
+    const char *t;
+    size_t size;
+    int n, count;
+
+    if (mume_pagecache_find(
+            self->blocks, cf->p->p, cf->size, lineno, (void**)&sl))
+    {
+        return sl;
+    }
+
+    t = _txt_doc_get_line_text(self, lineno, &n);
+    mume_text_layout_reset(self->layout);
+    mume_text_layout_add_text(self->layout, cf->p->p, t, n);
+    mume_text_layout_perform(
+        self->layout, cf->size, NULL, NULL, MUME_TLF_SINGLELINE);
+
+    n = MIN(n, mume_text_layout_get_length(self->layout));
+    count = mume_text_layout_get_glyphs(self->layout, NULL, NULL);
+    size = sizeof(struct _shaped_line) +
+           count * (sizeof(cairo_glyph_t) + sizeof(int)) +
+           n * sizeof(mume_rect_t);
+
+    sl = malloc_abort(size);
+    sl->length = n;
+    sl->glyph_count = count;
+    sl->glyphs = (cairo_glyph_t*)(sl + 1);
+    sl->rects = (mume_rect_t*)(sl->glyphs + count);
+    sl->clusters = (int*)(sl->rects + n);
+    mume_text_layout_get_glyphs(self->layout, sl->glyphs, sl->clusters);
+    memcpy(sl->rects, mume_text_layout_get_rects(self->layout),
+           n * sizeof(mume_rect_t));
+
+    if (n > 0)
+        sl->width = sl->rects[n - 1].x + sl->rects[n - 1].width;
+    else
+        sl->width = 0;
+
+    mume_pagecache_insert(
+        self->blocks, cf->p->p, cf->size, lineno, sl, size, free);
+
+    return sl;
+}
+
+/* Wrap the text <t> of a shaped line from <offset> into rows of the
+ * reflow width, the start of each row relative to <offset> is stored
+ * in <breaks>. Return the number of rows. */
+static int _txt_doc_wrap_line(
+    struct _txt_doc *self, const struct _shaped_line *sl,
+    const char *t, int offset, int *widest)
+{
+    const mume_rect_t *r = sl->rects;
+    int i, right, row, space, count = 1;
+    int n = sl->length;
+
+    if (self->break_capacity < n - offset + 1) {
+        self->break_capacity = n - offset + 1;
+        self->breaks = realloc_abort(
+            self->breaks, self->break_capacity * sizeof(int));
+    }
+
+    self->breaks[0] = 0;
+    row = offset;
+    space = -1;
+    for (i = offset; i < n; ++i) {
+        /* Spaces may hang over the end of a row. */
+        if (' ' == t[i]) {
+            space = i;
+            continue;
+        }
+
+        right = r[i].x + r[i].width - r[row].x;
+        if (right > self->reflow_width && i > row) {
+            /* Break after the last space, or at the character. */
+            row = space > row ? space + 1 : i;
+            self->breaks[count++] = row - offset;
+            right = r[i].x + r[i].width - r[row].x;
+            space = -1;
+        }
+
+        *widest = MAX(*widest, right);
+    }
+
+    return count;
+}
+
+/* Get the rows of the page <pageno>, the row texts are valid until
+ * _txt_doc_end_lines. Return the number of rows. */
+static int _txt_doc_page_rows(
+    struct _txt_doc *self, mume_resobj_charfmt_t *cf,
+    int pageno, struct _text_row *rows)
+{
+    const struct _shaped_line *sl;
+    const char *t;
+    int i, e, k, n, length, offset, widest = 0;
+    int count = 0;
+
+    if (0 == self->reflow_width) {
+        _txt_doc_page_line_range(self, pageno, &i, &e);
+        for (; i < e; ++i, ++count) {
+            rows[count].text = _txt_doc_get_line_text(
+                self, i, &rows[count].length);
+            rows[count].lineno = i;
+            rows[count].offset = 0;
+            rows[count].joined = 0;
+        }
+
+        return count;
+    }
+
+    i = self->pages[pageno].lineno;
+    offset = self->pages[pageno].offset;
+    e = _txt_doc_line_count(self);
+    for (; i < e && count < _TXT_DOC_PAGE_LINE_COUNT; ++i) {
+        sl = _txt_doc_get_shaped_line(self, cf, i);
+        t = _txt_doc_get_line_text(self, i, &length);
+        length = MIN(length, sl->length);
+        n = _txt_doc_wrap_line(self, sl, t, offset, &widest);
+
+        for (k = 0; k < n && count < _TXT_DOC_PAGE_LINE_COUNT; ++k) {
+            rows[count].offset = offset + self->breaks[k];
+            rows[count].text = t + rows[count].offset;
+            rows[count].length = (k + 1 < n ?
+                                  offset + self->breaks[k + 1] :
+                                  length) - rows[count].offset;
+            rows[count].lineno = i;
+            rows[count].joined = k > 0;
+            ++count;
+        }
+
+        offset = 0;
+    }
+
+    return count;
+}
+
+/* Paginate at most <count> more pages of the reflowed lines.
+ * Return nonzero if there are more pages. */
+static int _txt_doc_paginate(
+    struct _txt_doc *self, mume_resobj_charfmt_t *cf, int count)
+{
+    struct _page_start *ps;
+    const struct _shaped_line *sl;
+    const char *t;
+    int rows, k, n;
+    int lines = _txt_doc_line_count(self);
+
+    for (; count > 0 && self->next_line < lines; --count) {
+        if (self->page_count == self->page_capacity) {
+            self->page_capacity = MAX(self->page_capacity * 2, 64);
+            self->pages = realloc_abort(
+                self->pages, self->page_capacity * sizeof(*ps));
+        }
+
+        ps = self->pages + self->page_count++;
+        ps->lineno = self->next_line;
+        ps->offset = self->next_offset;
+        ps->widest = 0;
+        ps->wrapped = 0;
+
+        for (rows = 0; rows < _TXT_DOC_PAGE_LINE_COUNT &&
+                 self->next_line < lines; rows += k)
+        {
+            sl = _txt_doc_get_shaped_line(self, cf, self->next_line);
+            t = _txt_doc_get_line_text(self, self->next_line, NULL);
+            n = _txt_doc_wrap_line(
+                self, sl, t, self->next_offset, &ps->widest);
+
+            if (n > 1)
+                ps->wrapped = 1;
+
+            k = MIN(n, _TXT_DOC_PAGE_LINE_COUNT - rows);
+            if (k < n) {
+                /* The rest of the line goes to the next page. */
+                self->next_offset += self->breaks[k];
+            }
+            else {
+                ++self->next_line;
+                self->next_offset = 0;
+            }
+        }
+    }
+
+    return self->next_line < lines;
+}
+
 static void* _txt_doc_ctor(
     struct _txt_doc *self, int mode, va_list *app)
 {
@@ -132,53 +549,37 @@ static void* _txt_doc_ctor(
         return NULL;
 
     _txt_doc_reset(self);
+    self->mutex = mume_mutex_new();
+    self->layout = mume_text_layout_new();
     return self;
 }
 
 static void* _txt_doc_dtor(struct _txt_doc *self)
 {
     _txt_doc_clear(self);
+    mume_mutex_delete(self->mutex);
+    mume_delete(self->layout);
     return _mume_dtor(_txt_doc_super_class(), self);
 }
 
 static int _txt_doc_load(struct _txt_doc *self, mume_stream_t *stm)
 {
-    char buf[4096];
-    size_t i, count, offset;
-    struct _line_info *line;
+    int i, count;
 
-    self->stm = stm;
-    mume_stream_reference(stm);
-    self->lines = mume_vector_new(
-        sizeof(struct _line_info), _line_info_destruct, NULL);
-
-    /* Get line info. */
-    i = count = offset = 0;
-    line = mume_vector_push_back(self->lines);
-    line->offset = offset;
-    line->length = 0;
-    line->text = NULL;
-
-    while ((count = mume_stream_read(stm, buf, sizeof(buf)))) {
-        for (i = 0; i < count; ++i) {
-            if (buf[i] == '\n' || buf[i] == '\r') {
-                /* The line length not include '\n'. */
-                line->length = offset + i - line->offset;
-                line = mume_vector_push_back(self->lines);
-                if (buf[i] == '\r' && i < count && buf[i + 1] == '\n')
-                    ++i;
-
-                line->offset = offset + i + 1;
-                line->length = count - i - 1;
-                line->text = NULL;
-            }
-        }
+    _txt_doc_clear(self);
+
+    _txt_doc_detect_encoding(self, stm);
 
-        offset += count;
+    self->lines = mume_lineidx_new(_TXT_DOC_BLOCK_LINE_COUNT);
+    mume_lineidx_set_encoding(self->lines, self->encoding);
+    if (!mume_lineidx_build(self->lines, stm)) {
+        _txt_doc_clear(self);
+        return 0;
     }
 
-    if (0 == line->length)
-        mume_vector_pop_back(self->lines);
+    self->stm = stm;
+    mume_stream_reference(stm);
+    self->blocks = mume_pagecache_new(_TXT_DOC_BLOCK_BUDGET);
 
     count = mume_docdoc_count_pages(self);
     self->media_boxes = malloc_abort(sizeof(mume_rect_t) * count);
@@ -195,28 +596,26 @@ static const char* _txt_doc_title(struct _txt_doc *self)
 
 static int _txt_doc_count_pages(const struct _txt_doc *self)
 {
-    if (self->lines) {
-        int count = mume_vector_size(self->lines);
-        if (count % _TXT_DOC_PAGE_LINE_COUNT)
-            return count / _TXT_DOC_PAGE_LINE_COUNT + 1;
-
-        return count / _TXT_DOC_PAGE_LINE_COUNT;
-    }
+    if (self->reflow_width > 0)
+        return self->page_count;
 
-    return 0;
+    return _txt_doc_line_pages(self);
 }
 
 static mume_rect_t _txt_doc_get_mediabox(
     struct _txt_doc *self, int pageno)
 {
-    int i, e, n;
-    const char *t;
+    int i, e;
+    const struct _shaped_line *sl;
     mume_rect_t rr;
     mume_resobj_charfmt_t *cf;
     cairo_font_extents_t font_exts;
 
-    if (!mume_rect_is_infinite(self->media_boxes[pageno]))
+    if (0 == self->reflow_width &&
+        !mume_rect_is_infinite(self->media_boxes[pageno]))
+    {
         return self->media_boxes[pageno];
+    }
 
     rr.x = 0;
     rr.y = 0;
@@ -225,22 +624,29 @@ static mume_rect_t _txt_doc_get_mediabox(
 
     /* Calculate the widest line. */
     cf = _txt_doc_get_charfmt(self);
-    if (NULL == cf)
+    if (!mume_resobj_charfmt_is_valid(cf))
         return rr;
 
     font_exts = mume_charfmt_font_extents(cf);
+
+    /* Reflowed pages are all in the same size. */
+    if (self->reflow_width > 0) {
+        rr.width = self->reflow_width + _TXT_DOC_HBLANK;
+        rr.height = font_exts.height * _TXT_DOC_PAGE_LINE_COUNT +
+                    _TXT_DOC_VBLANK;
+        return rr;
+    }
     _txt_doc_page_line_range(self, pageno, &i, &e);
 
     rr.height = font_exts.height * (e - i) + _TXT_DOC_VBLANK;
     rr.height = MAX(rr.height, _TXT_DOC_PAGE_HEIGHT);
 
+    _txt_doc_begin_lines(self);
     for (; i < e; ++i) {
-        if ((t = _txt_doc_get_line_text(self, i, &n))) {
-            mume_point_t pt;
-            pt = mume_charfmt_text_extents(cf, t, n);
-            rr.width = MAX(rr.width, pt.x + _TXT_DOC_HBLANK);
-        }
+        sl = _txt_doc_get_shaped_line(self, cf, i);
+        rr.width = MAX(rr.width, sl->width + _TXT_DOC_HBLANK);
     }
+    _txt_doc_end_lines(self);
 
     if (rr.width % _TXT_DOC_PAGE_WIDTH_INC) {
         rr.width -= rr.width % _TXT_DOC_PAGE_WIDTH_INC;
@@ -287,20 +693,24 @@ static mume_matrix_t _txt_doc_get_matrix(
 
 static int _txt_doc_text_length(struct _txt_doc *self, int pageno)
 {
-    int i, e, n;
-    const char *t;
-    int length = 0;
+    struct _text_row rows[_TXT_DOC_PAGE_LINE_COUNT];
+    mume_resobj_charfmt_t *cf;
+    int i, count, length = 0;
 
-    _txt_doc_page_line_range(self, pageno, &i, &e);
-    if (e > i) {
-        /* Add '\n' to each middle line. */
-        length += e - i - 1;
+    cf = _txt_doc_get_charfmt(self);
+    if (!mume_resobj_charfmt_is_valid(cf))
+        return 0;
 
-        for (; i < e; ++i) {
-            if ((t = _txt_doc_get_line_text(self, i, &n)))
-                length += n;
-        }
+    _txt_doc_begin_lines(self);
+    count = _txt_doc_page_rows(self, cf, pageno, rows);
+    for (i = 0; i < count; ++i) {
+        /* Add '\n' before each line but the first. */
+        if (i > 0 && !rows[i].joined)
+            ++length;
+
+        length += rows[i].length;
     }
+    _txt_doc_end_lines(self);
 
     return length;
 }
@@ -308,11 +718,11 @@ static int _txt_doc_text_length(struct _txt_doc *self, int pageno)
 static void _txt_doc_extract_text(
     struct _txt_doc *self, int pageno, char *tbuf, mume_rect_t *rbuf)
 {
-    int i, j, e, n;
+    struct _text_row rows[_TXT_DOC_PAGE_LINE_COUNT];
+    const struct _shaped_line *sl;
+    int i, j, count;
     double dx, dy;
-    const char *t;
     const mume_rect_t *r;
-    void *tl = mume_text_layout();
     mume_resobj_charfmt_t *cf;
     cairo_font_extents_t font_extents;
 
@@ -324,43 +734,41 @@ static void _txt_doc_extract_text(
 
     dx = _TXT_DOC_LEFT_BLANK;
     dy = _TXT_DOC_TOP_BLANK;
-    _txt_doc_page_line_range(self, pageno, &i, &e);
-    for (; i < e; ++i) {
-        if ((t = _txt_doc_get_line_text(self, i, &n))) {
-            mume_text_layout_reset(tl);
-            mume_text_layout_add_text(tl, cf->p->p, t, n);
-            mume_text_layout_perform(
-                tl, cf->size, NULL, NULL, MUME_TLF_SINGLELINE);
-
-            r = mume_text_layout_get_rects(tl);
-            for (j = 0; j < n; ++j) {
-                *tbuf = t[j];
-                *rbuf = r[j];
-                rbuf->x += dx;
-                rbuf->y += dy;
-                ++tbuf;
-                ++rbuf;
+    _txt_doc_begin_lines(self);
+    count = _txt_doc_page_rows(self, cf, pageno, rows);
+    for (i = 0; i < count; ++i) {
+        if (i > 0) {
+            /* Add '\n' before each line but the first. */
+            if (!rows[i].joined) {
+                *tbuf++ = '\n';
+                *rbuf++ = mume_rect_empty;
             }
-        }
-
-        if (i != e - 1) {
-            /* Add '\n' to each middle line. */
-            *tbuf++ = '\n';
-            *rbuf++ = mume_rect_empty;
 
             dy += font_extents.height;
         }
+
+        sl = _txt_doc_get_shaped_line(self, cf, rows[i].lineno);
+        r = sl->rects + rows[i].offset;
+        for (j = 0; j < rows[i].length; ++j) {
+            *tbuf = rows[i].text[j];
+            *rbuf = r[j];
+            rbuf->x += dx - r[0].x;
+            rbuf->y += dy;
+            ++tbuf;
+            ++rbuf;
+        }
     }
+    _txt_doc_end_lines(self);
 }
 
 static void _txt_doc_render_page(
     struct _txt_doc *self, cairo_t *cr, int x, int y,
     int pageno, mume_matrix_t ctm, mume_rect_t rect)
 {
-    const char* t;
-    int i, e, n;
+    struct _text_row rows[_TXT_DOC_PAGE_LINE_COUNT];
+    const struct _shaped_line *sl;
+    int i, g, e, count;
     double lx, ly;
-    mume_rect_t r;
     mume_resobj_charfmt_t *cf;
     cairo_font_extents_t font_exts;
     cairo_t *mcr;
@@ -394,21 +802,38 @@ static void _txt_doc_render_page(
     cairo_paint(mcr);
 
     font_exts = mume_charfmt_font_extents(cf);
-    _txt_doc_page_line_range(self, pageno, &i, &e);
 
     lx = _TXT_DOC_LEFT_BLANK;
     ly = _TXT_DOC_TOP_BLANK;
-    for (; i < e; ++i) {
-        if ((t = _txt_doc_get_line_text(self, i, &n))) {
-#define TEXT_FORMAT (MUME_TLF_DRAWTEXT | \
-                     MUME_TLF_SINGLELINE | MUME_TLF_NOCLIP)
-
-            r = mume_rect_make(lx, ly, 0, font_exts.height);
-            mume_charfmt_draw_text(mcr, cf, TEXT_FORMAT, t, n, &r);
-            ly += font_exts.height;
-#undef TEXT_FORMAT
+    _txt_doc_begin_lines(self);
+    count = _txt_doc_page_rows(self, cf, pageno, rows);
+    for (i = 0; i < count; ++i) {
+        sl = _txt_doc_get_shaped_line(self, cf, rows[i].lineno);
+
+        /* Glyphs of the row, the clusters are in text order. */
+        g = 0;
+        while (g < sl->glyph_count &&
+               sl->clusters[g] < rows[i].offset)
+        {
+            ++g;
+        }
+
+        e = g;
+        while (e < sl->glyph_count &&
+               sl->clusters[e] < rows[i].offset + rows[i].length)
+        {
+            ++e;
+        }
+
+        if (e > g) {
+            mume_charfmt_draw_glyphs(
+                mcr, cf, sl->glyphs + g, e - g,
+                lx - sl->rects[rows[i].offset].x, ly);
         }
+
+        ly += font_exts.height;
     }
+    _txt_doc_end_lines(self);
 
     cairo_save(cr);
     cairo_set_source_surface(cr, img, x, y);
@@ -420,6 +845,213 @@ static void _txt_doc_render_page(
     cairo_destroy(mcr);
 }
 
+static int _txt_doc_reflow(struct _txt_doc *self, int width, int count)
+{
+    mume_resobj_charfmt_t *cf;
+    int i, more;
+
+    /* Text is wrapped in the page without the blank region. */
+    if (width > 0)
+        width = MAX(width - _TXT_DOC_HBLANK, 1);
+    else
+        width = 0;
+
+    if (width != self->reflow_width) {
+        /* A page stays the same if none of its lines is wrapped
+         * before and after, the pages after it are paginated
+         * again from its start. */
+        for (i = 0; width > 0 && i < self->page_count; ++i) {
+            if (self->pages[i].wrapped || self->pages[i].widest > width)
+                break;
+        }
+
+        if (0 == width || i < self->page_count) {
+            self->page_count = width > 0 ? i : 0;
+            self->next_line = width > 0 ? self->pages[i].lineno : 0;
+            self->next_offset = width > 0 ? self->pages[i].offset : 0;
+        }
+
+        self->reflow_width = width;
+    }
+
+    if (0 == width || NULL == self->lines)
+        return 0;
+
+    cf = _txt_doc_get_charfmt(self);
+    if (!mume_resobj_charfmt_is_valid(cf))
+        return 0;
+
+    _txt_doc_begin_lines(self);
+    more = _txt_doc_paginate(self, cf, count);
+    _txt_doc_end_lines(self);
+
+    return more;
+}
+
+static int _txt_doc_follow(struct _txt_doc *self, void *window, int code)
+{
+    const char *path = NULL;
+    struct stat st;
+
+    if (self->monitor) {
+        mume_filemon_delete(self->monitor);
+        self->monitor = NULL;
+    }
+
+    if (self->stm)
+        path = mume_file_stream_path(self->stm);
+
+    if (NULL == path)
+        return 0;
+
+    if (window && mume_stream_peek(self->stm, 0, 0)) {
+        /* A mapped file shrunk faults when read, read a file being
+         * followed with stdio instead. */
+        mume_stream_t *stm = mume_file_stream_open(path, MUME_OM_READ);
+        if (NULL == stm)
+            return 0;
+
+        _txt_doc_begin_lines(self);
+        mume_pagecache_invalidate(self->blocks, NULL);
+        mume_stream_close(self->stm);
+        self->stm = stm;
+        _txt_doc_end_lines(self);
+        path = mume_file_stream_path(stm);
+    }
+
+    if (window) {
+        if (stat(path, &st))
+            return 0;
+
+        self->monitor = mume_filemon_new(path, window, code);
+        self->file_dev = st.st_dev;
+        self->file_ino = st.st_ino;
+    }
+
+    return 1;
+}
+
+static int _txt_doc_reopen(struct _txt_doc *self)
+{
+    /* The file followed is replaced, such as saved by an editor
+     * with a rename, open the one at the path instead. Return
+     * nonzero if it's opened. */
+    mume_stream_t *stm;
+    const char *path;
+    struct stat st;
+
+    path = mume_file_stream_path(self->stm);
+    if (stat(path, &st) ||
+        (st.st_dev == self->file_dev && st.st_ino == self->file_ino))
+    {
+        return 0;
+    }
+
+    stm = mume_file_stream_open(path, MUME_OM_READ);
+    if (NULL == stm)
+        return 0;
+
+    mume_stream_close(self->stm);
+    self->stm = stm;
+    self->file_dev = st.st_dev;
+    self->file_ino = st.st_ino;
+    return 1;
+}
+
+static int _txt_doc_update(struct _txt_doc *self)
+{
+    size_t length;
+    int i, first, pages, count;
+
+    if (NULL == self->lines)
+        return 0;
+
+    length = mume_lineidx_length(self->lines);
+    first = _txt_doc_line_count(self);
+    pages = _txt_doc_line_pages(self);
+
+    _txt_doc_begin_lines(self);
+
+    /* Only the text appended is scanned, and the last line may be
+     * longer. The lines are indexed again if the file is shrunk,
+     * such as a log file truncated, or replaced. */
+    if (!(self->monitor && _txt_doc_reopen(self)) &&
+        mume_lineidx_extend(self->lines, self->stm))
+    {
+        if (mume_lineidx_length(self->lines) == length) {
+            _txt_doc_end_lines(self);
+            return 0;
+        }
+
+        first = MAX(first - 1, 0);
+    }
+    else {
+        mume_lineidx_build(self->lines, self->stm);
+        first = 0;
+    }
+
+    /* Line blocks and shaped lines from the first changed line are
+     * read again when used. Shaped lines are cached for the font
+     * faces. A block's number is not greater than its lines', so
+     * the blocks removed with the lines are after the change. */
+    if (first > 0) {
+        mume_pagecache_invalidate_from(
+            self->blocks, self,
+            first / mume_lineidx_stride(self->lines));
+        mume_pagecache_invalidate_from(self->blocks, NULL, first);
+    }
+    else {
+        mume_pagecache_invalidate(self->blocks, NULL);
+    }
+
+    /* Reflowed pages are paginated again from the last page whose
+     * start is kept. */
+    if (self->reflow_width > 0 && self->page_count > 0) {
+        for (i = self->page_count - 1; i > 0; --i) {
+            if (self->pages[i].lineno <= first)
+                break;
+        }
+
+        if (0 == first)
+            i = 0;
+
+        self->page_count = i;
+        self->next_line = self->pages[i].lineno;
+        self->next_offset = self->pages[i].offset;
+    }
+
+    _txt_doc_end_lines(self);
+
+    /* Pages from the one of the first changed line are measured
+     * again. */
+    count = _txt_doc_line_pages(self);
+    self->media_boxes = realloc_abort(
+        self->media_boxes, sizeof(mume_rect_t) * MAX(count, 1));
+
+    pages = MIN(pages, first / _TXT_DOC_PAGE_LINE_COUNT);
+    for (i = pages; i < count; ++i)
+        self->media_boxes[i] = mume_rect_infinite;
+
+    return 1;
+}
+
+static int _txt_doc_set_stream(struct _txt_doc *self, mume_stream_t *stm)
+{
+    mume_stream_reference(stm);
+    _txt_doc_begin_lines(self);
+    mume_stream_close(self->stm);
+    self->stm = stm;
+    _txt_doc_end_lines(self);
+    return 1;
+}
+
+static int _txt_doc_render_async(struct _txt_doc *self)
+{
+    /* Lines are shaped and drawn with the font faces of the theme,
+     * which are shared by the GUI thread. */
+    return 0;
+}
+
 const void* mume_txt_doc_class(void)
 {
     static void *clazz;
@@ -449,5 +1081,15 @@ const void* mume_txt_doc_class(void)
         _txt_doc_extract_text,
         _mume_docdoc_render_page,
         _txt_doc_render_page,
+        _mume_docdoc_reflow,
+        _txt_doc_reflow,
+        _mume_docdoc_follow,
+        _txt_doc_follow,
+        _mume_docdoc_update,
+        _txt_doc_update,
+        _mume_docdoc_render_async,
+        _txt_doc_render_async,
+        _mume_docdoc_set_stream,
+        _txt_doc_set_stream,
         MUME_FUNC_END);
 }
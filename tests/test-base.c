@@ -35,9 +35,13 @@ const char* all_tests(void)
     test_decl_run(test_time_sub);
     test_decl_run(test_time_cmp);
     test_decl_run(test_stream_byteorder);
+    test_decl_run(test_stream_mmap);
     test_decl_run(test_virtfs_native);
     test_decl_run(test_virtfs_zip);
+    test_decl_run(test_virtfs_zipfs);
     test_decl_run(test_thread_mutex);
     test_decl_run(test_thread_semaphore);
+    test_decl_run(test_ringq_order);
+    test_decl_run(test_ringq_bench);
     return 0;
 }
@@ -0,0 +1,58 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "mume-gui.h"
+#include "mume-reader.h"
+#include "test-util.h"
+
+static void _wait_loading(void *view)
+{
+    mume_event_t evt;
+
+    while (mume_docview_get_loading(view) >= 0 && mume_wait_event(&evt))
+        mume_disp_event(&evt);
+}
+
+void test_docload(void)
+{
+    void *view = mume_docview_new(mume_root_window(), 0, 0, 100, 100);
+
+    mume_docmgr_register(
+        mume_docmgr(), MUME_FILETYPE_TXT, mume_txt_doc_class());
+
+    test_assert(-1 == mume_docview_get_loading(view));
+    test_assert(mume_docview_load_file(view, TESTS_DATA_DIR "/test.txt"));
+    test_assert(0 == mume_docview_get_loading(view));
+    _wait_loading(view);
+    test_assert(mume_docview_get_doc(view));
+    test_assert(mume_docview_count_pages(view) > 0);
+
+    /* Cancelled by another load, or by setting a document. */
+    test_assert(mume_docview_load_file(view, TESTS_DATA_DIR "/test.txt"));
+    test_assert(NULL == mume_docview_get_doc(view));
+    test_assert(mume_docview_load_file(view, TESTS_DATA_DIR "/test.txt"));
+    mume_docview_set_doc(view, NULL);
+    test_assert(-1 == mume_docview_get_loading(view));
+
+    /* Failed. */
+    test_assert(mume_docview_load_file(view, TESTS_DATA_DIR "/none.txt"));
+    _wait_loading(view);
+    test_assert(NULL == mume_docview_get_doc(view));
+
+    mume_delete(view);
+}
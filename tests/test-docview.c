@@ -20,15 +20,280 @@
 #include "mume-reader.h"
 #include "test-util.h"
 
+/* Create a txt document that has <pages> pages. */
+static void* _create_txt_doc(int pages)
+{
+    void *doc;
+    mume_stream_t *stm;
+    size_t i, len = pages * 50 * 2;
+    char *buf = malloc_abort(len);
+
+    for (i = 0; i < len; i += 2) {
+        buf[i] = 'x';
+        buf[i + 1] = '\n';
+    }
+
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_memory_stream_open(buf, len, free);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+    test_assert(mume_docdoc_count_pages(doc) == pages);
+    return doc;
+}
+
+/* Measure the page lookup after scrolling in a document of
+ * <pages> pages, return the best seconds of a few runs. */
+static double _time_page_lookup(void *parent, int pages)
+{
+#define count 10000
+#define runs 3
+    void *view, *doc;
+    mume_timeval_t t0, t1;
+    double seconds, best = 0;
+    int i, r, cy, sum = 0;
+
+    view = mume_docview_new(parent, 0, 0, 100, 100);
+    doc = _create_txt_doc(pages);
+    mume_docview_set_doc(view, doc);
+    mume_refobj_release(doc);
+    mume_scrollview_get_size(view, NULL, &cy);
+
+    mume_scrollview_set_scroll(view, 0, cy);
+    test_assert(mume_docview_first_visible(view) == pages - 1);
+    test_assert(mume_docview_page_from(view, 0) == pages - 1);
+    mume_scrollview_set_scroll(view, 0, 0);
+    test_assert(mume_docview_first_visible(view) == 0);
+
+    for (r = 0; r < runs; ++r) {
+        mume_gettimeofday(&t0);
+        for (i = 0; i < count; ++i) {
+            mume_scrollview_set_scroll(view, 0, (i % 2) ? cy / 2 : cy);
+            sum += mume_docview_first_visible(view);
+            sum += mume_docview_page_from(view, 50);
+        }
+
+        mume_gettimeofday(&t1);
+        t1 = mume_timeval_sub(&t1, &t0);
+        seconds = t1.tv_sec + t1.tv_usec / 1000000.0;
+        if (0 == r || seconds < best)
+            best = seconds;
+    }
+
+    mume_debug(("page lookup (%d pages): %d lookups in %.6fs\n",
+                pages, count * 2, best));
+
+    test_assert(sum > 0);
+    mume_delete(view);
+    return best;
+#undef runs
+#undef count
+}
+
+/* The cost of the page lookup should not grow with the page
+ * count, a linear search would be 100 times slower. */
+static void _bench_page_lookup(void *parent)
+{
+    double small, large;
+
+    if (!test_bench_enabled())
+        return;
+
+    small = _time_page_lookup(parent, 50);
+    large = _time_page_lookup(parent, 5000);
+    mume_debug(("page lookup: 5000 pages %.2f times of 50 pages\n",
+                small > 0 ? large / small : 0.0));
+}
+
+/* Pages of the txt document all have the same height until
+ * measured, so the page at each offset is known. */
+static void _test_page_lookup(void *parent)
+{
+#define pages 5000
+    void *view, *doc;
+    int i, y, cy, pitch;
+
+    view = mume_docview_new(parent, 0, 0, 100, 100);
+    doc = _create_txt_doc(pages);
+    mume_docview_set_doc(view, doc);
+    mume_refobj_release(doc);
+    mume_scrollview_get_size(view, NULL, &cy);
+    pitch = cy / pages;
+    test_assert(pitch > 0 && cy == pitch * pages);
+
+    for (i = 0; i < pages; i += (i < 10 || i > pages - 10) ? 1 : 97) {
+        test_assert(mume_docview_page_from(view, i * pitch) == i);
+        test_assert(
+            mume_docview_page_from(view, i * pitch + pitch - 1) == i);
+    }
+
+    for (i = 0; i < pages; i += (i < 10 || i > pages - 10) ? 1 : 89) {
+        mume_scrollview_set_scroll(view, 0, i * pitch + pitch / 2);
+        mume_scrollview_get_scroll(view, NULL, &y);
+        test_assert(mume_docview_first_visible(view) == y / pitch);
+        test_assert(mume_docview_page_from(view, 0) == y / pitch);
+    }
+
+    mume_scrollview_set_scroll(view, 0, cy);
+    mume_scrollview_get_scroll(view, NULL, &y);
+    test_assert(mume_docview_first_visible(view) == y / pitch);
+    test_assert(mume_docview_page_from(view, cy) == pages - 1);
+
+    mume_delete(view);
+#undef pages
+}
+
+static void _flush_events(void)
+{
+    mume_event_t evt;
+
+    while (mume_peek_event(&evt, 1))
+        mume_disp_event(&evt);
+}
+
+/* Pages are estimated with the first page until they come into
+ * view, then measured by a notification, and scaled on zooming
+ * and rotating without being measured again. */
+static void _test_docview_measure(void *parent)
+{
+#define pages 10
+#define border 8
+    static const int lines = pages * 50;
+    void *view, *doc;
+    mume_stream_t *stm;
+    char *buf;
+    size_t i, len = (lines - 1) * 2 + 500;
+    int cx, cy, cx1, cy1, height;
+
+    /* The last line is much wider than the others. */
+    buf = malloc_abort(len);
+    for (i = 0; i < len; ++i) {
+        if (i < (lines - 1) * 2)
+            buf[i] = (i % 2) ? '\n' : 'x';
+        else
+            buf[i] = 'x';
+    }
+
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_memory_stream_open(buf, len, free);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+    test_assert(mume_docdoc_count_pages(doc) == pages);
+
+    view = mume_docview_new(parent, 0, 0, 100, 100);
+    mume_docview_set_doc(view, doc);
+    mume_refobj_release(doc);
+    mume_scrollview_get_size(view, &cx, &cy);
+    height = cy / pages - border;
+
+    mume_docview_set_zoom(view, 2);
+    mume_scrollview_get_size(view, &cx1, &cy1);
+    test_assert(cx1 - border == (cx - border) * 2);
+    test_assert(cy1 - border * pages == (cy - border * pages) * 2);
+    mume_docview_set_zoom(view, 1);
+
+    mume_docview_set_rotate(view, 90);
+    mume_scrollview_get_size(view, &cx1, NULL);
+    test_assert(cx1 - border == height);
+    mume_docview_set_rotate(view, 0);
+    mume_scrollview_get_size(view, &cx1, &cy1);
+    test_assert(cx1 == cx && cy1 == cy);
+
+    /* The last page is measured after scrolling. */
+    mume_scrollview_set_scroll(view, 0, cy);
+    mume_scrollview_get_size(view, &cx1, NULL);
+    test_assert(cx1 == cx);
+    _flush_events();
+    mume_scrollview_get_size(view, &cx1, NULL);
+    test_assert(cx1 > cx);
+    test_assert(mume_docview_first_visible(view) == pages - 1);
+
+    mume_docview_set_zoom(view, 2);
+    mume_scrollview_get_size(view, &cx, NULL);
+    test_assert(cx - border == (cx1 - border) * 2);
+
+    mume_delete(view);
+#undef border
+#undef pages
+}
+
+/* Measure the seconds of scrolling through the first page of
+ * <doc>, by rendering 400x400 frames alternating with 400x<short>
+ * ones. */
+#define _SCROLL_FRAMES 200
+
+static double _time_scroll(void *doc, int short_height)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    mume_matrix_t ctm;
+    mume_rect_t rect;
+    mume_timeval_t t0, t1;
+    int i;
+
+    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 400, 400);
+    cr = cairo_create(surface);
+    ctm = mume_docdoc_get_matrix(doc, 0, 1.0f, 0);
+    rect = mume_rect_make(0, 0, 400, 400);
+
+    mume_gettimeofday(&t0);
+    for (i = 0; i < _SCROLL_FRAMES; ++i) {
+        rect.y = (i * 8) % 400;
+        rect.height = (i % 2) ? short_height : 400;
+        mume_docdoc_render_page(doc, cr, 0, 0, 0, ctm, rect);
+    }
+
+    mume_gettimeofday(&t1);
+    t1 = mume_timeval_sub(&t1, &t0);
+
+    test_assert(cairo_status(cr) == CAIRO_STATUS_SUCCESS);
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+    return t1.tv_sec + t1.tv_usec / 1000000.0;
+}
+
+/* Compare scrolling with the pdf pixmap reused against the pixmap
+ * reallocated for each frame. A 400x99 frame is more than four
+ * times smaller than the 400x400 pixmap, so it reallocates the
+ * pixmap every frame, while a 400x100 one reuses it. This only
+ * approximates the old code, which allocated for every frame. */
+static void _bench_scroll(void *doc)
+{
+    double reused, allocated;
+
+    if (!test_bench_enabled())
+        return;
+
+    allocated = _time_scroll(doc, 99);
+    reused = _time_scroll(doc, 100);
+    mume_debug(("scroll: %.1f fps reusing the pixmap, "
+                "%.1f fps reallocating it\n",
+                reused > 0 ? _SCROLL_FRAMES / reused : 0.0,
+                allocated > 0 ? _SCROLL_FRAMES / allocated : 0.0));
+}
+
 void all_tests(void)
 {
     void *win, *tab, *doc, *view;
     mume_virtfs_t *vfs;
     mume_stream_t *stm;
 
+    test_decl_run(test_tilecache_lru);
+    test_decl_run(test_tilecache_budget);
+    test_decl_run(test_tilecache_invalidate);
+    test_decl_run(test_glyphidx_closest);
+    test_decl_run(test_glyphidx_range);
+    test_decl_run(test_pagecache);
+    test_decl_run(test_lineidx);
+    test_decl_run(test_lineidx_bench);
+
     test_assert(mume_resmgr_load(
         mume_resmgr(), TESTS_THEME_DIR "/default", "reader.xml"));
 
+    test_decl_run(test_txtdoc_lines);
+    test_decl_run(test_txtdoc_encoding);
+    test_decl_run(test_txtdoc_reflow);
+    test_decl_run(test_txtdoc_follow);
+
     win = mume_ratiobox_new(mume_root_window(), 0, 0, 400, 400);
 
     tab = mume_tabctrl_new(win, 5, 5, 390, 390, MUME_TABCTRL_TOP);
@@ -43,10 +308,15 @@ void all_tests(void)
     test_assert(stm);
     test_assert(mume_docdoc_load(doc, stm));
     mume_stream_close(stm);
+    test_check_page_text(doc, 0);
+    _bench_scroll(doc);
     test_assert(NULL == mume_docview_get_doc(view));
     mume_docview_set_doc(view, NULL);
     mume_docview_set_doc(view, doc);
     mume_refobj_release(doc);
+    test_assert(mume_docview_get_cache_size(view) > 0);
+    mume_docview_set_cache_size(view, 1024 * 1024);
+    test_assert(mume_docview_get_cache_size(view) == 1024 * 1024);
 
     /* txt */
     view = mume_docview_new(tab, 0, 0, 0, 0);
@@ -57,6 +327,19 @@ void all_tests(void)
     mume_stream_close(stm);
     mume_docview_set_doc(view, doc);
     mume_refobj_release(doc);
+    mume_docview_set_reflow(view, 1);
+    test_assert(mume_docview_get_reflow(view));
+    mume_docview_set_reflow(view, 0);
+    test_assert(!mume_docview_get_reflow(view));
+    mume_docview_set_follow(view, 1);
+    test_assert(mume_docview_get_follow(view));
+    mume_docview_set_follow(view, 0);
+    test_assert(!mume_docview_get_follow(view));
+
+    test_decl_run(test_docload);
+    _test_docview_measure(tab);
+    _test_page_lookup(tab);
+    _bench_page_lookup(tab);
 
     mume_window_center(win, mume_root_window());
     mume_window_map(win);
@@ -308,6 +308,175 @@ static void _test_move_resize(void)
     mume_delete(win);
 }
 
+static void _post_motion(void *win, int x, int state)
+{
+    mume_event_t event;
+    event.motion.type = MUME_EVENT_MOUSEMOTION;
+    event.motion.window = win;
+    event.motion.x = x;
+    event.motion.y = x + 1;
+    event.motion.state = state;
+    mume_post_event(event);
+}
+
+/* Compare the fields, the events are built apart so their
+ * padding may differ. */
+static mume_event_t _event_checker_pop(void)
+{
+    mume_event_t event = mume_make_empty_event();
+    if (!mume_list_empty(event_list)) {
+        event = *(mume_event_t*)mume_list_data(
+            mume_list_front(event_list));
+        mume_list_pop_front(event_list);
+    }
+
+    return event;
+}
+
+static int _check_motion(void *win, int x, int state)
+{
+    mume_event_t event = _event_checker_pop();
+    return event.type == MUME_EVENT_MOUSEMOTION &&
+           event.motion.window == win && event.motion.x == x &&
+           event.motion.y == x + 1 && event.motion.state == state;
+}
+
+static void _test_coalesce(void)
+{
+    int i;
+    void *win;
+    unsigned int motions, resizes, scrolls;
+    mume_event_t event;
+
+    win = _create_event_check_window(
+        mume_root_window(), 0, 0, 100, 100);
+    /* Flush the pending events. */
+    while (mume_peek_event(&event, 1))
+        mume_disp_event(&event);
+
+    mume_list_clear(event_list);
+    motions = mume_folded_events(MUME_EVENT_MOUSEMOTION);
+    resizes = mume_folded_events(MUME_EVENT_RESIZE);
+    scrolls = mume_folded_events(MUME_EVENT_SCROLL);
+    for (i = 0; i < 10; ++i)
+        _post_motion(win, i, 0);
+
+    _post_motion(win, 20, MUME_MOD_LBUTTON);
+    _post_motion(win, 21, MUME_MOD_LBUTTON);
+    mume_post_event(mume_make_resize_event(win, win, 10, 10, 5, 5));
+    mume_post_event(mume_make_resize_event(win, win, 20, 30, 10, 10));
+    mume_post_event(mume_make_scroll_event(win, win, 1, 10));
+    mume_post_event(mume_make_scroll_event(win, win, 1, 20));
+    mume_post_event(mume_make_scroll_event(win, win, 2, 30));
+    while (mume_peek_event(&event, 1))
+        mume_disp_event(&event);
+
+    test_assert(mume_list_size(event_list) == 5);
+    test_assert(_check_motion(win, 9, 0));
+    test_assert(_check_motion(win, 21, MUME_MOD_LBUTTON));
+    event = _event_checker_pop();
+    test_assert(event.type == MUME_EVENT_RESIZE &&
+                event.resize.width == 20 && event.resize.height == 30 &&
+                event.resize.old_width == 5 &&
+                event.resize.old_height == 5);
+    event = _event_checker_pop();
+    test_assert(event.type == MUME_EVENT_SCROLL &&
+                event.scroll.hitcode == 1 &&
+                event.scroll.position == 20);
+    event = _event_checker_pop();
+    test_assert(event.type == MUME_EVENT_SCROLL &&
+                event.scroll.hitcode == 2 &&
+                event.scroll.position == 30);
+    test_assert(mume_folded_events(MUME_EVENT_MOUSEMOTION) ==
+                motions + 10);
+    test_assert(mume_folded_events(MUME_EVENT_RESIZE) == resizes + 1);
+    test_assert(mume_folded_events(MUME_EVENT_SCROLL) == scrolls + 1);
+
+    /* Opt out. */
+    mume_coalesce_events(MUME_EVENT_MOUSEMOTION, 0);
+    _post_motion(win, 1, 0);
+    _post_motion(win, 2, 0);
+    while (mume_peek_event(&event, 1))
+        mume_disp_event(&event);
+
+    mume_coalesce_events(MUME_EVENT_MOUSEMOTION, 1);
+    test_assert(mume_list_size(event_list) == 2);
+    test_assert(_check_motion(win, 1, 0));
+    test_assert(_check_motion(win, 2, 0));
+    test_assert(mume_folded_events(MUME_EVENT_MOUSEMOTION) ==
+                motions + 10);
+    mume_delete(win);
+    mume_list_clear(event_list);
+}
+
+struct _sender {
+    void *window;
+    volatile int done;
+    int sent;
+    mume_thread_id_t *thread;
+};
+
+static void _sender_invoked(void *param)
+{
+    struct _sender *sender = param;
+    sender->thread = mume_thread_id_new();
+    sender->done = 1;
+}
+
+static void _sender_proc(void *param)
+{
+    struct _sender *sender = param;
+    mume_event_t event;
+    event.motion.type = MUME_EVENT_MOUSEMOTION;
+    event.motion.window = sender->window;
+    event.motion.x = 3;
+    event.motion.y = 4;
+    event.motion.state = 0;
+    /* Dispatched on the GUI thread before returning. */
+    sender->sent = mume_send_event(&event);
+    mume_invoke_async(_sender_invoked, sender);
+}
+
+static void _test_send_thread(void)
+{
+    mume_event_t event;
+    mume_thread_t *thread;
+    struct _sender sender;
+
+    sender.window = _create_event_check_window(
+        mume_root_window(), 0, 0, 100, 100);
+    sender.done = 0;
+    sender.sent = 0;
+    sender.thread = NULL;
+    mume_list_clear(event_list);
+    /* Posted before, must be dispatched before the sent one
+     * and not folded with it. */
+    event.motion.type = MUME_EVENT_MOUSEMOTION;
+    event.motion.window = sender.window;
+    event.motion.x = 1;
+    event.motion.y = 2;
+    event.motion.state = 0;
+    mume_post_event(event);
+    thread = mume_thread_new(_sender_proc, &sender);
+    while (!sender.done) {
+        if (mume_peek_event(&event, 1))
+            mume_disp_event(&event);
+        else
+            mume_sleep_msec(1);
+    }
+
+    mume_thread_join(thread);
+    mume_thread_delete(thread);
+    test_assert(mume_thread_is_self(sender.thread));
+    mume_thread_id_delete(sender.thread);
+    test_assert(sender.sent);
+    test_assert(mume_list_size(event_list) == 2);
+    test_assert(_check_motion(sender.window, 1, 0));
+    test_assert(_check_motion(sender.window, 3, 0));
+    mume_delete(sender.window);
+    mume_list_clear(event_list);
+}
+
 void all_tests(void)
 {
     event_list = mume_list_new(NULL, NULL);
@@ -315,5 +484,7 @@ void all_tests(void)
     test_run(_test_create_children);
     test_run(_test_map_unmap);
     test_run(_test_move_resize);
+    test_run(_test_coalesce);
+    test_run(_test_send_thread);
     mume_list_delete(event_list);
 }
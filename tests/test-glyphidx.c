@@ -0,0 +1,166 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "mume-reader.h"
+#include "test-util.h"
+
+#define _LINES 20
+#define _CHARS 30
+
+/* Glyphs of 8x12 in lines 16 pixels apart, every 7th is a space
+ * of zero width. */
+static mume_rect_t* _make_page(int *count)
+{
+    mume_rect_t *coords;
+    int i, l, c;
+
+    coords = malloc_abort(_LINES * _CHARS * sizeof(mume_rect_t));
+    for (i = 0, l = 0; l < _LINES; ++l) {
+        for (c = 0; c < _CHARS; ++c, ++i) {
+            coords[i] = mume_rect_make(
+                10 + c * 8, 10 + l * 16, (i % 7 == 6) ? 0 : 8, 12);
+        }
+    }
+
+    *count = i;
+    return coords;
+}
+
+static int _closest_of(const mume_rect_t *coords, int count, int x, int y)
+{
+    int i, result = -1;
+    double dx, dy, d, dist = 0;
+
+    for (i = 0; i < count; ++i) {
+        dx = x - (coords[i].x + coords[i].width / 2);
+        dy = y - (coords[i].y + coords[i].height / 2);
+        d = dx * dx + dy * dy;
+        if (-1 == result || d < dist) {
+            result = i;
+            dist = d;
+        }
+    }
+
+    return result;
+}
+
+static double _distance(const mume_rect_t *r, int x, int y)
+{
+    double dx = x - (r->x + r->width / 2);
+    double dy = y - (r->y + r->height / 2);
+    return dx * dx + dy * dy;
+}
+
+void test_glyphidx_closest(void)
+{
+    mume_glyphidx_t *idx;
+    mume_rect_t *coords;
+    mume_rect_t sparse[3];
+    int i, x, y, g, count;
+
+    coords = _make_page(&count);
+    idx = mume_glyphidx_new(coords, count);
+    test_assert(idx->cols * idx->rows > 1);
+
+    /* Points in, between and out of the lines. */
+    srand(1);
+    for (i = 0; i < 2000; ++i) {
+        x = rand() % (_CHARS * 8 + 60) - 30;
+        y = rand() % (_LINES * 16 + 60) - 30;
+        g = mume_glyphidx_closest(idx, x, y);
+        test_assert(g >= 0 && g < count);
+        test_assert(_distance(coords + g, x, y) ==
+                    _distance(coords + _closest_of(coords, count, x, y),
+                              x, y));
+    }
+
+    /* The glyph under the point. */
+    test_assert(mume_glyphidx_closest(idx, 14, 16) == 0);
+    test_assert(mume_glyphidx_closest(
+        idx, 10 + 4 * 8 + 4, 10 + 5 * 16 + 6) == 5 * _CHARS + 4);
+
+    mume_glyphidx_delete(idx);
+    free(coords);
+
+    /* Lines far apart, the closest glyph is found across the empty
+     * cells between them. */
+    sparse[0] = mume_rect_make(0, 0, 10, 10);
+    sparse[1] = mume_rect_make(500, 0, 10, 10);
+    sparse[2] = mume_rect_make(0, 1000, 10, 10);
+    idx = mume_glyphidx_new(sparse, 3);
+    test_assert(mume_glyphidx_closest(idx, 5, 400) == 0);
+    test_assert(mume_glyphidx_closest(idx, 5, 600) == 2);
+    test_assert(mume_glyphidx_closest(idx, 400, 5) == 1);
+    test_assert(mume_glyphidx_closest(idx, 400, 900) == 2);
+    mume_glyphidx_delete(idx);
+
+    idx = mume_glyphidx_new(NULL, 0);
+    test_assert(-1 == mume_glyphidx_closest(idx, 0, 0));
+    mume_glyphidx_delete(idx);
+}
+
+void test_glyphidx_range(void)
+{
+    mume_glyphidx_t *idx;
+    mume_rect_t *coords, rect;
+    int i, j, begin, end, b, e, count;
+
+    coords = _make_page(&count);
+    idx = mume_glyphidx_new(coords, count);
+
+    /* Rects spanning many cells must get the same range as
+     * visiting all the glyphs. */
+    srand(2);
+    for (i = 0; i < 2000; ++i) {
+        rect = mume_rect_make(
+            rand() % (_CHARS * 8 + 40) - 20,
+            rand() % (_LINES * 16 + 40) - 20,
+            rand() % 200 + 1, rand() % 120 + 1);
+
+        b = count;
+        e = 0;
+        for (j = 0; j < count; ++j) {
+            if (!mume_rect_is_empty(mume_rect_intersect(coords[j], rect))) {
+                b = MIN(b, j);
+                e = MAX(e, j + 1);
+            }
+        }
+
+        test_assert(mume_glyphidx_range(idx, rect, &begin, &end) ==
+                    (e > b));
+        if (e > b)
+            test_assert(begin == b && end == e);
+    }
+
+    /* From the middle of a line to the middle of the next. */
+    rect = mume_rect_make(10 + 10 * 8 + 2, 10 + 2 * 16 + 2,
+                          1, 16);
+    test_assert(mume_glyphidx_range(idx, rect, &begin, &end));
+    test_assert(begin == 2 * _CHARS + 10 && end == 3 * _CHARS + 11);
+
+    /* Between the lines and out of the page. */
+    rect = mume_rect_make(0, 10 + 12, 500, 4);
+    test_assert(!mume_glyphidx_range(idx, rect, &begin, &end));
+    rect = mume_rect_make(1000, 1000, 10, 10);
+    test_assert(!mume_glyphidx_range(idx, rect, &begin, &end));
+    rect = mume_rect_make(20, 20, 0, 10);
+    test_assert(!mume_glyphidx_range(idx, rect, &begin, &end));
+
+    mume_glyphidx_delete(idx);
+    free(coords);
+}
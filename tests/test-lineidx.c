@@ -0,0 +1,219 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "mume-reader.h"
+#include "test-util.h"
+#include "../src/reader/txt/mume-lineidx.h"
+
+/* A stream of 80 characters lines generated on read, so large
+ * inputs can be scanned without the memory. */
+struct _gen_stream {
+    mume_stream_t base;
+    size_t len;
+    size_t cur;
+};
+
+static size_t _gen_stream_length(void *self)
+{
+    return ((struct _gen_stream*)self)->len;
+}
+
+static int _gen_stream_eof(void *self)
+{
+    struct _gen_stream *stm = self;
+    return stm->cur == stm->len;
+}
+
+static size_t _gen_stream_tell(void *self)
+{
+    return ((struct _gen_stream*)self)->cur;
+}
+
+static int _gen_stream_seek(void *self, size_t pos)
+{
+    struct _gen_stream *stm = self;
+    if (pos <= stm->len) {
+        stm->cur = pos;
+        return 1;
+    }
+    return 0;
+}
+
+static size_t _gen_stream_read(void *self, void *data, size_t len)
+{
+    struct _gen_stream *stm = self;
+    char *buf = data;
+    size_t i;
+
+    if (stm->len - stm->cur < len)
+        len = stm->len - stm->cur;
+
+    for (i = 0; i < len; ++i)
+        buf[i] = ((stm->cur + i) % 80 == 79) ? '\n' : 'x';
+
+    stm->cur += len;
+    return len;
+}
+
+static size_t _gen_stream_write(void *self, const void *data, size_t len)
+{
+    return 0;
+}
+
+static void _gen_stream_close(void *self)
+{
+    free(self);
+}
+
+static mume_stream_t* _gen_stream_open(size_t len)
+{
+    static struct mume_stream_i impl = {
+        _gen_stream_length,
+        _gen_stream_eof,
+        _gen_stream_tell,
+        _gen_stream_seek,
+        _gen_stream_read,
+        _gen_stream_write,
+        _gen_stream_close
+    };
+
+    struct _gen_stream *stm = malloc_struct(struct _gen_stream);
+    stm->base.impl = &impl;
+    stm->base.refcount = 0;
+    stm->len = len;
+    stm->cur = 0;
+    return (mume_stream_t*)stm;
+}
+
+void test_lineidx(void)
+{
+    static const char text[] = "a\r\nbb\n\rccc\r\r\n\nd";
+    static const size_t starts[] = { 0, 3, 6, 7, 11, 13, 14 };
+    mume_lineidx_t *idx;
+    mume_stream_t *stm;
+    size_t i, n;
+
+    idx = mume_lineidx_new(1);
+    stm = mume_memory_stream_open(
+        (char*)text, sizeof(text) - 1, NULL);
+    test_assert(mume_lineidx_build(idx, stm));
+    test_assert(mume_lineidx_count(idx) == COUNT_OF(starts));
+
+    for (i = 0; i < COUNT_OF(starts); ++i)
+        test_assert(mume_lineidx_start(idx, i) == starts[i]);
+
+    test_assert(mume_lineidx_start(idx, i) == sizeof(text) - 1);
+    mume_stream_close(stm);
+
+    /* Empty line at the end is not counted. */
+    stm = mume_memory_stream_open((char*)text, 3, NULL);
+    test_assert(mume_lineidx_build(idx, stm));
+    test_assert(mume_lineidx_count(idx) == 1);
+    mume_stream_close(stm);
+
+    stm = mume_memory_stream_open((char*)text, 0, NULL);
+    test_assert(mume_lineidx_build(idx, stm));
+    test_assert(mume_lineidx_count(idx) == 0);
+    mume_stream_close(stm);
+    mume_lineidx_delete(idx);
+
+    /* Sparse index only records every 3 lines. */
+    idx = mume_lineidx_new(3);
+    stm = mume_memory_stream_open(
+        (char*)text, sizeof(text) - 1, NULL);
+    test_assert(mume_lineidx_build(idx, stm));
+    test_assert(mume_lineidx_count(idx) == COUNT_OF(starts));
+
+    for (i = 0; i < COUNT_OF(starts); i += 3)
+        test_assert(mume_lineidx_start(idx, i) == starts[i]);
+
+    test_assert(mume_lineidx_start(idx, COUNT_OF(starts)) ==
+                sizeof(text) - 1);
+    mume_stream_close(stm);
+    mume_lineidx_delete(idx);
+
+    /* Extending at each length must be the same as building. */
+    for (n = 0; n < sizeof(text); ++n) {
+        idx = mume_lineidx_new(1);
+        stm = mume_memory_stream_open((char*)text, n, NULL);
+        test_assert(mume_lineidx_build(idx, stm));
+        mume_stream_close(stm);
+
+        stm = mume_memory_stream_open(
+            (char*)text, sizeof(text) - 1, NULL);
+        test_assert(mume_lineidx_extend(idx, stm));
+        test_assert(mume_lineidx_count(idx) == COUNT_OF(starts));
+
+        for (i = 0; i < COUNT_OF(starts); ++i)
+            test_assert(mume_lineidx_start(idx, i) == starts[i]);
+
+        mume_stream_close(stm);
+
+        /* Truncated. */
+        if (n > 0) {
+            stm = mume_memory_stream_open((char*)text, n - 1, NULL);
+            test_assert(!mume_lineidx_extend(idx, stm));
+            mume_stream_close(stm);
+        }
+
+        mume_lineidx_delete(idx);
+    }
+
+    /* Several blocks, each split into slices for the workers. */
+    n = 20 * 1024 * 1024 + 1;
+    idx = mume_lineidx_new(200);
+    stm = _gen_stream_open(n);
+    test_assert(mume_lineidx_build(idx, stm));
+    test_assert(mume_lineidx_count(idx) == (n + 79) / 80);
+
+    for (i = 0; i < mume_lineidx_count(idx); i += 200)
+        test_assert(mume_lineidx_start(idx, i) == i * 80);
+
+    mume_stream_close(stm);
+    mume_lineidx_delete(idx);
+}
+
+/* Measure the line indexing of a synthetic 1GB text, with the
+ * sparse index of one start per 200 lines as the txt doc uses. */
+void test_lineidx_bench(void)
+{
+    mume_lineidx_t *idx;
+    mume_stream_t *stm;
+    mume_timeval_t t0, t1;
+    size_t len = 1024 * 1024 * 1024;
+
+    if (!test_bench_enabled())
+        return;
+
+    idx = mume_lineidx_new(200);
+    stm = _gen_stream_open(len);
+
+    mume_gettimeofday(&t0);
+    test_assert(mume_lineidx_build(idx, stm));
+    mume_gettimeofday(&t1);
+    t1 = mume_timeval_sub(&t1, &t0);
+    mume_debug(("line index (%u bytes): %u lines in %d.%06ds, "
+                "%u bytes of index\n",
+                (unsigned)len, (unsigned)mume_lineidx_count(idx),
+                t1.tv_sec, t1.tv_usec,
+                (unsigned)mume_lineidx_size(idx)));
+
+    test_assert(mume_lineidx_count(idx) == (len + 79) / 80);
+    mume_stream_close(stm);
+    mume_lineidx_delete(idx);
+}
@@ -0,0 +1,84 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "mume-reader.h"
+#include "test-util.h"
+
+static int _destroyed;
+
+static void _count_destroy(void *data)
+{
+    ++_destroyed;
+}
+
+void test_pagecache(void)
+{
+    mume_pagecache_t *cache;
+    int owner1, owner2;
+    void *data;
+
+    _destroyed = 0;
+    cache = mume_pagecache_new(100);
+    mume_pagecache_insert(cache, &owner1, 0, 0, &owner1, 40, _count_destroy);
+    mume_pagecache_insert(cache, &owner1, 0, 1, &owner1, 40, _count_destroy);
+    mume_pagecache_insert(cache, &owner2, 0, 0, &owner2, 40, _count_destroy);
+    test_assert(mume_pagecache_size(cache) == 120);
+    test_assert(mume_pagecache_count(cache) == 3);
+
+    /* Nothing is evicted on insert. */
+    test_assert(0 == _destroyed);
+    test_assert(mume_pagecache_find(cache, &owner1, 0, 0, &data));
+    test_assert(data == &owner1);
+    test_assert(!mume_pagecache_find(cache, &owner1, 1, 0, &data));
+    test_assert(mume_pagecache_hits(cache) == 1);
+    test_assert(mume_pagecache_misses(cache) == 1);
+
+    /* Only the data of owner2 may be evicted. */
+    mume_pagecache_trim(cache, &owner2);
+    test_assert(1 == _destroyed);
+    test_assert(!mume_pagecache_find(cache, &owner2, 0, 0, &data));
+    mume_pagecache_insert(cache, &owner2, 0, 0, &owner2, 40, _count_destroy);
+
+    /* Page 1 of owner1 is the least recently used. */
+    mume_pagecache_trim(cache, NULL);
+    test_assert(2 == _destroyed);
+    test_assert(mume_pagecache_evictions(cache) == 2);
+    test_assert(!mume_pagecache_find(cache, &owner1, 0, 1, &data));
+    test_assert(mume_pagecache_find(cache, &owner1, 0, 0, &data));
+
+    mume_pagecache_invalidate(cache, &owner1);
+    test_assert(3 == _destroyed);
+    test_assert(mume_pagecache_size(cache) == 40);
+
+    /* Data of all kinds from a page on. */
+    mume_pagecache_insert(cache, &owner1, 0, 0, &owner1, 10, _count_destroy);
+    mume_pagecache_insert(cache, &owner1, 1, 1, &owner1, 10, _count_destroy);
+    mume_pagecache_insert(cache, &owner1, 2, 2, &owner1, 10, _count_destroy);
+    mume_pagecache_insert(cache, &owner2, 0, 1, &owner2, 10, _count_destroy);
+    mume_pagecache_invalidate_from(cache, &owner1, 1);
+    test_assert(5 == _destroyed);
+    test_assert(mume_pagecache_find(cache, &owner1, 0, 0, &data));
+    test_assert(mume_pagecache_find(cache, &owner2, 0, 1, &data));
+
+    /* Of all owners. */
+    mume_pagecache_invalidate_from(cache, NULL, 1);
+    test_assert(6 == _destroyed);
+    test_assert(mume_pagecache_count(cache) == 2);
+    mume_pagecache_delete(cache);
+    test_assert(8 == _destroyed);
+}
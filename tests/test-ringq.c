@@ -0,0 +1,218 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "test-util.h"
+
+#define _PRODUCERS 4
+#define _POSTS 100000
+
+struct _ringq_elt {
+    int producer;
+    int seq;
+    void *data;
+};
+
+struct _producer {
+    int id;
+    mume_ringq_t *q;
+    mume_list_t *lst;
+    mume_mutex_t *mutex;
+};
+
+static int _is_odd(const void *elt, void *p)
+{
+    return ((const struct _ringq_elt*)elt)->seq % 2;
+}
+
+static void _ringq_proc(void *param)
+{
+    struct _producer *p = param;
+    struct _ringq_elt elt;
+    elt.producer = p->id;
+    elt.data = NULL;
+    for (elt.seq = 0; elt.seq < _POSTS; ++elt.seq)
+        mume_ringq_push(p->q, &elt);
+}
+
+/* The mutex guarded list the event queue used to be. */
+static void _list_proc(void *param)
+{
+    struct _producer *p = param;
+    struct _ringq_elt elt;
+    elt.producer = p->id;
+    elt.data = NULL;
+    for (elt.seq = 0; elt.seq < _POSTS; ++elt.seq) {
+        mume_mutex_lock(p->mutex);
+        memcpy(mume_list_data(mume_list_push_back(
+            p->lst, sizeof(elt))), &elt, sizeof(elt));
+        mume_mutex_unlock(p->mutex);
+    }
+}
+
+static int _list_pop(struct _producer *p, struct _ringq_elt *elt)
+{
+    int result = 0;
+    mume_mutex_lock(p->mutex);
+    if (!mume_list_empty(p->lst)) {
+        memcpy(elt, mume_list_data(mume_list_front(p->lst)),
+               sizeof(*elt));
+        mume_list_pop_front(p->lst);
+        result = 1;
+    }
+
+    mume_mutex_unlock(p->mutex);
+    return result;
+}
+
+/* Drain the posts of all producers, each producer's posts must
+ * arrive complete and in order. */
+static void _bench_post(const char *name, size_t capacity)
+{
+    struct _producer p[_PRODUCERS];
+    mume_thread_t *t[_PRODUCERS];
+    int next[_PRODUCERS];
+    struct _ringq_elt elt, *front;
+    mume_ringq_t *q = NULL;
+    mume_list_t *lst = NULL;
+    mume_mutex_t *mutex = NULL;
+    mume_timeval_t t0, t1;
+    int i, count = 0;
+
+    if (capacity) {
+        q = mume_ringq_new(sizeof(elt), capacity);
+    }
+    else {
+        lst = mume_list_new(NULL, NULL);
+        mutex = mume_mutex_new();
+    }
+
+    mume_gettimeofday(&t0);
+    for (i = 0; i < _PRODUCERS; ++i) {
+        next[i] = 0;
+        p[i].id = i;
+        p[i].q = q;
+        p[i].lst = lst;
+        p[i].mutex = mutex;
+        t[i] = mume_thread_new(q ? _ringq_proc : _list_proc, p + i);
+    }
+
+    while (count < _PRODUCERS * _POSTS) {
+        if (q) {
+            if (!(front = mume_ringq_front(q)))
+                continue;
+
+            elt = *front;
+            mume_ringq_pop_front(q);
+        }
+        else if (!_list_pop(p, &elt)) {
+            continue;
+        }
+
+        test_assert(elt.seq == next[elt.producer]);
+        ++next[elt.producer];
+        ++count;
+    }
+
+    mume_gettimeofday(&t1);
+    t1 = mume_timeval_sub(&t1, &t0);
+    mume_debug(("%s: %d posts from %d threads in %d.%06ds\n",
+                name, count, _PRODUCERS, t1.tv_sec, t1.tv_usec));
+
+    for (i = 0; i < _PRODUCERS; ++i) {
+        mume_thread_join(t[i]);
+        mume_thread_delete(t[i]);
+    }
+
+    if (q) {
+        test_assert(mume_ringq_empty(q));
+        mume_ringq_delete(q);
+    }
+    else {
+        mume_mutex_delete(mutex);
+        mume_list_delete(lst);
+    }
+}
+
+void test_ringq_order(void)
+{
+    int i;
+    struct _ringq_elt elt, *front;
+    mume_ringq_t *q = mume_ringq_new(sizeof(elt), 5);
+    test_assert(mume_ringq_capacity(q) == 8);
+    test_assert(mume_ringq_empty(q));
+
+    /* Twice the capacity, the rest spills. */
+    elt.producer = 0;
+    elt.data = q;
+    for (i = 0; i < 16; ++i) {
+        elt.seq = i;
+        test_assert(!mume_ringq_push(q, &elt));
+    }
+
+    for (i = 0; i < 4; ++i) {
+        front = mume_ringq_front(q);
+        test_assert(front && front->seq == i && front->data == q);
+        mume_ringq_pop_front(q);
+    }
+
+    /* Pushed after the spilled ones, must come after them. */
+    elt.seq = 16;
+    mume_ringq_push(q, &elt);
+    test_assert(mume_ringq_remove_if(q, _is_odd, NULL) == 6);
+    for (i = 4; i <= 16; i += 2) {
+        front = mume_ringq_front(q);
+        test_assert(front && front->seq == i);
+        mume_ringq_pop_front(q);
+    }
+
+    test_assert(mume_ringq_empty(q));
+
+    /* Wrap around the ring many times. */
+    for (i = 0; i < 100; ++i) {
+        elt.seq = i;
+        mume_ringq_push(q, &elt);
+        mume_ringq_push(q, &elt);
+        test_assert(mume_ringq_remove_if(q, _is_odd, NULL) ==
+                    (i % 2 ? 2 : 0));
+        while ((front = mume_ringq_front(q))) {
+            test_assert(front->seq == i);
+            mume_ringq_pop_front(q);
+        }
+    }
+
+    /* A waiting consumer is reported. */
+    test_assert(mume_ringq_prepare_wait(q));
+    test_assert(mume_ringq_push(q, &elt));
+    mume_ringq_finish_wait(q);
+    test_assert(!mume_ringq_prepare_wait(q));
+    test_assert(!mume_ringq_push(q, &elt));
+    mume_ringq_delete(q);
+}
+
+/* Compare the ring queue with a mutex guarded list under the
+ * contention of several producers. */
+void test_ringq_bench(void)
+{
+    if (!test_bench_enabled())
+        return;
+
+    _bench_post("mutex list", 0);
+    _bench_post("ring queue", 1024);
+    /* Mostly spilling to the overflow list. */
+    _bench_post("small ring queue", 16);
+}
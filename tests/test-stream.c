@@ -17,6 +17,7 @@
  */
 #include "mume-base.h"
 #include "test-util.h"
+#include MUME_STDIO_H
 #include MUME_STRING_H
 
 static int _is_little_endian(void)
@@ -103,3 +104,68 @@ void test_stream_byteorder(void)
     test_assert(0x12345678ABCDEFAB == u64);
     mume_stream_close(stm);
 }
+
+void test_stream_mmap(void)
+{
+    static const char *path = "test-mmap.txt";
+    static const char text[] = "mapped text";
+    mume_stream_t *stm;
+    char buf[sizeof(text)];
+    FILE *fp;
+
+    fp = fopen(path, "wb");
+    test_assert(fp);
+    fwrite(text, 1, sizeof(text) - 1, fp);
+    fclose(fp);
+
+    stm = mume_mmap_stream_open(path);
+    test_assert(stm);
+    test_assert(0 == strcmp(mume_file_stream_path(stm), path));
+    test_assert(mume_stream_length(stm) == sizeof(text) - 1);
+    test_assert(mume_stream_seek(stm, 7));
+    test_assert(mume_stream_read(stm, buf, sizeof(buf)) == 4);
+    test_assert(0 == memcmp(buf, "text", 4));
+    test_assert(mume_stream_eof(stm));
+#if HAVE_SYS_MMAN_H
+    test_assert(0 == memcmp(mume_stream_peek(stm, 0, 6), "mapped", 6));
+    test_assert(mume_stream_peek(stm, sizeof(text) - 1, 0));
+#endif
+    test_assert(NULL == mume_stream_peek(stm, 7, 5));
+    test_assert(0 == mume_stream_write(stm, "x", 1));
+
+#if HAVE_SYS_MMAN_H
+    /* Truncated, the data cut off isn't read from the mapping. */
+    fp = fopen(path, "wb");
+    test_assert(fp);
+    fwrite("map", 1, 3, fp);
+    fclose(fp);
+
+    test_assert(mume_stream_length(stm) == 3);
+    test_assert(NULL == mume_stream_peek(stm, 0, 6));
+    test_assert(mume_stream_seek(stm, 0));
+    test_assert(mume_stream_read(stm, buf, sizeof(buf)) == 3);
+    test_assert(0 == memcmp(buf, "map", 3));
+    test_assert(mume_stream_eof(stm));
+#endif
+    mume_stream_close(stm);
+
+    /* Empty files can't be mapped. */
+    fp = fopen(path, "wb");
+    test_assert(fp);
+    fclose(fp);
+
+    stm = mume_mmap_stream_open(path);
+    test_assert(stm);
+    test_assert(0 == mume_stream_length(stm));
+    test_assert(NULL == mume_stream_peek(stm, 0, 0));
+    test_assert(0 == strcmp(mume_file_stream_path(stm), path));
+    mume_stream_close(stm);
+
+    remove(path);
+    test_assert(NULL == mume_mmap_stream_open(path));
+
+    stm = mume_memory_stream_open((char*)text, sizeof(text) - 1, NULL);
+    test_assert(mume_stream_peek(stm, 7, 4) == text + 7);
+    test_assert(NULL == mume_stream_peek(stm, 12, 0));
+    mume_stream_close(stm);
+}
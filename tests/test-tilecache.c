@@ -0,0 +1,162 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "mume-reader.h"
+#include "test-util.h"
+
+/* Surfaces of 16x16 ARGB32, 1024 bytes each. */
+#define _TILE_BYTES (16 * 16 * 4)
+
+static cairo_surface_t* _tile_new(void)
+{
+    return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 16, 16);
+}
+
+static void _tile_insert(mume_tilecache_t *cache,
+                         const void *doc, int pageno)
+{
+    mume_tilekey_t key = mume_tilekey_make(doc, pageno, 1, 0, 0, 0);
+    cairo_surface_t *surface = _tile_new();
+
+    mume_tilecache_insert(cache, &key, surface);
+    cairo_surface_destroy(surface);
+}
+
+static int _tile_cached(mume_tilecache_t *cache,
+                        const void *doc, int pageno)
+{
+    mume_tilekey_t key = mume_tilekey_make(doc, pageno, 1, 0, 0, 0);
+    return mume_tilecache_find(cache, &key) != NULL;
+}
+
+void test_tilecache_lru(void)
+{
+    mume_tilecache_t *cache;
+    mume_tilekey_t key;
+    cairo_surface_t *surface;
+    int doc;
+
+    cache = mume_tilecache_new(3 * _TILE_BYTES);
+    _tile_insert(cache, &doc, 0);
+    _tile_insert(cache, &doc, 1);
+    _tile_insert(cache, &doc, 2);
+    test_assert(3 == mume_tilecache_count(cache));
+    test_assert(3 * _TILE_BYTES == mume_tilecache_size(cache));
+
+    /* Page 0 is used again, page 1 is the least recently used. */
+    test_assert(_tile_cached(cache, &doc, 0));
+    _tile_insert(cache, &doc, 3);
+    test_assert(3 == mume_tilecache_count(cache));
+    test_assert(!_tile_cached(cache, &doc, 1));
+    test_assert(_tile_cached(cache, &doc, 2));
+    test_assert(_tile_cached(cache, &doc, 0));
+    test_assert(_tile_cached(cache, &doc, 3));
+
+    /* Replacing a tile doesn't count it twice. */
+    _tile_insert(cache, &doc, 3);
+    test_assert(3 == mume_tilecache_count(cache));
+    test_assert(3 * _TILE_BYTES == mume_tilecache_size(cache));
+
+    /* Keys differ by zoom, rotation and position. */
+    key = mume_tilekey_make(&doc, 3, 2, 0, 0, 0);
+    test_assert(NULL == mume_tilecache_find(cache, &key));
+    key = mume_tilekey_make(&doc, 3, 1, 90, 0, 0);
+    test_assert(NULL == mume_tilecache_find(cache, &key));
+    key = mume_tilekey_make(&doc, 3, 1, 0, 1, 0);
+    test_assert(NULL == mume_tilecache_find(cache, &key));
+
+    /* The cache keeps its own reference. */
+    key = mume_tilekey_make(&doc, 3, 1, 0, 0, 0);
+    surface = mume_tilecache_find(cache, &key);
+    test_assert(surface);
+    test_assert(cairo_surface_get_reference_count(surface) == 1);
+    mume_tilecache_delete(cache);
+}
+
+void test_tilecache_budget(void)
+{
+    mume_tilecache_t *cache;
+    int doc, i;
+
+    cache = mume_tilecache_new(4 * _TILE_BYTES);
+    for (i = 0; i < 10; ++i) {
+        _tile_insert(cache, &doc, i);
+        test_assert(mume_tilecache_size(cache) <=
+                    mume_tilecache_get_budget(cache));
+    }
+
+    /* The most recent ones are kept. */
+    test_assert(4 == mume_tilecache_count(cache));
+    for (i = 0; i < 10; ++i)
+        test_assert(_tile_cached(cache, &doc, i) == (i >= 6));
+
+    /* Shrinking the budget evicts at once. */
+    mume_tilecache_set_budget(cache, 2 * _TILE_BYTES + 1);
+    test_assert(2 == mume_tilecache_count(cache));
+    test_assert(!_tile_cached(cache, &doc, 6));
+    test_assert(!_tile_cached(cache, &doc, 7));
+
+    /* A tile larger than the budget is not cached. */
+    mume_tilecache_set_budget(cache, _TILE_BYTES - 1);
+    test_assert(0 == mume_tilecache_count(cache));
+    test_assert(0 == mume_tilecache_size(cache));
+    _tile_insert(cache, &doc, 0);
+    test_assert(0 == mume_tilecache_count(cache));
+    mume_tilecache_delete(cache);
+}
+
+void test_tilecache_invalidate(void)
+{
+    mume_tilecache_t *cache;
+    int doc1, doc2, i;
+
+    cache = mume_tilecache_new(8 * _TILE_BYTES);
+    for (i = 0; i < 3; ++i) {
+        _tile_insert(cache, &doc1, i);
+        _tile_insert(cache, &doc2, i);
+    }
+
+    /* Only the pages from 1 of doc1. */
+    mume_tilecache_invalidate_from(cache, &doc1, 1);
+    test_assert(4 == mume_tilecache_count(cache));
+    test_assert(_tile_cached(cache, &doc1, 0));
+    test_assert(!_tile_cached(cache, &doc1, 1));
+    test_assert(_tile_cached(cache, &doc2, 1));
+
+    mume_tilecache_invalidate(cache, &doc1);
+    test_assert(3 == mume_tilecache_count(cache));
+    test_assert(3 * _TILE_BYTES == mume_tilecache_size(cache));
+    for (i = 0; i < 3; ++i) {
+        test_assert(!_tile_cached(cache, &doc1, i));
+        test_assert(_tile_cached(cache, &doc2, i));
+    }
+
+    /* The LRU list is still linked after invalidation. */
+    _tile_insert(cache, &doc1, 0);
+    mume_tilecache_set_budget(cache, 2 * _TILE_BYTES);
+    test_assert(2 == mume_tilecache_count(cache));
+    test_assert(_tile_cached(cache, &doc1, 0));
+    test_assert(_tile_cached(cache, &doc2, 2));
+
+    mume_tilecache_invalidate(cache, NULL);
+    test_assert(0 == mume_tilecache_count(cache));
+    test_assert(0 == mume_tilecache_size(cache));
+    _tile_insert(cache, &doc2, 0);
+    test_assert(1 == mume_tilecache_count(cache));
+    mume_tilecache_delete(cache);
+}
@@ -82,7 +82,50 @@ static void test_gui_timer(void)
         &g_tmrs[3].expire, &g_tmrs[2].expire) > 0);
 }
 
+static int _count_proc(mume_timer_t *tmr)
+{
+    ++*(int*)mume_timer_data(tmr);
+    return 0;
+}
+
+static void test_timer_queue(void)
+{
+    int i, fired[64];
+    mume_timer_t tmrs[64];
+    mume_timeval_t wait;
+    mume_timerq_t *tmrq = mume_timerq_new();
+    for (i = 0; i < 64; ++i) {
+        fired[i] = 0;
+        mume_timer_ctor(&tmrs[i], _count_proc, &fired[i]);
+        test_assert(!mume_timer_scheduled(&tmrs[i]));
+        mume_timerq_schedule(tmrq, &tmrs[i], 10 + i % 3);
+    }
+
+    /* Cancel odd ones, push the multiples of 4 out. */
+    for (i = 1; i < 64; i += 2)
+        mume_timerq_cancel(tmrq, &tmrs[i]);
+
+    for (i = 0; i < 64; i += 4)
+        mume_timerq_schedule(tmrq, &tmrs[i], 100000);
+
+    mume_timerq_cancel(tmrq, &tmrs[1]);
+    test_assert(32 == mume_timerq_check(tmrq, &wait));
+    test_assert(0 == wait.tv_sec && wait.tv_usec > 0);
+    mume_sleep_msec(20);
+    test_assert(16 == mume_timerq_check(tmrq, &wait));
+    for (i = 0; i < 64; ++i) {
+        test_assert(fired[i] == (i % 2 == 0 && i % 4 != 0));
+        test_assert(mume_timer_scheduled(&tmrs[i]) == (i % 4 == 0));
+    }
+
+    test_assert(wait.tv_sec > 90);
+    mume_timerq_delete(tmrq);
+    for (i = 0; i < 64; ++i)
+        test_assert(!mume_timer_scheduled(&tmrs[i]));
+}
+
 void all_tests(void)
 {
     test_run(test_gui_timer);
+    test_run(test_timer_queue);
 }
@@ -0,0 +1,291 @@
+/* Mume Reader - a full featured reading environment.
+ *
+ * Copyright © 2012 Soft Flag, Inc.
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation, either version
+ * 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "mume-base.h"
+#include "mume-reader.h"
+#include "test-util.h"
+#include MUME_CTYPE_H
+#include MUME_STRING_H
+
+/* Lines read from the blocks of the sparse index must be the
+ * same as the lines in the text. */
+void test_txtdoc_lines(void)
+{
+#define count 1000
+    static const char *breaks[] = { "\n", "\r\n", "\r" };
+    char line[16], *buf, *tbuf, *t;
+    mume_rect_t *rbuf;
+    void *doc;
+    mume_stream_t *stm;
+    size_t len = 0;
+    int i, n, length;
+
+    buf = malloc_abort(count * 16);
+    for (i = 0; i < count; ++i)
+        len += sprintf(buf + len, "%d%s", i, breaks[i % 3]);
+
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_memory_stream_open(buf, len, free);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+    test_assert(mume_docdoc_count_pages(doc) == count / 50);
+
+    for (i = 0; i < count / 50; ++i) {
+        length = mume_docdoc_get_text(doc, i, &tbuf, &rbuf);
+        t = tbuf;
+
+        for (n = i * 50; n < (i + 1) * 50; ++n) {
+            len = sprintf(line, "%d", n);
+            test_assert(length >= (int)len);
+            test_assert(0 == strncmp(t, line, len));
+            t += len;
+            length -= len;
+
+            /* Lines of a page are joined by '\n'. */
+            if (n < (i + 1) * 50 - 1) {
+                test_assert(length > 0 && '\n' == *t);
+                ++t;
+                --length;
+            }
+        }
+
+        test_assert(0 == length);
+        free(tbuf);
+        free(rbuf);
+    }
+
+    mume_refobj_release(doc);
+#undef count
+}
+
+static void _check_txt_encoding(
+    const char *raw, size_t len, const char *utf8)
+{
+    void *doc;
+    char *buf, *tbuf;
+    mume_rect_t *rbuf;
+    mume_stream_t *stm;
+    int length;
+
+    buf = malloc_abort(len);
+    memcpy(buf, raw, len);
+
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_memory_stream_open(buf, len, free);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+
+    length = mume_docdoc_get_text(doc, 0, &tbuf, &rbuf);
+    test_assert(length == (int)strlen(utf8));
+    test_assert(0 == memcmp(tbuf, utf8, length));
+    free(tbuf);
+    free(rbuf);
+
+    mume_refobj_release(doc);
+}
+
+void test_txtdoc_encoding(void)
+{
+    /* UTF-16 with a character whose bytes are both '\n'. */
+    static const char le[] = "\xff\xfe" "a\0\xe9\0\r\0\n\0"
+                             "\x2d\x4e\n\0\x0a\x0a";
+    static const char be[] = "\xfe\xff" "\0a\0\xe9\0\r\0\n"
+                             "\x4e\x2d\0\n\x0a\x0a";
+    static const char utf8[] = "a\xc3\xa9\n\xe4\xb8\xad\n\xe0\xa8\x8a";
+
+    _check_txt_encoding(le, sizeof(le) - 1, utf8);
+    _check_txt_encoding(be, sizeof(be) - 1, utf8);
+    _check_txt_encoding("\xef\xbb\xbf" "caf\xc3\xa9\n",
+                        6 + 3, "caf\xc3\xa9");
+    _check_txt_encoding("caf\xe9\r", 5, "caf\xc3\xa9");
+    _check_txt_encoding("\x93q\x94", 3, "\xe2\x80\x9cq\xe2\x80\x9d");
+
+    /* Not cp1252 text, the bytes are kept. */
+    _check_txt_encoding("a\x81" "b", 3, "a\x81" "b");
+    _check_txt_encoding("\xd6\xd0\xce\xc4", 4, "\xd6\xd0\xce\xc4");
+}
+
+/* Get the text of all the pages without spaces and line breaks. */
+static char* _get_doc_words(void *doc)
+{
+    char *words, *tbuf;
+    mume_rect_t *rbuf;
+    int i, j, length, count = 0;
+
+    words = malloc_abort(1);
+    for (i = 0; i < mume_docdoc_count_pages(doc); ++i) {
+        length = mume_docdoc_get_text(doc, i, &tbuf, &rbuf);
+        words = realloc_abort(words, count + length + 1);
+        for (j = 0; j < length; ++j) {
+            if (!isspace((unsigned char)tbuf[j]))
+                words[count++] = tbuf[j];
+        }
+
+        free(tbuf);
+        free(rbuf);
+    }
+
+    words[count] = '\0';
+    return words;
+}
+
+void test_txtdoc_reflow(void)
+{
+#define count 200
+    char *buf, *words, *reflowed, *tbuf;
+    void *doc;
+    mume_stream_t *stm;
+    mume_rect_t box, *rbuf;
+    size_t len = 0;
+    int i, j, length, pages, more;
+
+    /* Long lines, each of 40 words. */
+    buf = malloc_abort(count * 40 * 8);
+    for (i = 0; i < count * 40; ++i)
+        len += sprintf(buf + len, "w%d%c", i, i % 40 == 39 ? '\n' : ' ');
+
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_memory_stream_open(buf, len, free);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+
+    pages = mume_docdoc_count_pages(doc);
+    test_assert(pages == count / 50);
+    words = _get_doc_words(doc);
+
+    /* The first page is paginated at once. */
+    test_assert(mume_docdoc_reflow(doc, 400, 1));
+    test_assert(1 == mume_docdoc_count_pages(doc));
+    box = mume_docdoc_get_mediabox(doc, 0);
+    test_assert(400 == box.width);
+
+    do {
+        i = mume_docdoc_count_pages(doc);
+        more = mume_docdoc_reflow(doc, 400, 4);
+        test_assert(mume_docdoc_count_pages(doc) > i);
+    } while (more);
+
+    test_assert(mume_docdoc_count_pages(doc) > pages);
+
+    /* Rows are sliced from the shaped lines within the width. */
+    for (i = 0; i < mume_docdoc_count_pages(doc); ++i) {
+        length = mume_docdoc_get_text(doc, i, &tbuf, &rbuf);
+        for (j = 0; j < length; ++j) {
+            if (' ' == tbuf[j] || '\n' == tbuf[j])
+                continue;
+
+            test_assert(rbuf[j].x >= 50);
+            test_assert(rbuf[j].x + rbuf[j].width <= 400 - 50);
+        }
+
+        free(tbuf);
+        free(rbuf);
+        test_check_page_text(doc, i);
+    }
+
+    reflowed = _get_doc_words(doc);
+    test_assert(0 == strcmp(words, reflowed));
+    free(reflowed);
+
+    /* Wider pages need fewer of them. */
+    i = mume_docdoc_count_pages(doc);
+    while (mume_docdoc_reflow(doc, 800, 16));
+    test_assert(mume_docdoc_count_pages(doc) < i);
+    reflowed = _get_doc_words(doc);
+    test_assert(0 == strcmp(words, reflowed));
+    free(reflowed);
+
+    test_assert(0 == mume_docdoc_reflow(doc, 0, 0));
+    test_assert(mume_docdoc_count_pages(doc) == pages);
+
+    free(words);
+    mume_refobj_release(doc);
+#undef count
+}
+
+/* Lines appended to the file are read by updating the doc. */
+void test_txtdoc_follow(void)
+{
+    static const char *path = "test-follow.txt";
+    char *tbuf;
+    mume_rect_t *rbuf;
+    void *doc;
+    mume_stream_t *stm;
+    FILE *fp;
+    int i, length;
+
+    fp = fopen(path, "w");
+    test_assert(fp);
+    for (i = 0; i < 49; ++i)
+        fprintf(fp, "%d\n", i);
+
+    fprintf(fp, "tail");
+    fflush(fp);
+
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_file_stream_open(path, MUME_OM_READ);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+    test_assert(1 == mume_docdoc_count_pages(doc));
+    test_assert(mume_docdoc_follow(doc, NULL, 0));
+    test_assert(!mume_docdoc_update(doc));
+
+    length = mume_docdoc_get_text(doc, 0, &tbuf, &rbuf);
+    test_assert(length > 5);
+    test_assert(0 == strncmp(tbuf + length - 5, "\ntail", 5));
+    free(tbuf);
+    free(rbuf);
+
+    /* The last line is longer, and more pages are added. */
+    fprintf(fp, "ed\n");
+    for (i = 0; i < 50; ++i)
+        fprintf(fp, "%d\n", i);
+
+    fflush(fp);
+    test_assert(mume_docdoc_update(doc));
+    test_assert(2 == mume_docdoc_count_pages(doc));
+
+    length = mume_docdoc_get_text(doc, 0, &tbuf, &rbuf);
+    test_assert(length > 7);
+    test_assert(0 == strncmp(tbuf + length - 7, "\ntailed", 7));
+    free(tbuf);
+    free(rbuf);
+    fclose(fp);
+
+    /* Read again if the file is truncated. */
+    fp = fopen(path, "w");
+    test_assert(fp);
+    fprintf(fp, "new\n");
+    fclose(fp);
+    test_assert(mume_docdoc_update(doc));
+    test_assert(1 == mume_docdoc_count_pages(doc));
+    length = mume_docdoc_get_text(doc, 0, &tbuf, &rbuf);
+    test_assert(3 == length && 0 == strncmp(tbuf, "new", 3));
+    free(tbuf);
+    free(rbuf);
+
+    mume_refobj_release(doc);
+    remove(path);
+
+    /* Memory streams don't grow. */
+    doc = mume_new(mume_txt_doc_class());
+    stm = mume_memory_stream_open((char*)path, strlen(path), NULL);
+    test_assert(mume_docdoc_load(doc, stm));
+    mume_stream_close(stm);
+    test_assert(!mume_docdoc_follow(doc, NULL, 0));
+    mume_refobj_release(doc);
+}
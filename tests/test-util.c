@@ -16,7 +16,10 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "mume-base.h"
+#include "mume-reader.h"
 #include "test-util.h"
+#include MUME_STDLIB_H
+#include MUME_STRING_H
 
 const char *test_name;
 
@@ -28,6 +31,39 @@ void test_fail(const char *file, int line,
     abort();
 }
 
+int test_bench_enabled(void)
+{
+    return getenv("MUME_TEST_BENCH") != NULL;
+}
+
+/* The single pass extraction must agree with the old pair. */
+void test_check_page_text(void *doc, int pageno)
+{
+    char *t1, *t2;
+    mume_rect_t *r1, *r2;
+    int length;
+
+    length = mume_docdoc_get_text(doc, pageno, &t1, &r1);
+    test_assert(length == mume_docdoc_text_length(doc, pageno));
+
+    if (length > 0) {
+        t2 = malloc_abort(length * sizeof(*t2));
+        r2 = malloc_abort(length * sizeof(*r2));
+        mume_docdoc_extract_text(doc, pageno, t2, r2);
+        test_assert(0 == memcmp(t1, t2, length * sizeof(*t1)));
+        test_assert(0 == memcmp(r1, r2, length * sizeof(*r1)));
+        free(t2);
+        free(r2);
+    }
+    else {
+        test_assert(NULL == t1 && NULL == r1);
+    }
+
+    free(t1);
+    free(r1);
+}
+
+
 void* test_setup_toplevel_window(void *win)
 {
     void *bwin;
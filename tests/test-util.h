@@ -46,6 +46,12 @@ void test_fail(const char *file, int line,
         (_test)(); \
     } while (0)
 
+/* Benchmarks take long, they only run when the environment
+ * variable MUME_TEST_BENCH is set. */
+int test_bench_enabled(void);
+
+void test_check_page_text(void *doc, int pageno);
+
 void* test_setup_toplevel_window(void *win);
 
 void* test_teardown_toplevel_window(void *win);
@@ -17,6 +17,7 @@
  */
 #include "mume-base.h"
 #include "test-util.h"
+#include MUME_STDIO_H
 #include MUME_STRING_H
 
 static void _test_read(mume_virtfs_t *vfs)
@@ -72,6 +73,20 @@ static void _test_write(mume_virtfs_t *vfs)
     mume_stream_close(stm);
     test_assert(mume_virtfs_delete(vfs, filename));
     test_assert(!mume_virtfs_exists(vfs, filename));
+
+#if HAVE_SYS_MMAN_H
+    /* Dots in a name aren't a ".." component, it's mapped. */
+    filename = "test-base-virtfs..txt";
+    stm = mume_virtfs_open_write(vfs, filename);
+    test_assert(stm);
+    test_assert(1 == mume_stream_write(stm, "x", 1));
+    mume_stream_close(stm);
+    stm = mume_virtfs_open_read(vfs, filename);
+    test_assert(stm);
+    test_assert(mume_stream_peek(stm, 0, 1));
+    mume_stream_close(stm);
+    test_assert(mume_virtfs_delete(vfs, filename));
+#endif
 }
 
 void test_virtfs_native(void)
@@ -102,3 +117,90 @@ void test_virtfs_zip(void)
     _test_read(vfs);
     mume_virtfs_destroy(vfs);
 }
+
+static void _test_zipfs_read(
+    mume_stream_t *stm, size_t pos, size_t len)
+{
+    char buffer[64];
+    char expect[16];
+    size_t i;
+
+    test_assert(len <= sizeof(buffer));
+    test_assert(mume_stream_seek(stm, pos));
+    test_assert(mume_stream_read(stm, buffer, len) == len);
+
+    for (i = pos / 11 * 11; i < pos + len; i += 11) {
+        snprintf(expect, sizeof(expect), "line %05d\n", (int)(i / 11));
+        test_assert(0 == strncmp(
+            buffer + MAX(i, pos) - pos, expect + MAX(i, pos) - i,
+            MIN(i + 11, pos + len) - MAX(i, pos)));
+    }
+}
+
+void test_virtfs_zipfs(void)
+{
+    static const size_t blocks[] = { 39, 34, 20, 36, 2, 33, 17, 0, 35 };
+    mume_zipfs_t *zfs;
+    mume_stream_t *stm;
+    char buffer[32];
+    size_t i, length = 12000 * 11;
+
+    zfs = mume_zipfs_create(TESTS_DATA_DIR "/test-base-zipfs.zip");
+    test_assert(zfs);
+    test_assert(NULL == mume_zipfs_create(TESTS_DATA_DIR));
+    test_assert(mume_zipfs_exists(zfs, "dir"));
+    test_assert(mume_zipfs_exists(zfs, "dir/test-base-zipfs.txt"));
+    test_assert(!mume_zipfs_exists(zfs, "di"));
+    test_assert(NULL == mume_zipfs_open(zfs, "dir"));
+    test_assert(NULL == mume_zipfs_open(zfs, "none.txt"));
+
+    /* "dir-a/..." sorts between "dir" and "dir/...". */
+    test_assert(mume_zipfs_exists(zfs, "dir-a"));
+    test_assert(!mume_zipfs_exists(zfs, "dir-"));
+
+    /* Stored entry. */
+    stm = mume_zipfs_open(zfs, "dir/test-base-zipfs.txt");
+    test_assert(stm);
+    test_assert(13 == mume_stream_length(stm));
+    test_assert(13 == mume_stream_read(stm, buffer, sizeof(buffer)));
+    test_assert(0 == strncmp(buffer, "stored entry\n", 13));
+    test_assert(mume_stream_eof(stm));
+    mume_stream_close(stm);
+
+    /* Deflated entry of several blocks, read at random. */
+    stm = mume_zipfs_open(zfs, "test-base-zipfs.txt");
+    test_assert(stm);
+    test_assert(mume_stream_length(stm) == length);
+    test_assert(NULL == mume_stream_peek(stm, 0, 1));
+    _test_zipfs_read(stm, 0, 22);
+    _test_zipfs_read(stm, length - 30, 30);
+    _test_zipfs_read(stm, 65536 - 20, 40);
+    _test_zipfs_read(stm, 5, 50);
+    _test_zipfs_read(stm, 100000, 64);
+    test_assert(mume_stream_seek(stm, length - 1));
+    test_assert(1 == mume_stream_read(stm, buffer, sizeof(buffer)));
+    test_assert(mume_stream_eof(stm));
+    test_assert(!mume_stream_seek(stm, length + 1));
+    mume_stream_close(stm);
+
+    /* Each block of 64K is filled with a letter. Seeking backward
+     * past the cache inflates from the checkpoints. */
+    stm = mume_zipfs_open(zfs, "test-base-zipfs-blocks.txt");
+    test_assert(stm);
+    test_assert(mume_stream_length(stm) == 40 * 65536);
+    for (i = 0; i < COUNT_OF(blocks); ++i) {
+        test_assert(mume_stream_seek(stm, blocks[i] * 65536 + 100));
+        test_assert(2 == mume_stream_read(stm, buffer, 2));
+        test_assert(buffer[0] == 'a' + blocks[i] % 26);
+        test_assert(buffer[1] == buffer[0]);
+    }
+
+    mume_stream_close(stm);
+
+    /* Streams keep the archive open. */
+    stm = mume_zipfs_open(zfs, "test-base-zipfs.txt");
+    test_assert(stm);
+    mume_zipfs_destroy(zfs);
+    _test_zipfs_read(stm, 70000, 33);
+    mume_stream_close(stm);
+}